@@ -31,9 +31,11 @@
 #include "Engine.hpp"
 #include <unison/Backend.hpp>
 #include <unison/BufferProvider.hpp>
+#include <unison/CommandPool.hpp>
 #include <unison/Commander.hpp>
 #include <unison/Patch.hpp>
 #include <unison/PooledBufferProvider.hpp>
+#include <unison/RtArena.hpp>
 #include <unison/SampleBuffer.hpp>
 
 // For connection frenzy
@@ -56,7 +58,14 @@ namespace Core {
   namespace Internal {
 
 CoreExtension::CoreExtension() :
-  m_lineCount(4)
+  m_lineCount(4),
+  m_rtMemory(RtArena::DEFAULT_SIZE / (1024 * 1024)),
+  m_hugePages(false),
+  m_commandBudget(Unison::Internal::Commander::DEFAULT_BUDGET),
+  m_poolLowWater(PooledBufferProvider::DEFAULT_LOW_WATER),
+  m_poolHighWater(PooledBufferProvider::DEFAULT_HIGH_WATER),
+  m_pluginTail(Plugin::NO_ASSUMED_TAIL),
+  m_bufferProvider(NULL)
 //  m_mainWindow(new MainWindow), m_editMode(0)
 {
 }
@@ -90,6 +99,10 @@ CoreExtension::~CoreExtension()
 void CoreExtension::parseArguments(const QStringList& arguments)
 {
   for (int i = 0; i < arguments.size() - 1; i++) {
+    if (arguments.at(i) == QLatin1String("--backend")) {
+      i++; // skip to argument
+      m_backendName = arguments.at(i);
+    }
     if (arguments.at(i) == QLatin1String("--infile")) {
       i++; // skip to argument
       m_sampleInfile = arguments.at(i);
@@ -111,6 +124,49 @@ void CoreExtension::parseArguments(const QStringList& arguments)
       }
       i++; // skip the value
     }
+    if (arguments.at(i) == QLatin1String("--rt-memory")) {
+      bool ok;
+      int size = arguments.at(i + 1).toInt(&ok);
+      if (ok && size > 0) {
+        m_rtMemory = size;
+      }
+      i++; // skip the value
+    }
+    if (arguments.at(i) == QLatin1String("--huge-pages")) {
+      m_hugePages = (arguments.at(i + 1) == QLatin1String("on"));
+      i++; // skip the value
+    }
+    if (arguments.at(i) == QLatin1String("--buffer-pool")) {
+      const QStringList range = arguments.at(i + 1).split(':');
+      bool lowOk = false;
+      bool highOk = false;
+      if (range.size() == 2) {
+        const int low = range.at(0).toInt(&lowOk);
+        const int high = range.at(1).toInt(&highOk);
+        if (lowOk && highOk && 0 <= low && low <= high &&
+            high <= PooledBufferProvider::POOL_CAPACITY) {
+          m_poolLowWater = low;
+          m_poolHighWater = high;
+        }
+      }
+      i++; // skip the value
+    }
+    if (arguments.at(i) == QLatin1String("--plugin-tail")) {
+      bool ok;
+      int seconds = arguments.at(i + 1).toInt(&ok);
+      if (ok && seconds >= 0) {
+        m_pluginTail = seconds;
+      }
+      i++; // skip the value
+    }
+    if (arguments.at(i) == QLatin1String("--command-budget")) {
+      bool ok;
+      int usec = arguments.at(i + 1).toInt(&ok);
+      if (ok && usec >= 0) {
+        m_commandBudget = usec;
+      }
+      i++; // skip the value
+    }
   }
 }
 
@@ -120,13 +176,20 @@ bool CoreExtension::initialize(const QStringList& arguments, QString* errorMessa
   Q_UNUSED(errorMessage);
   parseArguments(arguments);
 
-  PooledBufferProvider* bufProvider = new PooledBufferProvider();
-  bufProvider->setBufferLength(1024);
-  Engine::setBufferProvider(bufProvider);
+  // Before anything the processing thread will touch is allocated
+  RtArena::initialize(size_t(m_rtMemory) * 1024 * 1024, m_hugePages);
 
+  // Until the backend is created and tells it the real period length
+  m_bufferProvider = new PooledBufferProvider();
+  m_bufferProvider->setBufferLength(1024);
+  m_bufferProvider->setWatermarks(AudioPort, m_poolLowWater, m_poolHighWater);
+  Engine::setBufferProvider(m_bufferProvider);
+
+  Plugin::setAssumedTail(m_pluginTail);
   PluginManager::initializeInstance();
 
   Unison::Internal::Commander::initialize();
+  Unison::Internal::Commander::instance()->setBudget(m_commandBudget);
 
   /*
   const bool success = m_mainWindow->init(errorMessage);
@@ -167,14 +230,23 @@ void CoreExtension::extensionsInitialized()
     return;
   }
   qDebug("Found Backends:");
+  IBackendProvider* provider = backends.at(0);
   foreach (IBackendProvider* bep, backends) {
     qDebug() << bep->displayName();
+    if (bep->displayName() == m_backendName) {
+      provider = bep;
+    }
+  }
+  if (!m_backendName.isNull() && provider->displayName() != m_backendName) {
+    qWarning() << "Backend" << m_backendName << "not found, using"
+               << provider->displayName();
   }
 
   // We gain control of created backends
-  Backend* backend = backends.at(0)->createBackend();
+  Backend* backend = provider->createBackend();
 
   Patch* root = new Patch();
+  root->activate(*Engine::bufferProvider());
   backend->setRootProcessor(root);
 
   Engine::setBackend(backend);
@@ -183,6 +255,9 @@ void CoreExtension::extensionsInitialized()
   
   const int effects = 2; // * 5 * 2
 
+  // Publish a single schedule for the whole session
+  root->beginEdit();
+
   for (int l = 1; l <= m_lineCount; ++l) {
 
     FxLine* fxLine = new FxLine(*root, QString("Super Duper Fx-Line %1").arg(l));
@@ -205,6 +280,8 @@ void CoreExtension::extensionsInitialized()
 
   // Stupid Sampler
   Demo::StupidSamplerDemo *ssd = new Demo::StupidSamplerDemo(root, "Stupid sampler");
+  root->endEdit();
+
   SampleBuffer *buf = NULL;
   if (!m_sampleInfile.isNull()) {
     QList<ISampleBufferReader *> readers = extMgr->getObjects<ISampleBufferReader>();
@@ -258,6 +335,16 @@ void CoreExtension::shutdown()
   if (Engine::backend()) {
     Engine::backend()->deactivate();
   }
+  qDebug() << RtArena::usage();
+  qDebug() << Unison::Internal::Commander::instance()->stats();
+  qDebug() << Unison::Internal::CommandPool::usage();
+  if (m_bufferProvider) {
+    // Misses mean the watermarks are too low for the patch, see --buffer-pool
+    qDebug() << "Audio buffers:" << m_bufferProvider->allocations(AudioPort)
+             << "allocated," << m_bufferProvider->misses(AudioPort) << "pool misses";
+    qDebug() << "Control buffers:" << m_bufferProvider->allocations(ControlPort)
+             << "allocated," << m_bufferProvider->misses(ControlPort) << "pool misses";
+  }
 
   //m_mainWindow->shutdown();
 }
@@ -28,6 +28,10 @@
 
 #include <extensionsystem/IExtension.hpp>
 
+namespace Unison {
+  class PooledBufferProvider;
+}
+
 namespace Core {
   namespace Internal {
 
@@ -50,8 +54,16 @@ public:
 private:
   void parseArguments (const QStringList& arguments);
 
+  QString m_backendName;
   QString m_sampleInfile;
   int m_lineCount;
+  int m_rtMemory;       ///< Size of the RtArena, in MiB
+  bool m_hugePages;     ///< Back the RtArena with huge pages
+  int m_commandBudget;  ///< Time for Commands per period, in usec
+  int m_poolLowWater;   ///< Free audio buffers below which the pool is refilled
+  int m_poolHighWater;  ///< Free audio buffers the pool is refilled up to
+  int m_pluginTail;     ///< Seconds plugins are assumed to ring, 0 if not
+  Unison::PooledBufferProvider* m_bufferProvider; ///< Handed to the Engine
 
 //    MainWindow* m_mainWindow;
 //    EditMode* m_editMode;
@@ -128,6 +128,7 @@ void FxLine::addPlugin(const PluginInfoPtr info, int pos)
   Q_ASSERT(plugin);
 
   plugin->activate(*Engine::bufferProvider());
+  m_parent.beginEdit();
   m_parent.add(plugin);
 
   // Verify number of ports. TODO: Report error, not fatal
@@ -179,6 +180,7 @@ void FxLine::addPlugin(const PluginInfoPtr info, int pos)
     }
 
   m_entries.insert(idx, entry);
+  m_parent.endEdit();
 }
 
 
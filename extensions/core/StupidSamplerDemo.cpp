@@ -33,8 +33,6 @@
 #include <unison/ProcessingContext.hpp>
 #include <unison/SampleBuffer.hpp>
 
-#define UNISON_BUFFER_LENGTH 1024
-
 using namespace Unison;
 
 namespace Core {
@@ -159,7 +157,7 @@ void Sampler::activate (BufferProvider& bp)
 {
   for (int i=0; i<2; ++i) {
     m_ports[i]->acquireBuffer(bp);
-    m_ports[i]->connectToBuffer();
+    m_ports[i]->useBuffer(m_ports[i]->buffer().data());
   }
 }
 
@@ -178,8 +176,8 @@ void Sampler::process (const ProcessingContext & context)
     return;
   }
 
-  sample_t *data0 = (sample_t*)(m_ports[0]->buffer()->data());
-  sample_t *data1 = (sample_t*)(m_ports[1]->buffer()->data());
+  sample_t *data0 = (sample_t*)(m_ports[0]->processBuffer()->data());
+  sample_t *data1 = (sample_t*)(m_ports[1]->processBuffer()->data());
 
   // Sample looper
   for(unsigned i=0; i< context.bufferSize(); ++i) {
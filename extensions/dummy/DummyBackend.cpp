@@ -0,0 +1,470 @@
+/*
+ * DummyBackend.cpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "DummyBackend.hpp"
+#include "DummyPort.hpp"
+
+#include <unison/CpuTopology.hpp>
+#include <unison/ProcessingContext.hpp>
+#include <unison/Processor.hpp>
+
+#include <QDebug>
+#include <QThread>
+
+#include <core/Engine.hpp>
+#include <unison/Commander.hpp>
+#include <unison/Patch.hpp>
+#include <unison/Scheduler.hpp>
+
+// For pthread hack - abstract to platform-agnostic utils
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+
+using namespace Unison;
+
+const int PROFILE_INTERVAL = 1000; ///< How often to collect the profile, in msec
+
+namespace Dummy {
+  namespace Internal {
+
+static void setRealtimePriority (unsigned int priority)
+{
+  sched_param sp;
+  sp.sched_priority = priority;
+  if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp) != 0) {
+    qDebug() << "Unable to set SCHED_FIFO, timing will suffer";
+  }
+}
+
+
+static qint64 now ()
+{
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (qint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+static void sleepUntil (qint64 when)
+{
+  timespec ts;
+  ts.tv_sec = when / 1000000000;
+  ts.tv_nsec = when % 1000000000;
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {}
+}
+
+
+/**
+ * Runs one Worker per period, like JackWorkerThread, until the backend sets quit */
+class DummyWorkerThread : public QThread
+{
+  public:
+    DummyWorkerThread (Unison::Internal::Worker* w, Unison::Internal::WorkerGroup& group,
+                       const volatile bool& quit) :
+      m_worker(w),
+      m_group(group),
+      m_period(group.period),
+      m_quit(quit)
+    {}
+
+  protected:
+    void run ()
+    {
+      setRealtimePriority(60);
+      forever {
+        m_period = m_group.awaitPeriod(m_period);
+        if (m_quit) {
+          break;
+        }
+        m_worker->run(*m_group.context);
+      }
+    }
+
+  private:
+    Unison::Internal::Worker* m_worker;
+    Unison::Internal::WorkerGroup& m_group;
+    int m_period;   ///< The last period we have run
+    const volatile bool& m_quit;
+};
+
+
+/**
+ * Drives DummyBackend::runClock, in place of JACK's process thread */
+class DummyClockThread : public QThread
+{
+  public:
+    DummyClockThread (DummyBackend& backend) :
+      m_backend(backend)
+    {}
+
+  protected:
+    void run ()
+    {
+      setRealtimePriority(70);
+      m_backend.runClock();
+    }
+
+  private:
+    DummyBackend& m_backend;
+};
+
+
+Backend* DummyBackendProvider::createBackend()
+{
+  return new DummyBackend(*Core::Engine::bufferProvider(), m_settings);
+}
+
+
+DummyBackend::DummyBackend (Unison::BufferProvider& bp, const DummySettings& settings) :
+  m_myPorts(),
+  m_bufferProvider(bp),
+  m_settings(settings),
+  m_frameTime(0),
+  m_running(false),
+  m_quit(false),
+  m_clock(new DummyClockThread(*this)),
+  m_profiler(settings.workerCount)
+{
+  const int workerCount = settings.workerCount;
+  Q_ASSERT(workerCount > 0);
+  m_bufferProvider.setBufferLength(settings.bufferLength);
+
+  m_workers.workers = new Unison::Internal::Worker*[workerCount];
+  m_workers.workerCount = workerCount;
+  // Spinning only pays off while every worker has a CPU of its own
+  if (workerCount > CpuTopology().cpus().count()) {
+    m_workers.idleSpin = 0;
+    m_workers.stealSpin = 0;
+  }
+  for (int i=0; i<workerCount; ++i) {
+    m_workers.workers[i] = new Unison::Internal::Worker(m_workers);
+    m_workers.workers[i]->setProfile(m_profiler.slot(i));
+  }
+
+  if (workerCount>1) {
+    for (int i=0; i<workerCount; ++i) {
+      m_workerThreads.append(new DummyWorkerThread(m_workers.workers[i], m_workers,
+                                                   m_quit));
+      m_workerThreads[i]->start();
+    }
+  }
+
+  startTimer(PROFILE_INTERVAL);
+}
+
+
+DummyBackend::~DummyBackend ()
+{
+  deactivate();
+
+  // Wake the threads to see the flag, they won't run the period
+  ProcessingContext context(m_settings.bufferLength);
+  m_quit = true;
+  m_workers.startPeriod(context, NULL, 0, 0);
+  for (int i=0; i<m_workerThreads.count(); ++i) {
+    m_workerThreads[i]->wait();
+    delete m_workerThreads[i];
+  }
+  for (int i=0; i<m_workers.workerCount; ++i) {
+    delete m_workers.workers[i];
+  }
+  delete[] m_workers.workers;
+
+  delete m_clock;
+}
+
+
+bool DummyBackend::activate ()
+{
+  if (!m_running) {
+    m_running = true;
+    m_clock->start();
+  }
+  return true;
+}
+
+
+bool DummyBackend::deactivate ()
+{
+  if (m_running) {
+    m_running = false;
+    m_steps.release(); // A lock-step clock is waiting for the next step
+    m_clock->wait();
+  }
+  return true;
+}
+
+
+void DummyBackend::step (int periods)
+{
+  Q_ASSERT(m_settings.lockStep);
+  for (int i=0; i<periods && m_running; ++i) {
+    m_steps.release();
+    m_stepped.acquire();
+  }
+}
+
+
+void DummyBackend::runClock ()
+{
+  const qint64 period =
+      (qint64)1000000000 * m_settings.bufferLength / m_settings.sampleRate;
+  qint64 next = now();
+
+  while (m_running) {
+    qint64 start;
+    qint64 jitter = 0;
+    if (m_settings.lockStep) {
+      m_steps.acquire();
+      if (!m_running) {
+        break;
+      }
+      start = now();
+    }
+    else {
+      sleepUntil(next);
+      jitter = now() - next;
+      start = next;
+    }
+
+    process();
+
+    const qint64 end = now();
+    record(jitter, end - start, period);
+
+    if (m_settings.lockStep) {
+      m_stepped.release();
+    }
+    else {
+      // Periods we have overrun are lost, like an xrun.  Line back up with the clock
+      next += period;
+      if (end > next) {
+        next += ((end - next) / period + 1) * period;
+      }
+    }
+  }
+}
+
+
+void DummyBackend::record (qint64 jitter, qint64 elapsed, qint64 period)
+{
+  const int jitterUs = jitter / 1000;
+  const int load = elapsed * 100 / period;
+
+  m_periods.fetchAndAddRelaxed(1);
+  if (elapsed > period) {
+    m_misses.fetchAndAddRelaxed(1);
+    m_totalMisses.fetchAndAddRelaxed(1);
+  }
+  m_jitterSum.fetchAndAddRelaxed(jitterUs);
+  if (jitterUs > m_jitterMax) {
+    m_jitterMax = jitterUs;
+  }
+  m_loadSum.fetchAndAddRelaxed(load);
+  if (load > m_loadMax) {
+    m_loadMax = load;
+  }
+}
+
+
+DummyStats DummyBackend::takeStats ()
+{
+  DummyStats stats;
+  stats.periods = m_periods.fetchAndStoreRelaxed(0);
+  stats.misses = m_misses.fetchAndStoreRelaxed(0);
+  stats.maxJitter = m_jitterMax.fetchAndStoreRelaxed(0);
+  stats.maxLoad = m_loadMax.fetchAndStoreRelaxed(0);
+  const int jitterSum = m_jitterSum.fetchAndStoreRelaxed(0);
+  const int loadSum = m_loadSum.fetchAndStoreRelaxed(0);
+  stats.meanJitter = stats.periods ? jitterSum / stats.periods : 0;
+  stats.meanLoad = stats.periods ? loadSum / stats.periods : 0;
+  return stats;
+}
+
+
+void DummyBackend::process ()
+{
+  ProcessingContext context(m_settings.bufferLength, m_frameTime);
+  Unison::Internal::Commander* commander = Unison::Internal::Commander::instance();
+  commander->epoch().enter();
+
+  // Process commands, before looking at the schedule they may replace.  Stepped periods
+  // take every queued edit, so a test sees the same graph each run.
+  if (m_settings.lockStep) {
+    commander->drain(context);
+  }
+  else {
+    commander->process(context);
+  }
+  Unison::Internal::Schedule* s = rootPatch()->schedule();
+
+  // Our ports are moved by their own WorkUnits, an empty patch has nothing to start from
+  if (s->readyWorkCount!=0) {
+    if (m_workers.workerCount == 1) {
+      processST(s, context);
+    }
+    else {
+      processMT(s, context);
+    }
+  }
+
+  commander->epoch().leave();
+  m_frameTime += m_settings.bufferLength;
+}
+
+
+int DummyBackend::processST (Unison::Internal::Schedule* sched, ProcessingContext& ctx)
+{
+  m_workers.startPeriod(ctx, sched->readyWork, sched->readyWorkCount, sched->workCount);
+  m_workers.workers[0]->run(ctx);
+  return 0;
+}
+
+
+int DummyBackend::processMT (Unison::Internal::Schedule* sched, ProcessingContext& ctx)
+{
+  // Wakes every DummyWorkerThread at once
+  m_workers.startPeriod(ctx, sched->readyWork, sched->readyWorkCount, sched->workCount);
+  m_workers.awaitFinished();
+  return 0;
+}
+
+
+DummyPort* DummyBackend::registerPort (const QString& name, PortDirection direction)
+{
+  DummyPort* myPort = new DummyPort(*this, name, direction);
+  qDebug() << "Dummy port registered: " << myPort->name();
+  myPort->activate(m_bufferProvider);
+  m_myPorts.append(myPort);
+  if (rootPatch()) {
+    rootPatch()->addBackendPort(myPort);
+  }
+  return myPort;
+}
+
+
+void DummyBackend::unregisterPort (BackendPort* port)
+{
+  DummyPort* dummyPort = dynamic_cast<DummyPort*>(port);
+  unregisterPort(dummyPort);
+}
+
+
+void DummyBackend::unregisterPort (DummyPort* port)
+{
+  for (int i=0; i<m_myPorts.count(); ++i) {
+    if (m_myPorts[i] == port) {
+      m_myPorts.remove(i);
+      break;
+    }
+  }
+  releasePort(port);
+}
+
+
+nframes_t DummyBackend::bufferLength () const
+{
+  return m_settings.bufferLength;
+}
+
+
+nframes_t DummyBackend::sampleRate () const
+{
+  return m_settings.sampleRate;
+}
+
+
+bool DummyBackend::isFreewheeling () const
+{
+  return false;
+}
+
+
+int DummyBackend::portCount () const
+{
+  return m_myPorts.count();
+}
+
+
+DummyPort* DummyBackend::port (int index) const
+{
+  return m_myPorts[index];
+}
+
+
+DummyPort* DummyBackend::port (const QString& name) const
+{
+  for (int i=0; i<m_myPorts.count(); ++i) {
+    if (m_myPorts[i]->name() == name) {
+      return m_myPorts[i];
+    }
+  }
+  return NULL;
+}
+
+
+int DummyBackend::connect (const QString& source, const QString& dest)
+{
+  qWarning() << "Dummy backend cannot connect" << source << "to" << dest;
+  return -1;
+}
+
+
+int DummyBackend::disconnect (const QString& source, const QString& dest)
+{
+  Q_UNUSED(source);
+  Q_UNUSED(dest);
+  return 0;
+}
+
+
+int DummyBackend::disconnect (Unison::BackendPort* port)
+{
+  Q_UNUSED(port);
+  return 0;
+}
+
+
+void DummyBackend::timerEvent (QTimerEvent* event)
+{
+  Q_UNUSED(event);
+  m_profiler.collect();
+  if (rootPatch()) {
+    m_profiler.applyWeights(*rootPatch());
+  }
+
+  const DummyStats stats = takeStats();
+  if (stats.periods != 0) {
+    qDebug() << "Dummy:" << stats.periods << "periods," << stats.misses << "missed,"
+             << "jitter" << stats.meanJitter << "us, max" << stats.maxJitter << "us,"
+             << "load" << stats.meanLoad << "%, max" << stats.maxLoad << "%";
+  }
+}
+
+  } // Internal
+} // Dummy
+
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
@@ -0,0 +1,238 @@
+/*
+ * DummyBackend.hpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef UNISON_DUMMY_BACKEND_H
+#define UNISON_DUMMY_BACKEND_H
+
+#include "DummyPort.hpp"
+
+#include <unison/Backend.hpp>
+#include <unison/Profiler.hpp>
+#include <unison/Scheduler.hpp> // For Internal::WorkerGroup
+#include <core/IBackendProvider.hpp>
+
+#include <QAtomicInt>
+#include <QObject>
+#include <QSemaphore>
+#include <QVarLengthArray>
+
+namespace Unison {
+  class BufferProvider;
+  class ProcessingContext;
+}
+
+namespace Dummy {
+  namespace Internal {
+
+class DummyClockThread;
+class DummyWorkerThread;
+
+/**
+ * How the DummyBackend clock runs.  Filled in from the command line by DummyExtension. */
+struct DummySettings
+{
+  DummySettings () :
+    sampleRate(48000),
+    bufferLength(256),
+    workerCount(1),
+    lockStep(false)
+  {}
+
+  Unison::nframes_t sampleRate;
+  Unison::nframes_t bufferLength;
+  int workerCount;
+
+  /**
+   * Only run a period when DummyBackend::step() is called, rather than on time, and
+   * apply every queued edit at its start.  For tests that need the same periods every
+   * run, set by --dummy-lockstep. */
+  bool lockStep;
+};
+
+
+/**
+ * Timing of the periods run by a DummyBackend.  Times are in microseconds */
+struct DummyStats
+{
+  int periods;      ///< Periods run
+  int misses;       ///< Periods that finished after their deadline
+  int meanJitter;   ///< How late the clock woke up, on average
+  int maxJitter;
+  int meanLoad;     ///< Time from the scheduled start to the end of processing, in %
+  int maxLoad;      ///<   of the period
+};
+
+
+class DummyBackendProvider : public Core::IBackendProvider
+{
+  Q_OBJECT
+  public:
+    DummyBackendProvider (const DummySettings& settings, QObject* parent = 0) :
+      Core::IBackendProvider(parent),
+      m_settings(settings)
+    {}
+
+    virtual ~DummyBackendProvider ()
+    {}
+
+    QString displayName () const
+    {
+      return "dummy";
+    }
+
+    Unison::Backend* createBackend();
+
+  private:
+    DummySettings m_settings;
+};
+
+
+
+/**
+ * DummyBackend runs the same processing path as JackBackend, without a JACK server.
+ * Periods are started by a clock thread at the configured buffer length and sample rate,
+ * recording how late it wakes up and whether processing made its deadline.  This lets
+ * us overload the scheduler on machines without audio hardware.  Ports feeding Unison
+ * are silent, and whatever Unison outputs is dropped.
+ */
+class DummyBackend : public Unison::Backend
+{
+  Q_OBJECT
+
+  public:
+    /**
+     * @param bp provides the buffers of our ports
+     * @param settings the clock, and how many Workers to process with */
+    DummyBackend (Unison::BufferProvider& bp, const DummySettings& settings);
+    virtual ~DummyBackend ();
+
+    Unison::nframes_t bufferLength () const;
+    Unison::nframes_t sampleRate () const;
+    bool isFreewheeling () const;
+
+    DummyPort* registerPort (const QString& name, Unison::PortDirection direction);
+    void unregisterPort (DummyPort*);
+    void unregisterPort (Unison::BackendPort*);
+
+    bool activate ();
+    bool deactivate ();
+
+    int portCount () const;
+    DummyPort* port (int index) const;
+    DummyPort* port (const QString& name) const;
+
+    /**
+     * There is nothing outside of Unison to connect to, or disconnect from.
+     * @returns -1 */
+    int connect (const QString& source, const QString& dest);
+    int disconnect (const QString& source, const QString& dest);
+    int disconnect (Unison::BackendPort*);
+
+    const Unison::Profiler* profiler () const
+    {
+      return &m_profiler;
+    }
+
+    /**
+     * Run @p periods periods and return once they are processed.  Only for lock-step
+     * backends, after activate(). */
+    void step (int periods = 1);
+
+    /**
+     * @returns the frames processed so far, our simulated clock */
+    Unison::nframes_t frameTime () const
+    {
+      return m_frameTime;
+    }
+
+    /**
+     * @returns every deadline missed since activation */
+    int deadlineMisses () const
+    {
+      return m_totalMisses;
+    }
+
+    /**
+     * @returns the timing of the periods since the last call, and starts over */
+    DummyStats takeStats ();
+
+    /**
+     * The clock loop, called by the clock thread. */
+    void runClock ();
+
+  protected:
+    /**
+     * Collects the profile and updates the costs of the root patch.  Reports the
+     * timing of the periods too.
+     */
+    void timerEvent (QTimerEvent* event);
+
+    /**
+     * One period, just like JackBackend::processCb */
+    void process ();
+
+    int processST (Unison::Internal::Schedule* sched, Unison::ProcessingContext& ctx);
+    int processMT (Unison::Internal::Schedule* sched, Unison::ProcessingContext& ctx);
+
+  private:
+    /**
+     * Record the timing of a period, all in nanoseconds
+     * @param jitter how late the period started
+     * @param elapsed from the scheduled start to the end of processing
+     * @param period length of a period */
+    void record (qint64 jitter, qint64 elapsed, qint64 period);
+
+    QVarLengthArray<DummyPort*> m_myPorts;  ///< Collection of ports we have registered
+    Unison::BufferProvider& m_bufferProvider;///< Provide standard buffers for our ports
+    DummySettings m_settings;
+    Unison::nframes_t m_frameTime;          ///< Frames processed since activation
+    volatile bool m_running;                ///< True if activated and still running
+    volatile bool m_quit;                   ///< Tells the worker threads to exit
+
+    // Written by the clock thread, taken by takeStats
+    QAtomicInt m_periods;
+    QAtomicInt m_misses;
+    QAtomicInt m_totalMisses;
+    QAtomicInt m_jitterSum;
+    QAtomicInt m_jitterMax;
+    QAtomicInt m_loadSum;
+    QAtomicInt m_loadMax;
+
+    QSemaphore m_steps;                     ///< Periods requested by step()
+    QSemaphore m_stepped;                   ///< Periods step() is waiting for
+
+    /** If the workerCount > 1, every worker is assigned to a DummyWorkerThread, like
+     * JackBackend.  Otherwise workers[0] runs in the clock thread */
+    Unison::Internal::WorkerGroup m_workers;
+    QVarLengthArray<DummyWorkerThread*> m_workerThreads;
+    DummyClockThread* m_clock;
+    Unison::Profiler m_profiler;            ///< Times the processors, one slot per worker
+};
+
+  } // Internal
+} // Dummy
+
+#endif
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
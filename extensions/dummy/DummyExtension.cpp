@@ -0,0 +1,142 @@
+/*
+ * DummyExtension.cpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "DummyBackend.hpp"
+#include "DummyExtension.hpp"
+
+#include <extensionsystem/ExtensionManager.hpp>
+
+#include <QtPlugin>
+#include <QtDebug>
+
+/*!
+    \namespace Dummy
+    \brief Provides a backend that runs on its own clock, without an audio interface.
+*/
+
+/*!
+    \namespace Dummy::Internal
+    \internal
+*/
+
+namespace Dummy {
+  namespace Internal {
+
+DummyExtension::DummyExtension() :
+  m_selected(false)
+{
+  m_settings.workerCount = 0;
+}
+
+
+DummyExtension::~DummyExtension()
+{
+  qDebug() << "Dummy dtor";
+  // BackendProvider is auto-released
+}
+
+
+void DummyExtension::parseArguments(const QStringList& arguments)
+{
+  for (int i = 0; i < arguments.size(); i++) {
+    bool ok;
+    // Flags have no value, and may come last
+    const QString value = (i + 1 < arguments.size()) ? arguments.at(i + 1) : QString();
+
+    if (arguments.at(i) == QLatin1String("--dummy-lockstep")) {
+      m_settings.lockStep = true;
+    }
+    else if (arguments.at(i) == QLatin1String("--backend")) {
+      m_selected = (value == QLatin1String("dummy"));
+      i++; // skip the value
+    }
+    else if (arguments.at(i) == QLatin1String("--dummy-rate")) {
+      int rate = value.toInt(&ok);
+      if (ok && rate > 0) {
+        m_settings.sampleRate = rate;
+      }
+      i++;
+    }
+    else if (arguments.at(i) == QLatin1String("--dummy-buffer")) {
+      int length = value.toInt(&ok);
+      if (ok && length > 0) {
+        m_settings.bufferLength = length;
+      }
+      i++;
+    }
+    else if (arguments.at(i) == QLatin1String("--dummy-workers")) {
+      int workers = value.toInt(&ok);
+      if (ok) {
+        m_settings.workerCount = workers;
+      }
+      i++;
+    }
+  }
+}
+
+
+bool DummyExtension::initialize(const QStringList& arguments, QString* errorMessage)
+{
+  Q_UNUSED(errorMessage)
+
+  parseArguments(arguments);
+
+  // Only offer the backend when asked for, so we never take over from JACK
+  if (!m_selected) {
+    return true;
+  }
+
+  // Sanity
+  if (m_settings.workerCount <= 0) {
+    m_settings.workerCount = 1;
+  }
+
+  addAutoReleasedObject(new DummyBackendProvider(m_settings));
+  return true;
+}
+
+
+void DummyExtension::extensionsInitialized()
+{
+}
+
+
+void DummyExtension::remoteCommand(const QStringList& options, const QStringList& args)
+{
+  Q_UNUSED(options)
+  Q_UNUSED(args)
+}
+
+
+void DummyExtension::shutdown()
+{
+  qDebug() << "Dummy shutdown";
+}
+
+EXPORT_EXTENSION(DummyExtension)
+
+  } // Internal
+} // Dummy
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
@@ -0,0 +1,106 @@
+/*
+ * TestDummyStep.cpp
+ *
+ * Checks that a lock-step DummyBackend runs exactly the periods it is stepped
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <dummy/DummyBackend.hpp>
+
+#include <unison/Commander.hpp>
+#include <unison/Patch.hpp>
+#include <unison/PooledBufferProvider.hpp>
+#include <unison/RtArena.hpp>
+#include <unison/Scheduler.hpp>
+
+#include <QCoreApplication>
+#include <QThread>
+
+#include <iostream>
+
+using namespace Unison;
+using namespace Dummy::Internal;
+
+static const nframes_t BUFFER_LENGTH = 64;
+
+
+bool runsOnlyWhenStepped (DummyBackend& backend)
+{
+  backend.takeStats();
+  QThread::msleep(50);
+  return backend.takeStats().periods == 0;
+}
+
+
+bool stepRunsExactPeriods (DummyBackend& backend)
+{
+  const nframes_t before = backend.frameTime();
+  backend.step(5);
+  const DummyStats stats = backend.takeStats();
+  return stats.periods == 5 && backend.frameTime() == before + 5 * BUFFER_LENGTH;
+}
+
+
+bool stepAppliesQueuedEdits (DummyBackend& backend, Patch& root)
+{
+  // Registering queues a new schedule, the next period must already run it
+  BackendPort* port = backend.registerPort("step", Output);
+  backend.step();
+  const bool added = (root.schedule()->workCount == 1);
+
+  backend.unregisterPort(port);
+  backend.step();
+  const bool removed = (root.schedule()->workCount == 0);
+
+  return added && removed && backend.takeStats().periods == 2;
+}
+
+
+int main (int argc, char* argv[])
+{
+  QCoreApplication app(argc, argv);
+  RtArena::initialize();
+  PooledBufferProvider bp;
+  Internal::Commander::initialize();
+
+  Patch root;
+  root.activate(bp);
+
+  DummySettings settings;
+  settings.bufferLength = BUFFER_LENGTH;
+  settings.lockStep = true;
+  DummyBackend backend(bp, settings);
+  backend.setRootProcessor(&root);
+  backend.activate();
+
+  bool ros = runsOnlyWhenStepped(backend);
+  bool srp = stepRunsExactPeriods(backend);
+  bool sae = stepAppliesQueuedEdits(backend, root);
+  std::cout << "  runsOnlyWhenStepped: "    << (ros?"OK":"FAIL") << std::endl;
+  std::cout << "  stepRunsExactPeriods: "   << (srp?"OK":"FAIL") << std::endl;
+  std::cout << "  stepAppliesQueuedEdits: " << (sae?"OK":"FAIL") << std::endl;
+
+  backend.deactivate();
+  return (ros + srp + sae - 3);
+}
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
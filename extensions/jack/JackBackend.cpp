@@ -25,6 +25,7 @@
 #include "JackBackend.hpp"
 #include "JackPort.hpp"
 
+#include <unison/CpuTopology.hpp>
 #include <unison/Processor.hpp>
 
 #include <QDebug>
@@ -36,6 +37,7 @@
 #include <core/Engine.hpp>
 #include <unison/AudioBuffer.hpp>
 #include <unison/Commander.hpp>
+#include <unison/Dsp.hpp>
 #include <unison/Patch.hpp>
 #include <unison/Scheduler.hpp>
 
@@ -44,34 +46,49 @@
 
 using namespace Unison;
 
+const int PROFILE_INTERVAL = 1000; ///< How often to collect the profile, in msec
+
 namespace Jack {
   namespace Internal {
 
 class JackWorkerThread : public QThread
 {
   public:
-    JackWorkerThread (Unison::Internal::Worker* w, QSemaphore& done);
+    JackWorkerThread (Unison::Internal::Worker* w, Unison::Internal::WorkerGroup& group,
+                      int cpu);
     void run ();
 
-    void run (ProcessingContext& ctx);
-
   protected:
     void setSchedulingPriority (int policy, unsigned int priority);
+    void setAffinity ();
 
     Unison::Internal::Worker* m_worker;
-    QSemaphore m_wait;
-    // Shared state:
-    QSemaphore& m_done;
-    ProcessingContext* m_context;
+    int m_period;   ///< The last period we have run
+    int m_cpu;      ///< The CPU to run on, or -1 for any
 };
 
-JackWorkerThread::JackWorkerThread (Unison::Internal::Worker* w, QSemaphore& done) :
+JackWorkerThread::JackWorkerThread (Unison::Internal::Worker* w,
+                                    Unison::Internal::WorkerGroup& group, int cpu) :
   m_worker(w),
-  m_wait(),
-  m_done(done)
+  m_period(group.period),
+  m_cpu(cpu)
 {}
 
 
+void JackWorkerThread::setAffinity ()
+{
+  if (m_cpu < 0) {
+    return;
+  }
+  if (CpuTopology::pinCurrentThread(m_cpu)) {
+    qDebug() << "Pinned JWT to CPU" << m_cpu;
+  }
+  else {
+    qDebug() << "Unable to pin JWT to CPU" << m_cpu;
+  }
+}
+
+
 void JackWorkerThread::setSchedulingPriority (int policy, unsigned int priority)
 {
   sched_param sp;
@@ -102,57 +119,77 @@ void JackWorkerThread::run ()
 {
   qDebug() << "JWT: started!" << QThread::currentThreadId();
   setSchedulingPriority(SCHED_FIFO, 60);
+  setAffinity();
 
-  // This blocks until processCb is called. only acquired once per period
+  // This blocks until processCb starts a period
   while (true) {
-    m_wait.acquire();
-
-    m_worker->run(*m_context);
-
-    //printf("!!! RELEASING ONE !!!\n");
-    //m_done.release(1);
+    m_period = m_worker->runNextPeriod(m_period);
   }
   // exec(); We don't want event handling
 }
 
-void JackWorkerThread::run (ProcessingContext& ctx)
-{
-  m_context = &ctx;
-  m_wait.release();
-}
-
 
 Backend* JackBackendProvider::createBackend()
 {
-  return new JackBackend(*Core::Engine::bufferProvider(), m_workerCount);
+  return new JackBackend(*Core::Engine::bufferProvider(), m_workerCount, m_cpus);
 }
 
 
-JackBackend::JackBackend (Unison::BufferProvider& bp, int workerCount) :
+JackBackend::JackBackend (Unison::BufferProvider& bp, int workerCount,
+                          const QList<int>& cpus) :
   m_client(NULL),
   m_myPorts(),
   m_bufferProvider(bp),
   m_bufferLength(0),
   m_sampleRate(0),
   m_freewheeling(false),
-  m_running(false)
+  m_running(false),
+  m_profiler(workerCount)
 {
   Q_ASSERT(workerCount > 0);
   initClient();
 
+  CpuTopology topology;
+  const QList<int> allowed = cpus.isEmpty() ? topology.cpus() : cpus;
+  const QList<int> placement = topology.place(allowed, workerCount);
+
   m_workers.workers = new Unison::Internal::Worker*[workerCount];
   m_workers.workerCount = workerCount;
+  // Spinning only pays off while every worker has a CPU of its own
+  if (workerCount > allowed.count()) {
+    m_workers.idleSpin = 0;
+    m_workers.stealSpin = 0;
+  }
   for (int i=0; i<workerCount; ++i) {
     m_workers.workers[i] = new Unison::Internal::Worker(m_workers);
+    m_workers.workers[i]->setProfile(m_profiler.slot(i));
   }
 
   if (workerCount>1) {
+    // Steal from the workers sharing the most cache with us first
+    for (int i=0; i<workerCount; ++i) {
+      QList<Unison::Internal::Worker*> victims;
+      QList<int> distances;
+      for (int d=CpuTopology::SameCpu; d<=CpuTopology::Remote; ++d) {
+        for (int j=0; j<workerCount; ++j) {
+          if (j != i && topology.distance(placement.at(i), placement.at(j)) == d) {
+            victims.append(m_workers.workers[j]);
+            distances.append(d);
+          }
+        }
+      }
+      m_workers.workers[i]->setVictims(victims, distances);
+    }
+
     m_workerThreads.reserve(workerCount);
     for (int i=0; i<workerCount; ++i) {
-      m_workerThreads.append(new JackWorkerThread(m_workers.workers[i], m_workersDone));
+      m_workerThreads.append(new JackWorkerThread(m_workers.workers[i], m_workers,
+                                                  placement.at(i)));
       ((JackWorkerThread*)m_workerThreads[i])->start();
     }
   }
+
+  startTimer(PROFILE_INTERVAL);
 }
 
 
@@ -176,7 +213,7 @@ void JackBackend::initClient ()
     qDebug("Connected to JACK.");
   }
 
-  m_bufferLength = jack_get_buffer_size(m_client);
+  setBufferLength(jack_get_buffer_size(m_client));
   m_sampleRate = jack_get_sample_rate(m_client);
 
   jack_on_shutdown (m_client, &JackBackend::shutdown, this);
@@ -284,6 +321,9 @@ JackPort* JackBackend::registerPort (const QString& name, PortDirection directio
     qDebug() << "Jack port registered: " << myPort->name();
     myPort->activate( m_bufferProvider );
     m_myPorts.append( myPort );
+    if (rootPatch()) {
+      rootPatch()->addBackendPort(myPort);
+    }
     return myPort;
   }
 }
@@ -299,8 +339,14 @@ void JackBackend::unregisterPort (BackendPort* port)
 
 void JackBackend::unregisterPort (JackPort* port)
 {
-  jack_port_unregister(client(), port->jackPort());
-  delete port;
+  for (int i=0; i<m_myPorts.count(); ++i) {
+    if (m_myPorts[i] == port) {
+      m_myPorts.remove(i);
+      break;
+    }
+  }
+  // The JACK port goes with the JackPort, once the schedule no longer uses it
+  releasePort(port);
 }
 
 
@@ -316,6 +362,12 @@ nframes_t JackBackend::sampleRate () const
 }
 
 
+nframes_t JackBackend::frameTime () const
+{
+  return jack_frame_time(m_client);
+}
+
+
 bool JackBackend::isFreewheeling () const
 {
   return m_freewheeling;
@@ -381,13 +433,56 @@ void JackBackend::shutdown (void* a)
 int JackBackend::bufferSizeCb (nframes_t nframes, void* a)
 {
   JackBackend* backend = static_cast<JackBackend*>(a);
-  qDebug() << "JACK buffer size changed";
-  backend->m_bufferLength = nframes;
-  // TODO-NOW: somehow update or inform ports/buffers of bufferSize change.
+  qDebug() << "JACK buffer size changed to" << nframes;
+  // JACK doesn't run processCb until we return, so our ports can wrap its new buffers
+  // now.  processCb plays silence until the patch has buffers of the new length.
+  if (nframes != backend->m_bufferLength) {
+    backend->m_bufferLength = nframes;
+    for (int i=0; i<backend->portCount(); ++i) {
+      backend->port(i)->setBufferLength(nframes);
+    }
+    QMetaObject::invokeMethod(backend, "applyBufferLength", Qt::QueuedConnection);
+  }
   return 0;
 }
 
 
+void JackBackend::applyBufferLength ()
+{
+  // Several changes may have been queued, only the latest matters
+  const nframes_t nframes = m_bufferLength;
+  if (nframes != m_bufferProvider.bufferLength()) {
+    setBufferLength(nframes);
+  }
+}
+
+
+void JackBackend::setBufferLength (nframes_t nframes)
+{
+  m_bufferLength = nframes;
+  m_bufferProvider.setBufferLength(nframes);
+  for (int i=0; i<portCount(); ++i) {
+    port(i)->setBufferLength(nframes);
+  }
+  if (rootPatch()) {
+    rootPatch()->setBufferLength(AudioPort, nframes);
+  }
+}
+
+
+void JackBackend::silence (nframes_t nframes)
+{
+  for (int i=0; i<m_myPorts.count(); ++i) {
+    JackPort* p = m_myPorts[i];
+    if (p->direction() == Unison::Input) {
+      sample_t* jackbuff =
+          static_cast<sample_t*>(jack_port_get_buffer(p->jackPort(), nframes));
+      Dsp::zero(jackbuff, nframes);
+    }
+  }
+}
+
+
 void JackBackend::freewheelCb (int starting, void* a)
 {
   JackBackend* backend = static_cast<JackBackend*>(a);
@@ -408,65 +503,63 @@ int JackBackend::graphOrderCb (void* a)
 int JackBackend::processCb (nframes_t nframes, void* a)
 {
   JackBackend* backend = static_cast<JackBackend*>(a);
-  int i;
 
   if (!(backend->m_running)) {
     return 0;
   }
 
-  ProcessingContext context( nframes );
-  Unison::Internal::Schedule* s = backend->rootPatch()->schedule();
+  ProcessingContext context( nframes, jack_last_frame_time(backend->m_client) );
+  Unison::Internal::Commander* commander = Unison::Internal::Commander::instance();
+  commander->epoch().enter();
 
-  // Process commands
-  Unison::Internal::Commander::instance()->process(context);
+  // Process commands, before looking at the schedule they may replace
+  commander->process(context);
+  Unison::Internal::Schedule* s = backend->rootPatch()->schedule();
 
-  // TODO, these pre/postprocesses could be built into the Schedule as
-  // workunits so that they run in parallel
-  for (i=0; i<backend->portCount(); ++i) {
-    backend->port(i)->preProcess();
+  if (s->bufferLength != 0 && s->bufferLength < nframes) {
+    // The buffers of a new length come with the next schedule.  Unless commands are
+    // backed up it has been published already, if not the buffers are too short.
+    backend->silence(nframes);
   }
-
-  // TODO: Remove this check, it is rather a hack
-  if (s->readyWorkCount!=0) {
+  else if (s->readyWorkCount!=0) {
+    // Our ports are copied by their own WorkUnits, as soon as what they feed is ready
+    // to run, or what feeds them is done.  An empty patch has nothing to start from
     if (backend->m_workers.workerCount == 1) {
       backend->processST(s, context);
     }
     else {
       backend->processMT(s, context);
     } 
-  } // End hacky conditional
-
-
-  for (i=0; i<backend->portCount(); ++i) {
-    backend->port(i)->postProcess();
   }
 
+  commander->epoch().leave();
   return 0;
 }
 
 
+void JackBackend::timerEvent (QTimerEvent* event)
+{
+  Q_UNUSED(event);
+  m_profiler.collect();
+  if (rootPatch()) {
+    m_profiler.applyWeights(*rootPatch());
+  }
+}
+
+
 int JackBackend::processST (Unison::Internal::Schedule* sched, ProcessingContext& ctx)
 {
-  Unison::Internal::Worker* worker = m_workers.workers[0];
-  m_workers.liveWorkers = 1;
-  worker->pushReadyWorkUnsafe(sched->readyWork, sched->readyWorkCount);
-  worker->run(ctx);
+  m_workers.startPeriod(ctx, sched->readyWork, sched->readyWorkCount, sched->workCount);
+  m_workers.workers[0]->run(ctx);
   return 0;
 }
 
 
 int JackBackend::processMT (Unison::Internal::Schedule* sched, ProcessingContext& ctx)
 {
-  int numThreads = m_workerThreads.size();
-  m_workers.liveWorkers = numThreads;
-  m_workers.workers[0]->pushReadyWorkUnsafe(sched->readyWork, sched->readyWorkCount);
-
-  for (int i=0; i < numThreads; ++i) {
-    ((JackWorkerThread*)m_workerThreads[i])->run(ctx); // unblock slave
-  }
-
-  //m_workers.done.acquire(numThreads);
-  m_workers.done.acquire(1);
+  // Wakes every JackWorkerThread at once
+  m_workers.startPeriod(ctx, sched->readyWork, sched->readyWorkCount, sched->workCount);
+  m_workers.awaitFinished();
   return 0;
 }
 
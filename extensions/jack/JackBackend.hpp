@@ -28,11 +28,12 @@
 #include "JackPort.hpp"
 
 #include <unison/Backend.hpp>
+#include <unison/Profiler.hpp>
 #include <unison/Scheduler.hpp> // For Internal::WorkerGroup
 #include <core/IBackendProvider.hpp>
 
+#include <QList>
 #include <QObject>
-#include <QSemaphore>
 #include <QVarLengthArray>
 #include <jack/jack.h>
 
@@ -47,9 +48,11 @@ class JackBackendProvider : public Core::IBackendProvider
 {
   Q_OBJECT
   public:
-    JackBackendProvider (QObject* parent = 0, int workerCount = 1) :
+    JackBackendProvider (QObject* parent = 0, int workerCount = 1,
+                         const QList<int>& cpus = QList<int>()) :
       Core::IBackendProvider(parent),
-      m_workerCount(workerCount)
+      m_workerCount(workerCount),
+      m_cpus(cpus)
     {}
 
     virtual ~JackBackendProvider ()
@@ -65,6 +68,7 @@ class JackBackendProvider : public Core::IBackendProvider
   private:
     // Our configuration - should make a global settings system soon
     int m_workerCount;
+    QList<int> m_cpus;
 };
 
 
@@ -82,7 +86,14 @@ class JackBackend : public Unison::Backend
   Q_OBJECT
 
   public:
-    JackBackend (Unison::BufferProvider& bp, int workerCount);
+    /**
+     * @param bp provides the buffers of our ports
+     * @param workerCount the number of Workers to process with
+     * @param cpus the CPUs to pin the worker threads to, or empty for all the CPUs we
+     *        may run on.  Workers get a physical core each while there are enough.
+     */
+    JackBackend (Unison::BufferProvider& bp, int workerCount,
+                 const QList<int>& cpus = QList<int>());
     virtual ~JackBackend ();
 
     /**
@@ -94,10 +105,12 @@ class JackBackend : public Unison::Backend
     }
 
     /**
-     * FIXME: BufferLength change support is currently lacking.
+     * @returns the period length JACK is running with.  Follows JACK's buffer size
+     *          changes, see setBufferLength().
      */
     Unison::nframes_t bufferLength () const;
     Unison::nframes_t sampleRate () const;
+    Unison::nframes_t frameTime () const;
     bool isFreewheeling () const;
 
     /**
@@ -124,13 +137,46 @@ class JackBackend : public Unison::Backend
     int disconnect (const QString& source, const QString& dest);
     int disconnect (Unison::BackendPort*);
 
+    const Unison::Profiler* profiler () const
+    {
+      return &m_profiler;
+    }
+
   protected:
+    /**
+     * Collects the profile and updates the costs of the root patch.
+     */
+    void timerEvent (QTimerEvent* event);
+
     int processST (Unison::Internal::Schedule* sched, Unison::ProcessingContext& ctx);
     int processMT (Unison::Internal::Schedule* sched, Unison::ProcessingContext& ctx);
 
+  private slots:
+    /**
+     * Finish a buffer size change JACK told bufferSizeCb() about.  Runs in our own
+     * thread, since resizing the root patch takes the Commander's edit lock: an editing
+     * thread may hold it while waiting on the processing thread, which JACK has stopped
+     * until bufferSizeCb() returns.
+     */
+    void applyBufferLength ();
+
   private:
     void initClient ();
 
+    /**
+     * Move the BufferProvider, our ports and the root patch to a new period length.
+     * The processing thread switches to the new buffers with the root patch's next
+     * schedule.  Not RT-safe.
+     * @param nframes the new period length
+     */
+    void setBufferLength (Unison::nframes_t nframes);
+
+    /**
+     * Write silence to JACK, for periods the graph can't be run.  RT-safe.
+     * @param nframes the length of the period
+     */
+    void silence (Unison::nframes_t nframes);
+
     bool reconnectToJack ();
     bool disconnectFromJack ();
 
@@ -162,8 +208,8 @@ class JackBackend : public Unison::Backend
      * the worker in the m_workers WorkerGroup. workerThread[0] uses workers[0], and
      * workers[count-1] is the primary worker */
     Unison::Internal::WorkerGroup m_workers;
-    QSemaphore m_workersDone;
     QVarLengthArray<void*> m_workerThreads; ///< FIXME: Hack!!
+    Unison::Profiler m_profiler;            ///< Times the processors, one slot per worker
 };
 
   } // Internal
@@ -26,6 +26,7 @@
 #include "JackExtension.hpp"
 
 #include <extensionsystem/ExtensionManager.hpp>
+#include <unison/CpuTopology.hpp>
 
 #include <QtPlugin>
 #include <QtDebug>
@@ -73,6 +74,17 @@ void JackExtension::parseArguments(const QStringList& arguments)
       }
       i++; // skip the value
     }
+    else if (arguments.at(i) == QLatin1String("--cpus")) {
+      QList<int> cpus;
+      if (Unison::CpuTopology::parseCpuList(arguments.at(i + 1).toLatin1().constData(),
+                                            cpus)) {
+        m_cpus = cpus;
+      }
+      else {
+        qWarning() << "Ignoring malformed CPU list" << arguments.at(i + 1);
+      }
+      i++; // skip the value
+    }
   }
 }
 
@@ -82,13 +94,28 @@ bool JackExtension::initialize(const QStringList& arguments, QString* errorMessa
   Q_UNUSED(errorMessage)
 
   parseArguments(arguments);
-  
+
+  // Only keep the CPUs we are allowed to run on
+  Unison::CpuTopology topology;
+  const QList<int> available = topology.cpus();
+  for (int i = m_cpus.count() - 1; i >= 0; --i) {
+    if (!available.contains(m_cpus.at(i))) {
+      qWarning() << "CPU" << m_cpus.at(i) << "is not available, ignoring it";
+      m_cpus.removeAt(i);
+    }
+  }
+
+  // Default to a worker per physical core
+  if (m_workerCount <= 0) {
+    m_workerCount = topology.physicalCores(m_cpus.isEmpty() ? available : m_cpus);
+  }
+
   // Sanity
   if (m_workerCount <= 0) {
     m_workerCount = 1;
   }
 
-  addAutoReleasedObject(new JackBackendProvider(0, m_workerCount));
+  addAutoReleasedObject(new JackBackendProvider(0, m_workerCount, m_cpus));
   return true;
 }
 
@@ -28,6 +28,8 @@
 
 #include <extensionsystem/IExtension.hpp>
 
+#include <QList>
+
 namespace Jack {
   namespace Internal {
 
@@ -49,6 +51,7 @@ private:
 
   // Parsed arguments
   int m_workerCount;
+  QList<int> m_cpus;  ///< CPUs to pin the workers to, empty for no preference
 };
 
   } // namespace Internal
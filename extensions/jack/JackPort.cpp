@@ -26,14 +26,12 @@
 #include "JackBackend.hpp"
 
 #include <unison/AudioBuffer.hpp>
+#include <unison/Dsp.hpp>
 #include <unison/Patch.hpp>
 
 #include <jack/jack.h>
 #include <QDebug>
 
-
-const int UNISON_BUFFER_LENGTH = 1024;
-
 using namespace Unison;
 
 namespace Jack {
@@ -46,8 +44,26 @@ JackPort::JackPort (JackBackend& backend, const QString& name,
   m_backend(backend),
   m_port(NULL),
   m_id(name),
-  m_direction(direction)
-{}
+  m_direction(direction),
+  m_jackBuffer(NULL),
+  m_consumers(new ConsumerList()),
+  m_spareConsumers(NULL),
+  m_oldConsumers(NULL),
+  m_reservedConsumers(INITIAL_CONSUMERS)
+{
+  m_consumers->reserve(INITIAL_CONSUMERS);
+}
+
+
+JackPort::~JackPort ()
+{
+  if (m_port && m_backend.client()) {
+    jack_port_unregister(m_backend.client(), m_port);
+  }
+  delete m_consumers;
+  delete m_spareConsumers;
+  delete m_oldConsumers;
+}
 
 
 // Deferred initialization
@@ -95,22 +111,90 @@ const QSet<Node* const> JackPort::interfacedNodes() const
 
 void JackPort::connectToBuffer ()
 {
-  // Don't need to do any 'connecting', we copy to/from our acquired buffer
+  // Don't need to do any 'connecting', preProcess points our buffer at JACK's
+}
+
+
+void JackPort::consumerConnecting (Unison::Port* consumer)
+{
+  Q_UNUSED(consumer);
+  // The processing thread is done with the list it moved away from, if any
+  delete __sync_lock_test_and_set(&m_oldConsumers, (ConsumerList*)NULL);
+
+  // Our connections already include the new consumer
+  const int needed = connectionCount();
+  if (needed > m_reservedConsumers) {
+    m_reservedConsumers = 2 * needed;
+    ConsumerList* spare = new ConsumerList();
+    spare->reserve(m_reservedConsumers);
+    // Replaces a smaller spare the processing thread hasn't needed yet
+    delete __sync_lock_test_and_set(&m_spareConsumers, spare);
+  }
+}
+
+
+void JackPort::consumerConnected (Unison::Port* consumer)
+{
+  if (m_consumers->count() == m_consumers->capacity()) {
+    // Move to the spare consumerConnecting() made, rather than allocate
+    ConsumerList* spare = __sync_lock_test_and_set(&m_spareConsumers,
+                                                   (ConsumerList*)NULL);
+    Q_ASSERT(spare && spare->capacity() > m_consumers->count());
+    for (int i=0; i<m_consumers->count(); ++i) {
+      spare->append(m_consumers->at(i));
+    }
+    ConsumerList* old = __sync_lock_test_and_set(&m_oldConsumers, m_consumers);
+    Q_ASSERT(old == NULL);
+    Q_UNUSED(old);
+    m_consumers = spare;
+  }
+  m_consumers->append(consumer);
+}
+
+
+void JackPort::consumerDisconnected (Unison::Port* consumer)
+{
+  const int i = m_consumers->indexOf(consumer);
+  if (i >= 0) {
+    m_consumers->remove(i);
+  }
 }
 
 
 void JackPort::activate (Unison::BufferProvider& bp)
 {
-  acquireBuffer(bp);
-  connectToBuffer(); // Might-as-well, though it is a no-op
+  if (direction() == Unison::Output) {
+    // No data until the first period, nothing will read it before then
+    m_jackBuffer = new AudioBuffer(bp, backend().bufferLength(), NULL);
+    m_buffer = SharedBufferPtr(m_jackBuffer);
+  }
+  else {
+    acquireBuffer(bp);
+  }
+  useBuffer(buffer().data()); // Connecting is a no-op
+}
+
+
+void JackPort::setBufferLength (nframes_t len)
+{
+  if (m_jackBuffer) {
+    m_jackBuffer->setLength(len);
+  }
 }
 
+
 void JackPort::preProcess ()
 {
   if (direction() == Unison::Output) {
     nframes_t frames = backend().bufferLength();
     void* jackbuff = jack_port_get_buffer(jackPort(), frames);
-    memcpy(buffer()->data(), jackbuff, sizeof(sample_t) * frames);
+    // JACK hands out a different buffer when the port's connections change
+    if (jackbuff != m_jackBuffer->data()) {
+      m_jackBuffer->setData(jackbuff);
+      for (int i=0; i<m_consumers->count(); ++i) {
+        m_consumers->at(i)->connectToBuffer();
+      }
+    }
   }
 }
 
@@ -119,8 +203,8 @@ void JackPort::postProcess ()
 {
   if (direction() == Unison::Input) {
     nframes_t frames = backend().bufferLength();
-    void* jackbuff = jack_port_get_buffer(jackPort(), frames);
-    memcpy(jackbuff, buffer()->data(), sizeof(sample_t) * frames);
+    sample_t* jackbuff = static_cast<sample_t*>(jack_port_get_buffer(jackPort(), frames));
+    Dsp::copy(jackbuff, static_cast<const sample_t*>(processBuffer()->data()), frames);
   }
 }
 
@@ -28,9 +28,11 @@
 #include <unison/BackendPort.hpp>
 #include <unison/ProcessingContext.hpp>
 
+#include <QVector>
 #include <jack/jack.h>
 
 namespace Unison {
+  class AudioBuffer;
   class BufferProvider;
 }
 
@@ -40,12 +42,22 @@ namespace Jack {
 class JackBackend;
 
 /**
- * Encapsulates a registered port of the jack-client. */
+ * Encapsulates a registered port of the jack-client.
+ *
+ * Ports feeding Unison don't copy.  Their buffer wraps the one JACK hands us, and the
+ * ports connected to them are connected straight to JACK's data.  Ports Unison outputs
+ * to share the buffer of whatever is connected to them, so they still copy it to JACK.
+ */
 class JackPort : public Unison::BackendPort
 {
   public:
     JackPort (JackBackend& backend, const QString &name, Unison::PortDirection direction);
 
+    /**
+     * Unregisters the JACK port.  Deleted by the Schedule that stopped running us, see
+     * Backend::releasePort(), and must not outlive our backend. */
+    ~JackPort ();
+
     bool registerPort ();
 
     bool isRegistered () const
@@ -123,9 +135,25 @@ class JackPort : public Unison::BackendPort
     }
 
     void connectToBuffer ();
+    void consumerConnecting (Unison::Port* consumer);
+    void consumerConnected (Unison::Port* consumer);
+    void consumerDisconnected (Unison::Port* consumer);
 
     void activate (Unison::BufferProvider& bp);
+
+    /**
+     * Resize the wrapper around JACK's data, if we feed Unison.  The data itself is
+     * JACK's, and already has the new length by the time JACK tells us. */
+    void setBufferLength (Unison::nframes_t len);
+
+    /**
+     * Point our buffer at JACK's, and connect everyone reading it again if JACK has moved
+     * it.  Runs in our WorkUnit, before anything connected to us. */
     void preProcess ();
+
+    /**
+     * Copy what the graph produced out to JACK.  Runs in our WorkUnit, as soon as
+     * whatever is connected to us has been processed. */
     void postProcess ();
 
     static Unison::PortDirection directionFromFlags (JackPortFlags flags);
@@ -143,6 +171,23 @@ class JackPort : public Unison::BackendPort
     // Need to shadow ID and direction so we can re-register
     QString m_id;
     Unison::PortDirection m_direction;
+
+    Unison::AudioBuffer* m_jackBuffer;  ///< Wraps JACK's data, our buffer if we feed Unison
+
+    enum
+    {
+      INITIAL_CONSUMERS = 16          ///< Room for consumers before the first growth
+    };
+
+    typedef QVector<Unison::Port*> ConsumerList;
+
+    /** The ports connected to our buffer, only touched by the processing thread */
+    ConsumerList* m_consumers;
+    /** A bigger list made by consumerConnecting(), for consumerConnected() to move to */
+    ConsumerList* volatile m_spareConsumers;
+    /** The list consumerConnected() moved away from, freed by consumerConnecting() */
+    ConsumerList* volatile m_oldConsumers;
+    int m_reservedConsumers;          ///< Room in the newest list, editing thread only
 };
 
   } // Internal
@@ -57,19 +57,29 @@ LadspaPlugin::LadspaPlugin (const LadspaPlugin& other) :
 void LadspaPlugin::init ()
 {
   m_activated = false;
+  m_blockOffset = 0;
   m_uniqueId = QString("%1%2").arg(UriRoot, m_descriptor->UniqueID);
   m_handle = m_descriptor->instantiate(m_descriptor, m_sampleRate);
   Q_ASSERT(m_handle);
 
   qDebug() << "Initializing LadspaPlugin" << name() << "with ports:";
 
-  Port *port;
+  LadspaPort *port;
   int count = m_descriptor->PortCount;
   m_ports.resize( count );
   for (int i = 0; i < count; ++i) {
-    port = m_ports[i] = new LadspaPort( this, i );
+    port = new LadspaPort( this, i );
+    m_ports[i] = port;
     qDebug() << i << port->name();
+    if (port->controlStream()) {
+      ControlInput control;
+      control.stream = port->controlStream();
+      control.value = NULL;
+      m_controls.append(control);
+      m_controlPorts.append(port);
+    }
     if (port->type() == AudioPort) {
+      m_audioPorts.append(port);
       if (port->direction() == Input) {
         m_audioInPorts.insert(port);
       }
@@ -120,7 +130,7 @@ void LadspaPlugin::activate (BufferProvider& bp)
     // Connect all ports first
     for (int i=0; i<m_ports.count(); ++i) {
       m_ports[i]->acquireBuffer(bp);
-      m_ports[i]->connectToBuffer();
+      m_ports[i]->useBuffer(m_ports[i]->buffer().data());
     }
 
     m_descriptor->activate(m_handle);
@@ -190,7 +200,37 @@ QString LadspaPlugin::copyright () const
 
 void LadspaPlugin::process (const ProcessingContext & context)
 {
-  m_descriptor->run(m_handle, context.bufferSize());
+  // A new schedule may have handed the ports other buffers
+  for (int i=0; i<m_controls.count(); ++i) {
+    m_controls[i].value = m_controlPorts[i]->controlValue();
+  }
+  runBlocks(context, m_controls.constData(), m_controls.count());
+}
+
+
+nframes_t LadspaPlugin::latency () const
+{
+  // By convention, LADSPA plugins report their latency on an output named "latency"
+  for (int i=0; i<m_ports.count(); ++i) {
+    LadspaPort* port = static_cast<LadspaPort*>(m_ports[i]);
+    if (port->type() == ControlPort && port->direction() == Output && port->buffer() &&
+        port->name().compare("latency", Qt::CaseInsensitive) == 0) {
+      return nframes_t(qMax(0.0f, *static_cast<const float*>(port->buffer()->data())));
+    }
+  }
+  return 0;
+}
+
+
+void LadspaPlugin::runBlock (nframes_t offset, nframes_t length)
+{
+  if (offset != m_blockOffset) {
+    for (int i=0; i<m_audioPorts.count(); ++i) {
+      m_audioPorts[i]->connectToBuffer(offset);
+    }
+    m_blockOffset = offset;
+  }
+  m_descriptor->run(m_handle, length);
 }
 
 
@@ -39,6 +39,8 @@ const char * const UriRoot = "http://ladspa.org/plugins/";
 
   namespace Internal {
 
+    class LadspaPort;
+
 class LadspaPlugin : public Unison::Plugin
 {
   public:
@@ -86,11 +88,20 @@ class LadspaPlugin : public Unison::Plugin
     void activate (Unison::BufferProvider& bp);
     void deactivate ();
 
+    bool isInPlaceBroken () const
+    {
+      return LADSPA_IS_INPLACE_BROKEN(m_descriptor->Properties);
+    }
+
     void process (const Unison::ProcessingContext &context);
 
     const QSet<Unison::Node* const> dependencies () const;
     const QSet<Unison::Node* const> dependents () const;
 
+  protected:
+    Unison::nframes_t latency () const;
+    void runBlock (Unison::nframes_t offset, Unison::nframes_t length);
+
   private:
     const LADSPA_Descriptor *m_descriptor;
     LADSPA_Handle m_handle;
@@ -101,6 +112,10 @@ class LadspaPlugin : public Unison::Plugin
     QVarLengthArray<Unison::Port*, 16> m_ports;
     QSet<Unison::Node* const> m_audioInPorts;
     QSet<Unison::Node* const> m_audioOutPorts;
+    QVarLengthArray<LadspaPort*, 16> m_audioPorts;    ///< Moved along for each block
+    QVarLengthArray<LadspaPort*, 16> m_controlPorts;  ///< Inputs, same order as m_controls
+    QVarLengthArray<ControlInput, 16> m_controls;
+    Unison::nframes_t m_blockOffset;  ///< Where the audio ports point into their buffers
 
     void init ();
 };
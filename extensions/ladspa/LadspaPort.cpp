@@ -25,6 +25,7 @@
 #include "LadspaPort.hpp"
 
 #include <unison/BufferProvider.hpp>
+#include <unison/ControlStream.hpp>
 
 #include <QSet>
 
@@ -37,16 +38,21 @@ LadspaPort::LadspaPort (LadspaPlugin *plugin, uint32_t index) :
   Port(),
   m_plugin(plugin),
   m_index(index),
-  m_value(0)
+  m_value(0),
+  m_controlStream(NULL)
 {
   Q_ASSERT(m_plugin);
   Q_ASSERT(m_index < pluginInfo()->PortCount);
   m_value = defaultValue();
+  if (type() == ControlPort && direction() == Input) {
+    m_controlStream = new ControlStream(m_value);
+  }
 }
 
 
 LadspaPort::~LadspaPort ()
 {
+  delete m_controlStream;
 }
 
 
@@ -117,7 +123,24 @@ float LadspaPort::value () const
 void LadspaPort::setValue (float value)
 {
   m_value = value;
-  updateBufferValue();
+  if (m_controlStream) {
+    m_controlStream->push(value);
+  }
+  else {
+    updateBufferValue();
+  }
+}
+
+
+void LadspaPort::setValueAt (float value, nframes_t time)
+{
+  if (m_controlStream) {
+    m_value = value;
+    m_controlStream->push(value, time);
+  }
+  else {
+    setValue(value);
+  }
 }
 
 
@@ -304,7 +327,14 @@ const QSet<Node* const> LadspaPort::interfacedNodes () const
 void LadspaPort::connectToBuffer ()
 {
   pluginInfo()->connect_port(m_plugin->ladspaHandle(),
-      m_index, (LADSPA_Data*)buffer()->data());
+      m_index, (LADSPA_Data*)processBuffer()->data());
+}
+
+
+void LadspaPort::connectToBuffer (nframes_t offset)
+{
+  pluginInfo()->connect_port(m_plugin->ladspaHandle(),
+      m_index, static_cast<LADSPA_Data*>(processBuffer()->data()) + offset);
 }
 
 
@@ -30,6 +30,10 @@
 #include <unison/Port.hpp>
 #include <unison/types.hpp>
 
+namespace Unison {
+  class ControlStream;
+}
+
 namespace Ladspa {
   namespace Internal {
 
@@ -53,6 +57,7 @@ class LadspaPort : public Unison::Port
 
     float value () const;
     void setValue (float value);
+    void setValueAt (float value, Unison::nframes_t time);
 
     float defaultValue () const;
 
@@ -66,6 +71,24 @@ class LadspaPort : public Unison::Port
 
     void connectToBuffer ();
 
+    /**
+     * Point the plugin @p offset frames into our buffer, to run part of a period.
+     * RT-safe */
+    void connectToBuffer (Unison::nframes_t offset);
+
+    /**
+     * @returns the changes to our value, NULL unless we are a control input */
+    Unison::ControlStream* controlStream () const
+    {
+      return m_controlStream;
+    }
+
+    /**
+     * @returns where the plugin reads our value from.  Processing thread only */
+    float* controlValue () const
+    {
+      return static_cast<float*>(processBuffer()->data());
+    }
 
   private:
     const LADSPA_Descriptor *pluginInfo () const;
@@ -75,6 +98,7 @@ class LadspaPort : public Unison::Port
 
     uint32_t m_index;
     float m_value; ///< Shadowed value
+    Unison::ControlStream* m_controlStream; ///< Changes on their way to the plugin
 };
 
   } // Internal
@@ -58,6 +58,7 @@ Lv2Plugin::Lv2Plugin (const Lv2Plugin& other) :
 void Lv2Plugin::init ()
 {
   m_activated = false;
+  m_blockOffset = 0;
   m_features = m_world.features.array();
   m_instance = slv2_plugin_instantiate(
       m_plugin, 
@@ -69,10 +70,25 @@ void Lv2Plugin::init ()
   m_name = slv2_plugin_get_name( m_plugin );
   Q_ASSERT(m_name);
 
+  SLV2Values features = slv2_plugin_get_supported_features( m_plugin );
+  m_inPlaceBroken = slv2_values_contains( features, m_world.inPlaceBroken );
+  slv2_values_free( features );
+
   int count = slv2_plugin_get_num_ports(m_plugin);
   m_ports.resize( count );
   for (int i = 0; i < count; ++i) {
-    m_ports[i] = new Lv2Port( m_world, this, i );
+    Lv2Port* port = new Lv2Port( m_world, this, i );
+    m_ports[i] = port;
+    if (port->controlStream()) {
+      ControlInput control;
+      control.stream = port->controlStream();
+      control.value = NULL;
+      m_controls.append(control);
+      m_controlPorts.append(port);
+    }
+    else if (port->type() == AudioPort) {
+      m_audioPorts.append(port);
+    }
   }
 
   m_authorName     = slv2_plugin_get_author_name( m_plugin );
@@ -122,7 +138,7 @@ void Lv2Plugin::activate (BufferProvider& bp)
     // Connect all ports first
     for (int i=0; i<m_ports.count(); ++i) {
       m_ports[i]->acquireBuffer(bp);
-      m_ports[i]->connectToBuffer();
+      m_ports[i]->useBuffer(m_ports[i]->buffer().data());
     }
 
     slv2_instance_activate( m_instance );
@@ -180,7 +196,35 @@ QString Lv2Plugin::copyright () const
 
 void Lv2Plugin::process (const ProcessingContext& context)
 {
-  slv2_instance_run(m_instance, context.bufferSize());
+  // A new schedule may have handed the ports other buffers
+  for (int i=0; i<m_controls.count(); ++i) {
+    m_controls[i].value = m_controlPorts[i]->controlValue();
+  }
+  runBlocks(context, m_controls.constData(), m_controls.count());
+}
+
+
+nframes_t Lv2Plugin::latency () const
+{
+  for (int i=0; i<m_ports.count(); ++i) {
+    Lv2Port* port = static_cast<Lv2Port*>(m_ports[i]);
+    if (port->reportsLatency() && port->direction() == Output && port->buffer()) {
+      return nframes_t(qMax(0.0f, *static_cast<const float*>(port->buffer()->data())));
+    }
+  }
+  return 0;
+}
+
+
+void Lv2Plugin::runBlock (nframes_t offset, nframes_t length)
+{
+  if (offset != m_blockOffset) {
+    for (int i=0; i<m_audioPorts.count(); ++i) {
+      m_audioPorts[i]->connectToBuffer(offset);
+    }
+    m_blockOffset = offset;
+  }
+  slv2_instance_run(m_instance, length);
 }
 
 
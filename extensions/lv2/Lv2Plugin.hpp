@@ -38,6 +38,8 @@
 namespace Lv2 {
   namespace Internal {
 
+    class Lv2Port;
+
 /** Plugin implementation for an Lv2Plugin.  Most values are queried directly
  *  from slv2 on demand.  It will probably be wise to cache some values when
  *  it is safe to do so (like num-ports, port-descriptors, etc..) */
@@ -93,10 +95,24 @@ class Lv2Plugin : public Unison::Plugin
     void activate (Unison::BufferProvider& bp);
     void deactivate ();
 
+    bool isInPlaceBroken () const
+    {
+      return m_inPlaceBroken;
+    }
+
+    Unison::nframes_t sampleRate () const
+    {
+      return m_sampleRate;
+    }
+
     void process(const Unison::ProcessingContext &context);
 
     // TODO: loadState and saveState
 
+  protected:
+    Unison::nframes_t latency () const;
+    void runBlock (Unison::nframes_t offset, Unison::nframes_t length);
+
   private:
     Lv2World&         m_world;
     SLV2Plugin        m_plugin;
@@ -109,8 +125,13 @@ class Lv2Plugin : public Unison::Plugin
     SLV2Value         m_copyright;
 
     bool              m_activated;
+    bool              m_inPlaceBroken;
     Unison::nframes_t m_sampleRate;
     QVarLengthArray<Unison::Port*, 16> m_ports;
+    QVarLengthArray<Lv2Port*, 16> m_audioPorts;    ///< Moved along for each block
+    QVarLengthArray<Lv2Port*, 16> m_controlPorts;  ///< Inputs, same order as m_controls
+    QVarLengthArray<ControlInput, 16> m_controls;
+    Unison::nframes_t m_blockOffset;  ///< Where the audio ports point into their buffers
 
     QSharedPointer<FeatureArray> m_features;
 
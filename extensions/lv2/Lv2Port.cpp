@@ -25,6 +25,7 @@
 #include "Lv2Port.hpp"
 
 #include <unison/BufferProvider.hpp>
+#include <unison/ControlStream.hpp>
 
 #include <QSet>
 
@@ -42,7 +43,9 @@ Lv2Port::Lv2Port (const Lv2World& world, Lv2Plugin* plugin, uint32_t index) :
   m_defaultValue(0),
   m_min(0),
   m_max(0),
-  m_isSampleRate(false)
+  m_isSampleRate(false),
+  m_reportsLatency(false),
+  m_controlStream(NULL)
 {
   // TODO: Error handling
   m_port = slv2_plugin_get_port_by_index( plugin->slv2Plugin(), index );
@@ -64,12 +67,19 @@ Lv2Port::Lv2Port (const Lv2World& world, Lv2Plugin* plugin, uint32_t index) :
     slv2_value_free( max );
   }
   m_isSampleRate = slv2_port_has_property( plugin->slv2Plugin(), m_port, m_world.sampleRate );
+  m_reportsLatency = slv2_port_has_property( plugin->slv2Plugin(), m_port,
+                                             m_world.reportsLatency );
+
+  if (type() == ControlPort && direction() == Input) {
+    m_controlStream = new ControlStream(m_value);
+  }
 }
 
 
 Lv2Port::~Lv2Port ()
 {
   // I don't believe SLV2 requires us to free the port.
+  delete m_controlStream;
 }
 
 
@@ -132,7 +142,24 @@ float Lv2Port::value () const
 void Lv2Port::setValue (float value)
 {
   m_value = value;
-  updateBufferValue();
+  if (m_controlStream) {
+    m_controlStream->push(value);
+  }
+  else {
+    updateBufferValue();
+  }
+}
+
+
+void Lv2Port::setValueAt (float value, nframes_t time)
+{
+  if (m_controlStream) {
+    m_value = value;
+    m_controlStream->push(value, time);
+  }
+  else {
+    setValue(value);
+  }
 }
 
 
@@ -152,7 +179,14 @@ const QSet<Node* const> Lv2Port::interfacedNodes () const
 
 void Lv2Port::connectToBuffer ()
 {
-  slv2_instance_connect_port (m_plugin->slv2Instance(), m_index, buffer()->data());
+  slv2_instance_connect_port (m_plugin->slv2Instance(), m_index, processBuffer()->data());
+}
+
+
+void Lv2Port::connectToBuffer (nframes_t offset)
+{
+  slv2_instance_connect_port (m_plugin->slv2Instance(), m_index,
+                              static_cast<float*>(processBuffer()->data()) + offset);
 }
 
 
@@ -32,6 +32,10 @@
 
 #include <slv2/slv2.h>
 
+namespace Unison {
+  class ControlStream;
+}
+
 namespace Lv2 {
   namespace Internal {
 
@@ -55,6 +59,7 @@ class Lv2Port : public Unison::Port
 
     float value () const;
     void setValue (float value);
+    void setValueAt (float value, Unison::nframes_t time);
 
     float defaultValue () const
     {
@@ -87,6 +92,31 @@ class Lv2Port : public Unison::Port
 
     void connectToBuffer ();
 
+    /**
+     * Point the plugin @p offset frames into our buffer, to run part of a period.
+     * RT-safe */
+    void connectToBuffer (Unison::nframes_t offset);
+
+    /**
+     * @returns @c true if the plugin reports its latency, in frames, on this port */
+    bool reportsLatency () const
+    {
+      return m_reportsLatency;
+    }
+
+    /**
+     * @returns the changes to our value, NULL unless we are a control input */
+    Unison::ControlStream* controlStream () const
+    {
+      return m_controlStream;
+    }
+
+    /**
+     * @returns where the plugin reads our value from.  Processing thread only */
+    float* controlValue () const
+    {
+      return static_cast<float*>(processBuffer()->data());
+    }
 
   private:
     const Lv2World& m_world;
@@ -99,6 +129,8 @@ class Lv2Port : public Unison::Port
     float m_min;
     float m_max;
     bool  m_isSampleRate;
+    bool  m_reportsLatency;
+    Unison::ControlStream* m_controlStream; ///< Changes on their way to the plugin
 };
 
   } // Internal
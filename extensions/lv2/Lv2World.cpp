@@ -53,6 +53,7 @@ Lv2World::Lv2World () :
   integer =      slv2_value_new_uri( world, SLV2_NAMESPACE_LV2 "integer" );
   toggled =      slv2_value_new_uri( world, SLV2_NAMESPACE_LV2 "toggled" );
   sampleRate =   slv2_value_new_uri( world, SLV2_NAMESPACE_LV2 "sampleRate" );
+  reportsLatency=slv2_value_new_uri( world, SLV2_NAMESPACE_LV2 "reportsLatency" );
   inPlaceBroken =slv2_value_new_uri( world, SLV2_NAMESPACE_LV2 "inPlaceBroken" );
   gtkGui =       slv2_value_new_uri( world, "http://lv2plug.in/ns/extensions/ui#GtkUI" );
 
@@ -77,6 +78,7 @@ Lv2World::~Lv2World ()
   slv2_value_free( integer );
   slv2_value_free( toggled );
   slv2_value_free( sampleRate );
+  slv2_value_free( reportsLatency );
   slv2_value_free( gtkGui );
 
   slv2_world_free( world );
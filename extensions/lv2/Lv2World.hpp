@@ -56,6 +56,7 @@ struct Lv2World
   SLV2Value integer;       ///< Integer restrictions for control ports
   SLV2Value toggled;       ///< Boolean restriction for control ports
   SLV2Value sampleRate;    ///< Port values are multiplied by sampling rate
+  SLV2Value reportsLatency; ///< Output port carrying the plugin's latency
   SLV2Value gtkGui;        ///< GTK-based gui is available
 
   UriMap    uriMap;        ///< UriMap used by host and plugins
@@ -0,0 +1,450 @@
+/*
+ * OfflineBackend.cpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "OfflineBackend.hpp"
+#include "OfflinePort.hpp"
+#include "OfflineSource.hpp"
+
+#include <unison/CpuTopology.hpp>
+#include <unison/Dsp.hpp>
+#include <unison/ProcessingContext.hpp>
+#include <unison/Processor.hpp>
+
+#include <QApplication>
+#include <QDebug>
+#include <QThread>
+#include <QTime>
+#include <QTimer>
+
+#include <core/Engine.hpp>
+#include <unison/Commander.hpp>
+#include <unison/Patch.hpp>
+#include <unison/Scheduler.hpp>
+
+using namespace Unison;
+
+const int PROFILE_INTERVAL = 1000; ///< How often to collect the profile, in msec
+const float DEFAULT_SECONDS = 10.0f; ///< How much to render from an endless source
+
+namespace Offline {
+  namespace Internal {
+
+/**
+ * Runs one of the additional Workers, until the backend sets quit */
+class OfflineWorkerThread : public QThread
+{
+  public:
+    OfflineWorkerThread (Unison::Internal::Worker* w,
+                         Unison::Internal::WorkerGroup& group,
+                         const volatile bool& quit) :
+      m_worker(w),
+      m_group(group),
+      m_period(group.period),
+      m_quit(quit)
+    {}
+
+  protected:
+    void run ()
+    {
+      forever {
+        m_period = m_group.awaitPeriod(m_period);
+        if (m_quit) {
+          break;
+        }
+        m_worker->run(*m_group.context);
+      }
+    }
+
+  private:
+    Unison::Internal::Worker* m_worker;
+    Unison::Internal::WorkerGroup& m_group;
+    int m_period;   ///< The last period we have run
+    const volatile bool& m_quit;
+};
+
+
+/**
+ * Drives OfflineBackend::render */
+class OfflineRenderThread : public QThread
+{
+  public:
+    OfflineRenderThread (OfflineBackend& backend) :
+      m_backend(backend)
+    {}
+
+  protected:
+    void run ()
+    {
+      m_backend.render();
+    }
+
+  private:
+    OfflineBackend& m_backend;
+};
+
+
+Backend* OfflineBackendProvider::createBackend()
+{
+  OfflineBackend* backend = new OfflineBackend(*Core::Engine::bufferProvider(), m_settings);
+  QObject::connect(backend, SIGNAL(finished()), qApp, SLOT(quit()), Qt::QueuedConnection);
+  return backend;
+}
+
+
+OfflineBackend::OfflineBackend (Unison::BufferProvider& bp,
+                                const OfflineSettings& settings) :
+  m_myPorts(),
+  m_bufferProvider(bp),
+  m_settings(settings),
+  m_source(NULL),
+  m_output(NULL),
+  m_frames(0),
+  m_frameTime(0),
+  m_realtimeFactor(0.0),
+  m_running(false),
+  m_quit(false),
+  m_renderThread(new OfflineRenderThread(*this)),
+  m_profiler(settings.workerCount)
+{
+  const int workerCount = settings.workerCount;
+  Q_ASSERT(workerCount > 0);
+  m_bufferProvider.setBufferLength(settings.bufferLength);
+
+  m_workers.workers = new Unison::Internal::Worker*[workerCount];
+  m_workers.workerCount = workerCount;
+  // Spinning only pays off while every worker has a CPU of its own
+  if (workerCount > CpuTopology().cpus().count()) {
+    m_workers.idleSpin = 0;
+    m_workers.stealSpin = 0;
+  }
+  for (int i=0; i<workerCount; ++i) {
+    m_workers.workers[i] = new Unison::Internal::Worker(m_workers);
+    m_workers.workers[i]->setProfile(m_profiler.slot(i));
+  }
+
+  for (int i=1; i<workerCount; ++i) {
+    m_workerThreads.append(
+        new OfflineWorkerThread(m_workers.workers[i], m_workers, m_quit));
+    m_workerThreads[i-1]->start();
+  }
+
+  startTimer(PROFILE_INTERVAL);
+}
+
+
+OfflineBackend::~OfflineBackend ()
+{
+  deactivate();
+
+  // Wake the threads to see the flag, they won't run the period
+  ProcessingContext context(m_settings.bufferLength);
+  m_quit = true;
+  m_workers.startPeriod(context, NULL, 0, 0);
+  for (int i=0; i<m_workerThreads.count(); ++i) {
+    m_workerThreads[i]->wait();
+    delete m_workerThreads[i];
+  }
+  for (int i=0; i<m_workers.workerCount; ++i) {
+    delete m_workers.workers[i];
+  }
+  delete[] m_workers.workers;
+
+  delete m_renderThread;
+  delete m_source;
+}
+
+
+bool OfflineBackend::activate ()
+{
+  if (!m_running) {
+    m_running = true;
+    // The session is built after activation, render once it is complete
+    QTimer::singleShot(0, this, SLOT(startRender()));
+  }
+  return true;
+}
+
+
+bool OfflineBackend::deactivate ()
+{
+  m_running = false;
+  m_renderThread->wait();
+  return true;
+}
+
+
+bool OfflineBackend::openOutput (int channels)
+{
+  SF_INFO info;
+  info.samplerate = m_settings.sampleRate;
+  info.channels = channels;
+  if (m_settings.outputFile.endsWith(QLatin1String(".flac"), Qt::CaseInsensitive)) {
+    info.format = SF_FORMAT_FLAC | SF_FORMAT_PCM_24;
+  }
+  else {
+    info.format = SF_FORMAT_WAV | SF_FORMAT_FLOAT;
+  }
+
+  m_output = sf_open(m_settings.outputFile.toLocal8Bit(), SFM_WRITE, &info);
+  if (!m_output) {
+    qWarning() << "Unable to write" << m_settings.outputFile << "with" << channels
+               << "channels:" << sf_strerror(NULL);
+    return false;
+  }
+  return true;
+}
+
+
+void OfflineBackend::startRender ()
+{
+  if (!m_running) {
+    return;
+  }
+
+  int outputs = 0;
+  for (int i=0; i<portCount(); ++i) {
+    if (port(i)->direction() == Unison::Input) {
+      ++outputs;
+    }
+  }
+
+  m_source = OfflineSource::create(m_settings.input, m_settings.sampleRate);
+  if (outputs == 0 || !m_source || !openOutput(outputs)) {
+    if (outputs == 0) {
+      qWarning("Nothing outputs to the offline backend, not rendering");
+    }
+    m_running = false;
+    emit finished();
+    return;
+  }
+
+  float seconds = m_settings.seconds;
+  if (seconds <= 0.0f) {
+    seconds = m_source->length() != 0 ?
+              (float)m_source->length() / m_settings.sampleRate : DEFAULT_SECONDS;
+  }
+  m_frames = seconds * m_settings.sampleRate;
+
+  qDebug() << "Rendering" << seconds << "seconds of" << outputs << "channels to"
+           << m_settings.outputFile;
+  m_renderThread->start();
+}
+
+
+void OfflineBackend::render ()
+{
+  Unison::Internal::Commander* commander = Unison::Internal::Commander::instance();
+  const nframes_t length = m_settings.bufferLength;
+
+  QVarLengthArray<sample_t*, 64> inputs;
+  QVarLengthArray<sample_t*, 64> outputs;
+  QVarLengthArray<float> interleaved;
+
+  QTime timer;
+  timer.start();
+
+  nframes_t done = 0;
+  m_frameTime = 0;
+  while (m_running && done < m_frames) {
+    ProcessingContext context(length, done);
+    commander->epoch().enter();
+
+    // Apply every edit queued so far, before looking at the schedule they may replace.
+    // Without a deadline there is no need for the budget, and the render stays
+    // reproducible.
+    commander->drain(context);
+    Unison::Internal::Schedule* s = rootPatch()->schedule();
+
+    inputs.clear();
+    outputs.clear();
+    for (int i=0; i<portCount(); ++i) {
+      OfflinePort* p = port(i);
+      if (p->direction() == Unison::Output) {
+        inputs.append(p->samples());
+      }
+      else {
+        outputs.append(p->samples());
+      }
+    }
+    m_source->read(inputs.constData(), inputs.count(), length);
+    // The last period may have been found silent
+    for (int i=0; i<portCount(); ++i) {
+      if (port(i)->direction() == Unison::Output) {
+        port(i)->markWritten();
+      }
+    }
+
+    // An empty patch has nothing to start from
+    if (s->readyWorkCount!=0) {
+      process(s, context);
+    }
+
+    // The last period is only written up to the end of the render
+    const nframes_t frames = qMin(length, m_frames - done);
+    const int channels = outputs.count();
+    interleaved.resize(frames * channels);
+    Dsp::interleave(interleaved.data(), outputs.constData(), channels, frames);
+    sf_writef_float(m_output, interleaved.data(), frames);
+
+    commander->epoch().leave();
+    done += frames;
+    m_frameTime = done;
+  }
+
+  const int elapsed = qMax(timer.elapsed(), 1);
+  const double rendered = (double)done / m_settings.sampleRate;
+  m_realtimeFactor = rendered / (elapsed / 1000.0);
+
+  sf_close(m_output);
+  m_output = NULL;
+
+  qDebug() << "Rendered" << rendered << "seconds in" << elapsed / 1000.0
+           << "seconds with" << m_workers.workerCount << "workers, realtime factor"
+           << m_realtimeFactor;
+  m_running = false;
+  emit finished();
+}
+
+
+void OfflineBackend::process (Unison::Internal::Schedule* sched, ProcessingContext& ctx)
+{
+  // The render thread is a worker too, the others are woken with it
+  m_workers.startPeriod(ctx, sched->readyWork, sched->readyWorkCount, sched->workCount);
+  m_workers.workers[0]->run(ctx);
+  m_workers.awaitFinished();
+}
+
+
+OfflinePort* OfflineBackend::registerPort (const QString& name, PortDirection direction)
+{
+  OfflinePort* myPort = new OfflinePort(*this, name, direction);
+  qDebug() << "Offline port registered: " << myPort->name();
+  myPort->activate(m_bufferProvider);
+  m_myPorts.append(myPort);
+  return myPort;
+}
+
+
+void OfflineBackend::unregisterPort (BackendPort* port)
+{
+  OfflinePort* offlinePort = dynamic_cast<OfflinePort*>(port);
+  unregisterPort(offlinePort);
+}
+
+
+void OfflineBackend::unregisterPort (OfflinePort* port)
+{
+  for (int i=0; i<m_myPorts.count(); ++i) {
+    if (m_myPorts[i] == port) {
+      m_myPorts.remove(i);
+      break;
+    }
+  }
+  delete port;
+}
+
+
+nframes_t OfflineBackend::bufferLength () const
+{
+  return m_settings.bufferLength;
+}
+
+
+nframes_t OfflineBackend::sampleRate () const
+{
+  return m_settings.sampleRate;
+}
+
+
+nframes_t OfflineBackend::frameTime () const
+{
+  return m_frameTime;
+}
+
+
+bool OfflineBackend::isFreewheeling () const
+{
+  return true;
+}
+
+
+int OfflineBackend::portCount () const
+{
+  return m_myPorts.count();
+}
+
+
+OfflinePort* OfflineBackend::port (int index) const
+{
+  return m_myPorts[index];
+}
+
+
+OfflinePort* OfflineBackend::port (const QString& name) const
+{
+  for (int i=0; i<m_myPorts.count(); ++i) {
+    if (m_myPorts[i]->name() == name) {
+      return m_myPorts[i];
+    }
+  }
+  return NULL;
+}
+
+
+int OfflineBackend::connect (const QString& source, const QString& dest)
+{
+  qWarning() << "Offline backend cannot connect" << source << "to" << dest;
+  return -1;
+}
+
+
+int OfflineBackend::disconnect (const QString& source, const QString& dest)
+{
+  Q_UNUSED(source);
+  Q_UNUSED(dest);
+  return 0;
+}
+
+
+int OfflineBackend::disconnect (Unison::BackendPort* port)
+{
+  Q_UNUSED(port);
+  return 0;
+}
+
+
+void OfflineBackend::timerEvent (QTimerEvent* event)
+{
+  Q_UNUSED(event);
+  m_profiler.collect();
+  if (rootPatch()) {
+    m_profiler.applyWeights(*rootPatch());
+  }
+}
+
+  } // Internal
+} // Offline
+
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
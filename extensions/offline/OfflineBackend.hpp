@@ -0,0 +1,214 @@
+/*
+ * OfflineBackend.hpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef UNISON_OFFLINE_BACKEND_H
+#define UNISON_OFFLINE_BACKEND_H
+
+#include "OfflinePort.hpp"
+
+#include <unison/Backend.hpp>
+#include <unison/Profiler.hpp>
+#include <unison/Scheduler.hpp> // For Internal::WorkerGroup
+#include <core/IBackendProvider.hpp>
+
+#include <QObject>
+#include <QString>
+#include <QVarLengthArray>
+#include <sndfile.h>
+
+namespace Unison {
+  class BufferProvider;
+  class ProcessingContext;
+}
+
+namespace Offline {
+  namespace Internal {
+
+class OfflineRenderThread;
+class OfflineSource;
+class OfflineWorkerThread;
+
+/**
+ * What, and how, to render.  Filled in from the command line by OfflineExtension. */
+struct OfflineSettings
+{
+  OfflineSettings () :
+    seconds(0.0f),
+    sampleRate(48000),
+    bufferLength(1024),
+    workerCount(1)
+  {}
+
+  QString outputFile;             ///< WAV, or FLAC if it ends in .flac
+  QString input;                  ///< See OfflineSource::create
+  float seconds;                  ///< How much to render, 0 for the length of the input
+  Unison::nframes_t sampleRate;
+  Unison::nframes_t bufferLength;
+  int workerCount;
+};
+
+
+class OfflineBackendProvider : public Core::IBackendProvider
+{
+  Q_OBJECT
+  public:
+    OfflineBackendProvider (const OfflineSettings& settings, QObject* parent = 0) :
+      Core::IBackendProvider(parent),
+      m_settings(settings)
+    {}
+
+    virtual ~OfflineBackendProvider ()
+    {}
+
+    QString displayName () const
+    {
+      return "offline";
+    }
+
+    /**
+     * The application quits once the backend has finished rendering */
+    Unison::Backend* createBackend();
+
+  private:
+    OfflineSettings m_settings;
+};
+
+
+
+/**
+ * OfflineBackend renders the root patch to a file as fast as it can, rather than
+ * keeping up with an audio interface.  Processing is driven from a plain thread, using
+ * the same Workers as the realtime backends, so renders also exercise the scheduler.
+ *
+ * Ports the graph writes into become the channels of the output file, in the order
+ * they were registered.  Ports the graph reads from are fed by an OfflineSource.
+ * Rendering starts once control returns to the event loop, so the session can be built
+ * after activate().
+ */
+class OfflineBackend : public Unison::Backend
+{
+  Q_OBJECT
+
+  public:
+    /**
+     * @param bp provides the buffers of our ports
+     * @param settings what to render, and with how many Workers */
+    OfflineBackend (Unison::BufferProvider& bp, const OfflineSettings& settings);
+    virtual ~OfflineBackend ();
+
+    Unison::nframes_t bufferLength () const;
+    Unison::nframes_t sampleRate () const;
+
+    /**
+     * @returns the frames rendered so far */
+    Unison::nframes_t frameTime () const;
+
+    /**
+     * @returns true, we never wait for anything */
+    bool isFreewheeling () const;
+
+    OfflinePort* registerPort (const QString& name, Unison::PortDirection direction);
+    void unregisterPort (OfflinePort*);
+    void unregisterPort (Unison::BackendPort*);
+
+    bool activate ();
+
+    /**
+     * Stops rendering, the output file is left with what has been rendered so far */
+    bool deactivate ();
+
+    int portCount () const;
+    OfflinePort* port (int index) const;
+    OfflinePort* port (const QString& name) const;
+
+    /**
+     * There is nothing outside of Unison to connect to, or disconnect from.
+     * @returns -1 */
+    int connect (const QString& source, const QString& dest);
+    int disconnect (const QString& source, const QString& dest);
+    int disconnect (Unison::BackendPort*);
+
+    const Unison::Profiler* profiler () const
+    {
+      return &m_profiler;
+    }
+
+    /**
+     * @returns seconds of audio rendered per second of wall time, valid once finished()
+     *          is emitted */
+    double realtimeFactor () const
+    {
+      return m_realtimeFactor;
+    }
+
+    /**
+     * Render the whole session.  Called by the render thread. */
+    void render ();
+
+  signals:
+    /**
+     * Emitted from the render thread once the output file is complete */
+    void finished ();
+
+  protected:
+    /**
+     * Collects the profile and updates the costs of the root patch.
+     */
+    void timerEvent (QTimerEvent* event);
+
+    void process (Unison::Internal::Schedule* sched, Unison::ProcessingContext& ctx);
+
+  private slots:
+    /**
+     * Open the output, now that all the ports are known, and start the render thread */
+    void startRender ();
+
+  private:
+    bool openOutput (int channels);
+
+    QVarLengthArray<OfflinePort*> m_myPorts;  ///< Collection of ports we have registered
+    Unison::BufferProvider& m_bufferProvider; ///< Provide standard buffers for our ports
+    OfflineSettings m_settings;
+    OfflineSource* m_source;                  ///< Feeds the ports we output to Unison
+    SNDFILE* m_output;                        ///< Where the ports Unison outputs to go
+    Unison::nframes_t m_frames;               ///< How many frames to render
+    volatile Unison::nframes_t m_frameTime;   ///< Frames rendered so far
+    double m_realtimeFactor;
+    volatile bool m_running;                  ///< True if activated and still rendering
+    volatile bool m_quit;                     ///< Tells the worker threads to exit
+
+    /** workers[0] runs in the render thread, the others each have an
+     * OfflineWorkerThread.  m_workerThreads[i] runs workers[i+1] */
+    Unison::Internal::WorkerGroup m_workers;
+    QVarLengthArray<OfflineWorkerThread*> m_workerThreads;
+    OfflineRenderThread* m_renderThread;
+    Unison::Profiler m_profiler;              ///< Times the processors, one slot per worker
+};
+
+  } // Internal
+} // Offline
+
+#endif
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
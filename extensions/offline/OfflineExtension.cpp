@@ -0,0 +1,155 @@
+/*
+ * OfflineExtension.cpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "OfflineBackend.hpp"
+#include "OfflineExtension.hpp"
+
+#include <extensionsystem/ExtensionManager.hpp>
+#include <unison/CpuTopology.hpp>
+
+#include <QtPlugin>
+#include <QtDebug>
+
+/*!
+    \namespace Offline
+    \brief Provides a backend that renders to a file instead of an audio interface.
+*/
+
+/*!
+    \namespace Offline::Internal
+    \internal
+*/
+
+namespace Offline {
+  namespace Internal {
+
+OfflineExtension::OfflineExtension()
+{
+  m_settings.workerCount = 0;
+}
+
+
+OfflineExtension::~OfflineExtension()
+{
+  qDebug() << "Offline dtor";
+  // BackendProvider is auto-released
+}
+
+
+void OfflineExtension::parseArguments(const QStringList& arguments)
+{
+  for (int i = 0; i < arguments.size() - 1; i++) {
+    bool ok;
+    const QString& value = arguments.at(i + 1);
+
+    if (arguments.at(i) == QLatin1String("--render")) {
+      m_settings.outputFile = value;
+      i++; // skip the value
+    }
+    else if (arguments.at(i) == QLatin1String("--render-input")) {
+      m_settings.input = value;
+      i++;
+    }
+    else if (arguments.at(i) == QLatin1String("--render-seconds")) {
+      float seconds = value.toFloat(&ok);
+      if (ok) {
+        m_settings.seconds = seconds;
+      }
+      i++;
+    }
+    else if (arguments.at(i) == QLatin1String("--render-rate")) {
+      int rate = value.toInt(&ok);
+      if (ok && rate > 0) {
+        m_settings.sampleRate = rate;
+      }
+      i++;
+    }
+    else if (arguments.at(i) == QLatin1String("--render-buffer")) {
+      int length = value.toInt(&ok);
+      if (ok && length > 0) {
+        m_settings.bufferLength = length;
+      }
+      i++;
+    }
+    else if (arguments.at(i) == QLatin1String("--render-workers")) {
+      int workers = value.toInt(&ok);
+      if (ok) {
+        m_settings.workerCount = workers;
+      }
+      i++;
+    }
+  }
+}
+
+
+bool OfflineExtension::initialize(const QStringList& arguments, QString* errorMessage)
+{
+  Q_UNUSED(errorMessage)
+
+  parseArguments(arguments);
+
+  // Only offer the backend when asked to render, so we never take over from JACK
+  if (m_settings.outputFile.isEmpty()) {
+    return true;
+  }
+
+  // Default to a worker per physical core
+  if (m_settings.workerCount <= 0) {
+    Unison::CpuTopology topology;
+    m_settings.workerCount = topology.physicalCores(topology.cpus());
+  }
+
+  // Sanity
+  if (m_settings.workerCount <= 0) {
+    m_settings.workerCount = 1;
+  }
+
+  addAutoReleasedObject(new OfflineBackendProvider(m_settings));
+  return true;
+}
+
+
+void OfflineExtension::extensionsInitialized()
+{
+}
+
+
+void OfflineExtension::remoteCommand(const QStringList& options, const QStringList& args)
+{
+  Q_UNUSED(options)
+  Q_UNUSED(args)
+}
+
+
+void OfflineExtension::shutdown()
+{
+  qDebug() << "Offline shutdown";
+}
+
+EXPORT_EXTENSION(OfflineExtension)
+
+  } // Internal
+} // Offline
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
@@ -0,0 +1,79 @@
+/*
+ * OfflinePort.cpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "OfflinePort.hpp"
+#include "OfflineBackend.hpp"
+
+#include <unison/AudioBuffer.hpp>
+#include <unison/Patch.hpp>
+
+using namespace Unison;
+
+namespace Offline {
+  namespace Internal {
+
+
+OfflinePort::OfflinePort (OfflineBackend& backend, const QString& name,
+                          PortDirection direction) :
+  BackendPort(),
+  m_backend(backend),
+  m_id(name),
+  m_direction(direction)
+{}
+
+
+Unison::Node* OfflinePort::parent () const
+{
+  return m_backend.rootPatch();
+}
+
+
+void OfflinePort::connectToBuffer ()
+{
+  // Don't need to do any 'connecting', the backend works on our acquired buffer
+}
+
+
+void OfflinePort::activate (Unison::BufferProvider& bp)
+{
+  acquireBuffer(bp);
+  useBuffer(buffer().data()); // Connecting is a no-op
+}
+
+
+sample_t* OfflinePort::samples ()
+{
+  return static_cast<sample_t*>(processBuffer()->data());
+}
+
+
+void OfflinePort::markWritten ()
+{
+  static_cast<AudioBuffer*>(processBuffer())->markWritten();
+}
+
+  } // Internal
+} // Offline
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
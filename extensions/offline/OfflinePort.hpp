@@ -0,0 +1,140 @@
+/*
+ * OfflinePort.hpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef UNISON_OFFLINE_PORT_H
+#define UNISON_OFFLINE_PORT_H
+
+#include <unison/BackendPort.hpp>
+
+namespace Unison {
+  class BufferProvider;
+}
+
+namespace Offline {
+  namespace Internal {
+
+class OfflineBackend;
+
+/**
+ * A port of the OfflineBackend.  There is nothing outside of Unison to connect to, the
+ * backend reads and writes the buffer of the port directly. */
+class OfflinePort : public Unison::BackendPort
+{
+  public:
+    OfflinePort (OfflineBackend& backend, const QString &name,
+                 Unison::PortDirection direction);
+
+    Unison::Node* parent () const;
+
+    OfflineBackend& backend () const
+    {
+      return m_backend;
+    }
+
+    QString id () const
+    {
+      return m_id;
+    }
+
+    QString name () const
+    {
+      return m_id;
+    }
+
+    Unison::PortDirection direction() const
+    {
+      return m_direction;
+    }
+
+    Unison::PortType type () const
+    {
+      return Unison::AudioPort;
+    }
+
+    float value () const
+    {
+      return 0.0f;
+    }
+
+    void setValue (float)
+    {
+    }
+
+    float defaultValue () const
+    {
+      return 0.0f;
+    }
+
+    bool isBounded () const
+    {
+      return false;
+    }
+
+    float minimum () const
+    {
+      return 0.0f;
+    }
+
+    float maximum () const
+    {
+      return 0.0f;
+    }
+
+    bool isToggled () const
+    {
+      return false;
+    }
+
+    /**
+     * Offline ports are never connected to each other */
+    const QSet<Unison::Node* const> interfacedNodes () const
+    {
+      return QSet<Unison::Node* const>();
+    }
+
+    void connectToBuffer ();
+
+    void activate (Unison::BufferProvider& bp);
+
+    /**
+     * @returns the samples of our buffer, read and written by the render thread */
+    Unison::sample_t* samples ();
+
+    /**
+     * Forget whether our buffer was silent, once the render thread has written samples()
+     */
+    void markWritten ();
+
+  private:
+    OfflineBackend& m_backend;
+    QString m_id;
+    Unison::PortDirection m_direction;
+};
+
+  } // Internal
+} // Offline
+
+#endif
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
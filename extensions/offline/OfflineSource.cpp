@@ -0,0 +1,177 @@
+/*
+ * OfflineSource.cpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "OfflineSource.hpp"
+
+#include <unison/Dsp.hpp>
+
+#include <QDebug>
+#include <math.h>
+#include <string.h>
+
+using namespace Unison;
+
+namespace Offline {
+  namespace Internal {
+
+
+OfflineSource* OfflineSource::create (const QString& description, nframes_t sampleRate)
+{
+  if (description.isEmpty() || description == QLatin1String("silence")) {
+    return new SilenceSource();
+  }
+  if (description == QLatin1String("noise")) {
+    return new NoiseSource();
+  }
+  if (description.startsWith(QLatin1String("sine"))) {
+    float frequency = 440.0f;
+    const int colon = description.indexOf(':');
+    if (colon != -1) {
+      bool ok;
+      const float f = description.mid(colon + 1).toFloat(&ok);
+      if (ok && f > 0.0f) {
+        frequency = f;
+      }
+      else {
+        qWarning() << "Bad sine frequency in" << description << "using" << frequency;
+      }
+    }
+    return new SineSource(frequency, sampleRate);
+  }
+
+  FileSource* file = new FileSource(description, sampleRate);
+  if (!file->isOpen()) {
+    delete file;
+    return NULL;
+  }
+  return file;
+}
+
+
+void SilenceSource::read (sample_t* const* channels, int channelCount, nframes_t frames)
+{
+  for (int c=0; c<channelCount; ++c) {
+    Dsp::zero(channels[c], frames);
+  }
+}
+
+
+NoiseSource::NoiseSource ()
+{
+  m_random.seed(1234); // Renders should be reproducible
+}
+
+
+void NoiseSource::read (sample_t* const* channels, int channelCount, nframes_t frames)
+{
+  for (int c=0; c<channelCount; ++c) {
+    sample_t* out = channels[c];
+    for (nframes_t i=0; i<frames; ++i) {
+      out[i] = 0.25f * (2.0f * m_random.nextFloat() - 1.0f);
+    }
+  }
+}
+
+
+SineSource::SineSource (float frequency, nframes_t sampleRate) :
+  m_phase(0.0),
+  m_increment((double)frequency / sampleRate)
+{}
+
+
+void SineSource::read (sample_t* const* channels, int channelCount, nframes_t frames)
+{
+  if (channelCount == 0) {
+    return;
+  }
+  sample_t* first = channels[0];
+  for (nframes_t i=0; i<frames; ++i) {
+    first[i] = 0.5f * sinf(2.0f * M_PI * m_phase);
+    m_phase += m_increment;
+    if (m_phase >= 1.0) {
+      m_phase -= 1.0;
+    }
+  }
+  for (int c=1; c<channelCount; ++c) {
+    Dsp::copy(channels[c], first, frames);
+  }
+}
+
+
+FileSource::FileSource (const QString& fileName, nframes_t sampleRate) :
+  m_file(NULL)
+{
+  memset(&m_info, 0, sizeof(m_info));
+  m_file = sf_open(fileName.toLocal8Bit(), SFM_READ, &m_info);
+  if (!m_file) {
+    qWarning() << "Unable to open" << fileName << ":" << sf_strerror(NULL);
+    return;
+  }
+  if ((nframes_t)m_info.samplerate != sampleRate) {
+    // TODO: resample
+    qWarning() << fileName << "is" << m_info.samplerate << "Hz, rendering at"
+               << sampleRate << "Hz anyways";
+  }
+}
+
+
+FileSource::~FileSource ()
+{
+  if (m_file) {
+    sf_close(m_file);
+  }
+}
+
+
+void FileSource::read (sample_t* const* channels, int channelCount, nframes_t frames)
+{
+  const int fileChannels = m_info.channels;
+  if (m_interleaved.size() < (int)(frames * fileChannels)) {
+    m_interleaved.resize(frames * fileChannels);
+  }
+
+  float* data = m_interleaved.data();
+  sf_count_t got = sf_readf_float(m_file, data, frames);
+  if (got < 0) {
+    got = 0;
+  }
+  Dsp::zero(data + got * fileChannels, (frames - got) * fileChannels);
+
+  if (channelCount == fileChannels) {
+    Dsp::deinterleave(channels, data, channelCount, frames);
+    return;
+  }
+  for (int c=0; c<channelCount; ++c) {
+    sample_t* out = channels[c];
+    const float* in = data + (c % fileChannels);
+    for (nframes_t i=0; i<frames; ++i) {
+      out[i] = in[i * fileChannels];
+    }
+  }
+}
+
+  } // Internal
+} // Offline
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
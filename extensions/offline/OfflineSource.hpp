@@ -0,0 +1,146 @@
+/*
+ * OfflineSource.hpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef UNISON_OFFLINE_SOURCE_H
+#define UNISON_OFFLINE_SOURCE_H
+
+#include <unison/FastRandom.hpp>
+#include <unison/types.hpp>
+
+#include <QString>
+#include <QVector>
+#include <sndfile.h>
+
+namespace Offline {
+  namespace Internal {
+
+/**
+ * Feeds the input ports of an OfflineBackend, one period at a time.  Sources are read
+ * from the render thread only. */
+class OfflineSource
+{
+  public:
+    virtual ~OfflineSource () {}
+
+    /**
+     * Fill the next @p frames of every channel.
+     * @param channels the buffers to fill, one per input port
+     * @param channelCount size of the channels array */
+    virtual void read (Unison::sample_t* const* channels, int channelCount,
+                       Unison::nframes_t frames) = 0;
+
+    /**
+     * @returns how many frames the source has, or 0 if it never runs out */
+    virtual Unison::nframes_t length () const
+    {
+      return 0;
+    }
+
+    /**
+     * Parse a --render-input description: a file name, "silence", "noise" or
+     * "sine[:hz]".
+     * @returns the new source, or NULL if a file could not be opened */
+    static OfflineSource* create (const QString& description,
+                                  Unison::nframes_t sampleRate);
+};
+
+
+/**
+ * Silence on every channel */
+class SilenceSource : public OfflineSource
+{
+  public:
+    void read (Unison::sample_t* const* channels, int channelCount,
+               Unison::nframes_t frames);
+};
+
+
+/**
+ * White noise, at -12dB so it won't clip when mixed */
+class NoiseSource : public OfflineSource
+{
+  public:
+    NoiseSource ();
+
+    void read (Unison::sample_t* const* channels, int channelCount,
+               Unison::nframes_t frames);
+
+  private:
+    Unison::FastRandom m_random;
+};
+
+
+/**
+ * A sine wave, the same on every channel */
+class SineSource : public OfflineSource
+{
+  public:
+    SineSource (float frequency, Unison::nframes_t sampleRate);
+
+    void read (Unison::sample_t* const* channels, int channelCount,
+               Unison::nframes_t frames);
+
+  private:
+    double m_phase;       ///< Current phase, in [0,1)
+    double m_increment;   ///< Phase advance per frame
+};
+
+
+/**
+ * Reads an audio file through libsndfile.  File channels are spread over the ports,
+ * so a stereo file feeds the left and right of every FxLine.  Reads past the end are
+ * silent. */
+class FileSource : public OfflineSource
+{
+  public:
+    /**
+     * Check isOpen() afterwards. */
+    FileSource (const QString& fileName, Unison::nframes_t sampleRate);
+    ~FileSource ();
+
+    bool isOpen () const
+    {
+      return m_file;
+    }
+
+    void read (Unison::sample_t* const* channels, int channelCount,
+               Unison::nframes_t frames);
+
+    Unison::nframes_t length () const
+    {
+      return m_info.frames;
+    }
+
+  private:
+    SNDFILE* m_file;
+    SF_INFO m_info;
+    QVector<float> m_interleaved; ///< Scratch for sf_readf_float, grown as needed
+};
+
+  } // Internal
+} // Offline
+
+#endif
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
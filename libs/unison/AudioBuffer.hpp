@@ -26,8 +26,7 @@
 #define UNISON_AUDIO_BUFFER_HPP_
 
 #include "Buffer.hpp"
-
-#include <malloc.h>
+#include "Dsp.hpp"
 
 namespace Unison {
 
@@ -35,6 +34,14 @@ namespace Unison {
  * AudioBuffer is a Buffer designed specifically for Audio.  Can be used to connect two
  * Ports with type=AudioPort.  AudioBuffer can be constructed two ways, details are
  * available in the constructor documentation.
+ *
+ * Data allocated by AudioBuffer starts on a CACHE_LINE_SIZE boundary and is padded to a
+ * whole number of cache lines, so the Dsp kernels never split a vector across lines and
+ * two buffers never share a line.  The padding reads as silence.
+ *
+ * A buffer remembers whether its data is known to be silent, so processors whose inputs
+ * have all gone quiet can be skipped, see Processor::tailLength().  Whoever writes the
+ * data must either call markWritten() or, if it wrote silence, setSilent().
  */
 class AudioBuffer : public Buffer
 {
@@ -42,20 +49,18 @@ class AudioBuffer : public Buffer
     /**
      * Construct a new AudioBuffer and pass ownership to the specified BufferProvider.
      * This constructor should only be called by the BufferProvider when the pool
-     * underruns.  This function itself is not RT-safe since malloc is called immediately.
-     * The buffer is initialized to silence (all zero).
+     * underruns.  This function itself is not RT-safe since the data is allocated from
+     * the RtArena immediately.  The buffer is initialized to silence (all zero).
      * @param provider The BufferProvider to own this Buffer
      * @param length The length, in frames, of the Buffer
      */
     AudioBuffer (BufferProvider& provider, nframes_t length) :
       Buffer(provider, AudioPort),
       m_length(length),
-      m_ownsData(true)
+      m_ownsData(true),
+      m_silence(Unknown)
     {
-      m_data = new float[length];
-      for (nframes_t i=0; i< length; ++i) {
-        m_data[i] = 0.0f;
-      }
+      m_data = allocate(length);
     }
 
 
@@ -67,13 +72,13 @@ class AudioBuffer : public Buffer
      * does not manage, for example, memory returned by jack_port_get_buffer().
      * @param provider The BufferProvider to own this Buffer
      * @param length The length, in frames, of the pre-existing Buffer
-     * @param data pointer to the data
-     * @deprecated
+     * @param data pointer to the data, see setData()
      */
     AudioBuffer (BufferProvider& provider, nframes_t length, void* data) :
       Buffer(provider, AudioPort),
       m_length(length),
-      m_ownsData(false)
+      m_ownsData(false),
+      m_silence(Unknown)
     {
       m_data = static_cast<float*>(data);
     }
@@ -82,7 +87,7 @@ class AudioBuffer : public Buffer
     ~AudioBuffer ()
     {
       if (m_ownsData) {
-        delete[] m_data;
+        RtArena::free(m_data);
       }
     }
 
@@ -97,16 +102,84 @@ class AudioBuffer : public Buffer
 
 
     /**
-     * Set the length of the buffer - currently unsupported.
+     * Set the length of the buffer.  A buffer owning its data reallocates it as silence,
+     * losing the contents, which is not RT-safe.  A buffer over existing data only takes note, the
+     * data must already be at least @p len long.
      * @param len The new length, in samples
      */
     void setLength (nframes_t len)
     {
+      m_length = len;
+      m_silence = Unknown;
       if (m_ownsData) {
-        m_length = len;
-        delete[] m_data;
-        m_data = new float[len];
+        RtArena::free(m_data);
+        m_data = allocate(len);
+      }
+    }
+
+
+    /**
+     * @returns true if the data was allocated by, and will be freed by, this buffer
+     */
+    bool ownsData () const
+    {
+      return m_ownsData;
+    }
+
+
+    /**
+     * Point a buffer constructed over existing data at some other data, for example when
+     * JACK moves a port's buffer.  Whoever has connected to the buffer must connect
+     * again to see the change.  RT-safe.
+     * @param data pointer to the data, at least length() frames long
+     */
+    void setData (void* data)
+    {
+      Q_ASSERT(!m_ownsData);
+      m_data = static_cast<float*>(data);
+      m_silence = Unknown;
+    }
+
+
+    /**
+     * @returns @c true if every sample is zero.  Scans the data with Dsp::peak() unless
+     * that is already known, and remembers the result until the data is written again.
+     * Readers of the same data may call this at the same time, they all come to the same
+     * conclusion.  RT-safe.
+     */
+    bool isSilent ()
+    {
+      if (m_silence == Unknown) {
+        m_silence = (Dsp::peak(m_data, m_length) == 0.0f) ? Silent : Audible;
       }
+      return m_silence == Silent;
+    }
+
+
+    /**
+     * @returns @c true if the data is known to be silent, without looking at it
+     */
+    bool isKnownSilent () const
+    {
+      return m_silence == Silent;
+    }
+
+
+    /**
+     * Note that every sample is zero, so nobody needs to look.  RT-safe.
+     */
+    void setSilent ()
+    {
+      m_silence = Silent;
+    }
+
+
+    /**
+     * Forget what was known about the data, after writing it.  RT-safe.
+     */
+    void markWritten ()
+    {
+      m_silence = Unknown;
     }
 
 
@@ -122,9 +195,28 @@ class AudioBuffer : public Buffer
     }
 
   private:
+    enum Silence
+    {
+      Unknown,  ///< Nobody has looked since the data was written
+      Silent,
+      Audible
+    };
+
+    /**
+     * @returns @p length frames of silence, aligned and padded to cache lines */
+    static float* allocate (nframes_t length)
+    {
+      const nframes_t perLine = CACHE_LINE_SIZE / sizeof(float);
+      const nframes_t padded = (length + perLine - 1) / perLine * perLine;
+      float* data = static_cast<float*>(RtArena::allocate(sizeof(float) * padded));
+      Dsp::zero(data, padded);
+      return data;
+    }
+
     int m_length;       ///< The length of the data buffer
     float* m_data;      ///< Pointer to actual data
     bool m_ownsData;    ///< true if we are responsible for freeing data
+    volatile int m_silence; ///< What is known about the data, a Silence
 };
 
 } // Unison
@@ -33,6 +33,7 @@ namespace Unison {
 
   class BackendPort;
   class Patch;
+  class Profiler;
 
 /**
  * Backend encapsulates Audio-Interface compatibility.  There could theoretically be
@@ -63,6 +64,14 @@ class Backend : public QObject
      */
     virtual nframes_t sampleRate () const = 0;
 
+    /**
+     * The clock the processing thread runs on, in frames.  Timestamps of control
+     * changes are given on this clock, see ControlStream.  A change at or before the
+     * current time takes effect at the start of the next period.
+     * @returns the current frame time, wraps around
+     */
+    virtual nframes_t frameTime () const = 0;
+
     /**
      * Whether or not the Backend is freewheeling.  Freewheeling is when we process frames
      * as quickly as possible with no regard to physical time
@@ -153,6 +162,22 @@ class Backend : public QObject
       return m_rootPatch;
     }
 
+    /**
+     * @returns the Profiler timing the processors run by this backend, or NULL if the
+     *          backend doesn't profile
+     */
+    virtual const Profiler* profiler () const
+    {
+      return NULL;
+    }
+
+  protected:
+    /**
+     * Stop scheduling @p port, and delete it once the processing thread can no longer
+     * reach it.  For unregisterPort(), after the port has left the backend's own lists.
+     */
+    void releasePort (BackendPort* port);
+
   private:
     Patch* m_rootPatch;   ///< Pointer to the root patch/processor
 
@@ -50,6 +50,20 @@ class BackendPort : public Port
       return NULL;
     }
 
+    /**
+     * Move data from the Backend into our buffer.  Only called for ports that feed
+     * Unison (direction Output), from the port's own WorkUnit in the schedule, which
+     * runs before any of the ports connected to us are processed. */
+    virtual void preProcess ()
+    {}
+
+    /**
+     * Move the data in our buffer out to the Backend.  Only called for ports Unison
+     * writes to (direction Input), from the port's own WorkUnit in the schedule, which
+     * runs as soon as everything connected to us has been processed. */
+    virtual void postProcess ()
+    {}
+
     // TODO: More functions, like whether it belongs to unison, another app, or
     // the system etc..  Probably need a sort of Id or Path to the port.
 };
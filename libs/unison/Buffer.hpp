@@ -25,8 +25,10 @@
 #ifndef UNISON_BUFFER_HPP_
 #define UNISON_BUFFER_HPP_
 
+#include "RtArena.hpp"
 #include "types.hpp"
 
+#include <QtCore/QAtomicInt>
 #include <QtCore/QtGlobal>
 
 namespace Unison {
@@ -55,12 +57,26 @@ class Buffer
      */
     Buffer (BufferProvider& provider, PortType type) :
       m_provider(provider),
-      m_type(type)
+      m_type(type),
+      m_refCount(0)
     {}
 
     virtual ~Buffer ()
     {};
 
+    /**
+     * Buffers are touched by the processing thread, so they live in the RtArena
+     */
+    static void* operator new (size_t size)
+    {
+      return RtArena::allocate(size);
+    }
+
+    static void operator delete (void* p)
+    {
+      RtArena::free(p);
+    }
+
     /**
      * @returns the type of buffer.  Buffers are designed to only work with a particular
      * kind of port and the PortType must match.
@@ -80,6 +96,7 @@ class Buffer
   private:
     BufferProvider& m_provider;     ///< The owning BufferProvider
     PortType m_type;                ///< Fixed type of the buffer
+    QAtomicInt m_refCount;          ///< Number of SharedBufferPtrs pointing at us
 
     friend class SharedBufferPtr;
 };
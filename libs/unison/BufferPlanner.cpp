@@ -0,0 +1,320 @@
+/*
+ * BufferPlanner.cpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "BufferPlanner.hpp"
+
+#include "AudioBuffer.hpp"
+#include "Patch.hpp"
+#include "Port.hpp"
+#include "PortMixer.hpp"
+#include "ScheduleCompiler.hpp"
+#include "Scheduler.hpp"
+
+namespace Unison {
+  namespace Internal {
+
+BufferPlanner::BufferPlanner (Patch& patch, Schedule& schedule) :
+  m_patch(patch),
+  m_compiler(patch.compiler()),
+  m_schedule(schedule),
+  m_length(0),
+  m_zeroSlot(-1)
+{}
+
+
+void BufferPlanner::plan (BufferProvider& provider)
+{
+  m_length = provider.bufferLength();
+  findAncestors();
+  for (int i=0; i<m_order.count(); ++i) {
+    planUnit(m_order.at(i), provider);
+  }
+  // Producers come first, so their inputs can follow them to the new buffers
+  for (int i=0; i<m_order.count(); ++i) {
+    resizeUnit(m_order.at(i), provider);
+  }
+  m_schedule.bufferLength = m_length;
+
+  m_schedule.buffers.reserve(m_slots.count());
+  for (int i=0; i<m_slots.count(); ++i) {
+    m_schedule.buffers.append(m_slots.at(i).buffer);
+  }
+}
+
+
+void BufferPlanner::findAncestors ()
+{
+  const int count = m_schedule.workCount;
+  const WorkUnit* work = m_schedule.work;
+
+  // Topological order
+  QVector<int> pending(count, 0);
+  for (int i=0; i<count; ++i) {
+    for (int d=0; d<work[i].dependentCount; ++d) {
+      ++pending[work[i].dependents[d] - work];
+    }
+  }
+  m_order.reserve(count);
+  for (int i=0; i<count; ++i) {
+    if (pending[i] == 0) {
+      m_order.append(i);
+    }
+  }
+  for (int i=0; i<m_order.count(); ++i) {
+    const WorkUnit& u = work[m_order.at(i)];
+    for (int d=0; d<u.dependentCount; ++d) {
+      const int dep = u.dependents[d] - work;
+      if (--pending[dep] == 0) {
+        m_order.append(dep);
+      }
+    }
+  }
+  Q_ASSERT(m_order.count() == count); // Otherwise there is a cycle
+
+  // Everything before a unit is before its dependents too
+  m_before = QVector<QBitArray>(count, QBitArray(count));
+  for (int i=0; i<m_order.count(); ++i) {
+    const int unit = m_order.at(i);
+    for (int d=0; d<work[unit].dependentCount; ++d) {
+      QBitArray& before = m_before[work[unit].dependents[d] - work];
+      before |= m_before.at(unit);
+      before.setBit(unit);
+    }
+  }
+}
+
+
+void BufferPlanner::planUnit (int unit, BufferProvider& provider)
+{
+  Processor* processor = m_schedule.work[unit].processor;
+  PortMixer* mixer = dynamic_cast<PortMixer*>(processor);
+  if (mixer) {
+    planMixer(unit, mixer, provider);
+    return;
+  }
+  if (processor->parent() != &m_patch) {
+    // Moving a backend port's data, the Backend decides where it lives
+    return;
+  }
+
+  // The buffers we may run in-place on
+  QVector<int> inputs;
+  if (!processor->isInPlaceBroken()) {
+    for (int i=0; i<processor->portCount(); ++i) {
+      Port* port = processor->port(i);
+      if (port->direction() != Input || port->type() != AudioPort) {
+        continue;
+      }
+      const int slot = m_slotOf.value(port, -1);
+      if (slot >= 0 && !inputs.contains(slot)) {
+        inputs.append(slot);
+      }
+    }
+  }
+
+  // Buffers already handed to our other outputs
+  QVector<int> taken;
+  for (int i=0; i<processor->portCount(); ++i) {
+    Port* port = processor->port(i);
+    QVector<int> readers;
+    if (port->direction() != Output || port->type() != AudioPort ||
+        !isPlannable(port, readers)) {
+      continue;
+    }
+
+    int slot = -1;
+    for (int s=0; s<inputs.count() && slot < 0; ++s) {
+      if (!taken.contains(inputs.at(s)) && isFree(inputs.at(s), unit, true)) {
+        slot = inputs.at(s);
+      }
+    }
+    for (int s=0; s<m_slots.count() && slot < 0; ++s) {
+      if (!taken.contains(s) && isFree(s, unit, false)) {
+        slot = s;
+      }
+    }
+    if (slot < 0) {
+      slot = addSlot(provider.acquire(AudioPort, m_length));
+    }
+    taken.append(slot);
+
+    // Whoever takes the slot next must come after all of these.  Anything that used it
+    // before comes before us, so it doesn't need to be remembered.
+    Slot& s = m_slots[slot];
+    s.users = readers;
+    s.users.append(unit);
+
+    assign(port, slot);
+    for (QSet<Port* const>::const_iterator pi = port->connectionsBegin();
+         pi != port->connectionsEnd(); ++pi) {
+      // Mixed inputs are given a buffer of their own by their mixer
+      if (!PortMixer::isMixed(*pi)) {
+        assign(*pi, slot);
+      }
+    }
+  }
+}
+
+
+void BufferPlanner::planMixer (int unit, PortMixer* mixer, BufferProvider& provider)
+{
+  Port* port = mixer->mixedPort();
+  const WorkUnit& u = m_schedule.work[unit];
+  Q_ASSERT(u.dependentCount == 1);
+  const int reader = u.dependents[0] - m_schedule.work;
+  if (u.dependents[0]->processor->parent() != &m_patch) {
+    // Mixing for a backend port, the Backend decides where its data lives
+    return;
+  }
+  // A processor that isn't active yet has no buffer to mix into, it gets one here too
+
+  // Accumulate into the buffer of one of the producers if nobody else reads it
+  int slot = -1;
+  for (QSet<Port* const>::const_iterator pi = port->connectionsBegin();
+       pi != port->connectionsEnd() && slot < 0; ++pi) {
+    const int s = m_slotOf.value(*pi, -1);
+    if (s >= 0 && isFree(s, unit, true)) {
+      slot = s;
+    }
+  }
+  for (int s=0; s<m_slots.count() && slot < 0; ++s) {
+    if (isFree(s, unit, false)) {
+      slot = s;
+    }
+  }
+  if (slot < 0) {
+    slot = addSlot(provider.acquire(AudioPort, m_length));
+  }
+
+  Slot& s = m_slots[slot];
+  s.users.clear();
+  s.users.append(reader);
+  s.users.append(unit);
+  assign(port, slot);
+}
+
+
+void BufferPlanner::resizeUnit (int unit, BufferProvider& provider)
+{
+  Processor* processor = m_schedule.work[unit].processor;
+  for (int i=0; i<processor->portCount(); ++i) {
+    Port* port = processor->port(i);
+    if (port->type() != AudioPort || m_slotOf.contains(port) || !isStale(port)) {
+      continue;
+    }
+
+    int slot = -1;
+    if (port->direction() == Output) {
+      slot = addSlot(provider.acquire(AudioPort, m_length));
+    }
+    else {
+      QSet<Port* const>::const_iterator pi = port->connectionsBegin();
+      QSet<Port* const>::const_iterator end = port->connectionsEnd();
+      if (pi == end) {
+        if (m_zeroSlot < 0) {
+          m_zeroSlot = addSlot(provider.zeroAudioBuffer());
+        }
+        slot = m_zeroSlot;
+      }
+      else {
+        // Reading the producer's buffer, which has been replaced if it had to be, or
+        // mixing into one of our own
+        Port* producer = *pi;
+        if (++pi == end) {
+          slot = m_slotOf.value(producer, -1);
+        }
+        else {
+          slot = addSlot(provider.acquire(AudioPort, m_length));
+        }
+      }
+    }
+    if (slot >= 0) {
+      assign(port, slot);
+    }
+  }
+}
+
+
+bool BufferPlanner::isPlannable (Port* output, QVector<int>& readers) const
+{
+  if (!output->buffer()) {
+    // Not activated yet
+    return false;
+  }
+  for (QSet<Port* const>::const_iterator pi = output->connectionsBegin();
+       pi != output->connectionsEnd(); ++pi) {
+    const int reader = m_compiler.indexOf(*pi);
+    if (reader < 0) {
+      // Somebody we don't schedule reads it, at any time
+      return false;
+    }
+    readers.append(reader);
+  }
+  return true;
+}
+
+
+bool BufferPlanner::isFree (int slot, int unit, bool inPlace) const
+{
+  const QBitArray& before = m_before.at(unit);
+  const QVector<int>& users = m_slots.at(slot).users;
+  for (int i=0; i<users.count(); ++i) {
+    const int user = users.at(i);
+    if (user == unit ? !inPlace : !before.testBit(user)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+bool BufferPlanner::isStale (Port* port) const
+{
+  const AudioBuffer* current = static_cast<const AudioBuffer*>(port->buffer().data());
+  return current && current->length() != m_length;
+}
+
+
+int BufferPlanner::addSlot (const SharedBufferPtr& buffer)
+{
+  Slot fresh;
+  fresh.buffer = buffer;
+  m_slots.append(fresh);
+  return m_slots.count() - 1;
+}
+
+
+void BufferPlanner::assign (Port* port, int slot)
+{
+  m_slotOf.insert(port, slot);
+  const Schedule::BufferAssignment a = { port, slot };
+  m_schedule.bufferAssignments.append(a);
+  m_schedule.previousBuffers.append(port->buffer());
+  port->setBuffer(m_slots.at(slot).buffer);
+}
+
+  } // Internal
+} // Unison
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
@@ -0,0 +1,114 @@
+/*
+ * BufferPlanner.hpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef UNISON_BUFFER_PLANNER_HPP_
+#define UNISON_BUFFER_PLANNER_HPP_
+
+#include "BufferProvider.hpp"
+
+#include <QBitArray>
+#include <QHash>
+#include <QVector>
+
+namespace Unison {
+
+  class Patch;
+  class Port;
+
+  namespace Internal {
+
+    class PortMixer;
+    class Schedule;
+    class ScheduleCompiler;
+
+/**
+ * Decides which audio buffers the ports of a compiled Schedule share, so a period only
+ * touches as many buffers as are ever live at once, instead of one per output port.
+ *
+ * Workers may run the units in any order the dependencies allow, so two ports may only
+ * share a buffer if every unit using the first one happens before the unit writing the
+ * second.  The planner walks the units in topological order and hands each audio output
+ * of a child processor a buffer whose previous users are all ancestors of its unit.
+ * Processors that aren't inPlaceBroken prefer the buffer of one of their own inputs,
+ * so a chain of effects runs in a single buffer.
+ *
+ * An input with several connections is mixed into a buffer by its PortMixer, which
+ * accumulates into the buffer of one of the producers when nothing else reads that.
+ *
+ * Outputs read by something outside the graph, and the ports of the Backend, keep their
+ * own buffers.  Unless the buffer length has changed: then every other audio port whose
+ * buffer has the old length is handed a new one too, so publishing the schedule moves
+ * the whole graph to the new length at once.  Not RT-safe. */
+class BufferPlanner
+{
+  Q_DISABLE_COPY(BufferPlanner)
+
+  public:
+    /**
+     * @param patch the Patch that compiled @p schedule
+     * @param schedule the freshly compiled schedule to assign buffers for */
+    BufferPlanner (Patch& patch, Schedule& schedule);
+
+    /**
+     * Fill in the buffers and assignments of the schedule, and set the buffer() of the
+     * ports.  The processing thread gets them when the schedule is published.
+     * @param provider where to acquire the shared buffers from */
+    void plan (BufferProvider& provider);
+
+  private:
+    /**
+     * A buffer of the plan, and the units using the port that currently lives in it */
+    struct Slot
+    {
+      SharedBufferPtr buffer;
+      QVector<int> users;
+    };
+
+    void findAncestors ();
+    void planUnit (int unit, BufferProvider& provider);
+    void planMixer (int unit, PortMixer* mixer, BufferProvider& provider);
+    void resizeUnit (int unit, BufferProvider& provider);
+    bool isPlannable (Port* output, QVector<int>& readers) const;
+    bool isFree (int slot, int unit, bool inPlace) const;
+    bool isStale (Port* port) const;
+    int addSlot (const SharedBufferPtr& buffer);
+    void assign (Port* port, int slot);
+
+    Patch& m_patch;
+    ScheduleCompiler& m_compiler;
+    Schedule& m_schedule;
+    QVector<int> m_order;         ///< Units in topological order
+    QVector<QBitArray> m_before;  ///< Units that always finish before each unit starts
+    QVector<Slot> m_slots;
+    QHash<const Port*, int> m_slotOf; ///< Slot of every assigned port
+    nframes_t m_length;           ///< Length of the buffers handed out
+    int m_zeroSlot;               ///< Slot holding the zero buffer, once needed
+};
+
+  } // Internal
+} // Unison
+
+#endif
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
@@ -27,8 +27,6 @@
 
 #include "Buffer.hpp"
 
-#include <QSharedPointer>
-
 namespace Unison {
     
   enum PortType;
@@ -54,14 +52,23 @@ class BufferProvider
 
     /**
      * Aquire a buffer of requested type and size.  This function is expected to succeed.
-     * Calling this function may cause a heap allocation.  More thought needs to go into
-     * calling acquire() from RT code.
+     * Calling this function may cause a heap allocation, so it must not be called from
+     * RT code, use acquireRT() there instead.
      * @param type The type of buffer to acquire
      * @param nframes The (minimum) size of the buffer to acquire
      * @returns The newly allocated, or recycled, buffer
      */
     virtual SharedBufferPtr acquire (PortType type, nframes_t nframes) = 0;
 
+    /**
+     * Aquire a buffer of requested type and the current length from the processing
+     * thread.  This function never allocates, so it fails when nothing is left to
+     * recycle.  RT-safe.
+     * @param type The type of buffer to acquire
+     * @returns A recycled buffer, or a null pointer if none are free
+     */
+    virtual SharedBufferPtr acquireRT (PortType type) = 0;
+
     /**
      * "Zero" buffers are handy for unconnected input-ports.  A Shared pointer to shared
      * data is returned since a zero buffer always has the same data (all silence)
@@ -69,6 +76,20 @@ class BufferProvider
      */
     virtual SharedBufferPtr zeroAudioBuffer () const = 0;
 
+    /**
+     * Change the length of the audio buffers handed out from now on, including the zero
+     * buffer.  Buffers already acquired keep their length and stay valid until they are
+     * released, so the processing thread can use them until it is handed new ones, see
+     * Patch::setBufferLength().  Not RT-safe.
+     * @param nframes The new period length, in frames
+     */
+    virtual void setBufferLength (nframes_t nframes) = 0;
+
+    /**
+     * @returns the length, in frames, of the audio buffers handed out
+     */
+    virtual nframes_t bufferLength () const = 0;
+
   protected:
     /**
      * Releases the buffer, buf.  Visibility is protected since this function should only
@@ -90,27 +111,102 @@ class BufferProvider
  * A Smart-pointer to a Buffer.  Provides a reference-counted pointer to a Buffer.  This
  * allows multiple Ports to reference the same buffer without the complexity of ownership.
  * The Buffer is returned to the BufferProvider when no more references to this Buffer
- * exist.
+ * exist.  The count lives in the Buffer itself, so neither taking a reference nor
+ * dropping the last one allocates, and both are RT-safe.
  * @seealso BufferProvider::release()
  */
-class SharedBufferPtr : public QSharedPointer<Buffer>
+class SharedBufferPtr
 {
+  typedef Buffer* SharedBufferPtr::*RestrictedBool;
+
   public:
     SharedBufferPtr () :
-      QSharedPointer<Buffer>()
+      m_buffer(NULL)
     {}
 
     SharedBufferPtr (Buffer* buf) :
-      QSharedPointer<Buffer>( buf, SharedBufferPtr::deleter )
-    {}
+      m_buffer(buf)
+    {
+      ref(m_buffer);
+    }
+
+    SharedBufferPtr (const SharedBufferPtr& other) :
+      m_buffer(other.m_buffer)
+    {
+      ref(m_buffer);
+    }
+
+    ~SharedBufferPtr ()
+    {
+      deref(m_buffer);
+    }
+
+    SharedBufferPtr& operator= (const SharedBufferPtr& other)
+    {
+      // Take the new reference first, in case both point at the same buffer
+      Buffer* old = m_buffer;
+      m_buffer = other.m_buffer;
+      ref(m_buffer);
+      deref(old);
+      return *this;
+    }
+
+    Buffer* data () const
+    {
+      return m_buffer;
+    }
+
+    Buffer* operator-> () const
+    {
+      return m_buffer;
+    }
+
+    Buffer& operator* () const
+    {
+      return *m_buffer;
+    }
+
+    bool isNull () const
+    {
+      return m_buffer == NULL;
+    }
+
+    bool operator! () const
+    {
+      return m_buffer == NULL;
+    }
+
+    operator RestrictedBool () const
+    {
+      return m_buffer ? &SharedBufferPtr::m_buffer : NULL;
+    }
+
+    bool operator== (const SharedBufferPtr& other) const
+    {
+      return m_buffer == other.m_buffer;
+    }
+
+    bool operator!= (const SharedBufferPtr& other) const
+    {
+      return m_buffer != other.m_buffer;
+    }
 
   private:
-    static void deleter (Buffer* buf)
+    static void ref (Buffer* buf)
     {
       if (buf) {
+        buf->m_refCount.ref();
+      }
+    }
+
+    static void deref (Buffer* buf)
+    {
+      if (buf && !buf->m_refCount.deref()) {
         buf->m_provider.release(buf);
       }
     }
+
+    Buffer* m_buffer;
 };
 
 } // Unison
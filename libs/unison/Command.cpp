@@ -23,6 +23,7 @@
  */
 
 #include "Command.hpp"
+#include "CommandPool.hpp"
 #include "Commander.hpp"
 
 #include <QtCore/QtGlobal>
@@ -36,6 +37,18 @@ Command::Command (bool blocking) :
 {}
 
 
+void* Command::operator new (size_t size)
+{
+  return Internal::CommandPool::allocate(size);
+}
+
+
+void Command::operator delete (void* p)
+{
+  Internal::CommandPool::free(p);
+}
+
+
 void Command::preExecute ()
 {
   Q_ASSERT(m_state == Created);
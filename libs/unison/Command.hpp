@@ -26,6 +26,8 @@
 #ifndef UNISON_COMMAND_HPP_
 #define UNISON_COMMAND_HPP_
 
+#include <stddef.h>
+
 namespace Unison {
 
   class ProcessingContext;
@@ -34,8 +36,8 @@ namespace Unison {
  * Command is an implementation of the GoF Command pattern designed to help with RT
  * compliance.  This allows the client to instantiate a command, then allows it to be
  * executed across multiple contexts: non-RT for setup, RT for execution, non-RT for
- * tear-down.  Commands are allocated and queued in RingBuffer for syscall-free and
- * lockless execution.
+ * tear-down.  Commands are allocated from a pool and queued for syscall-free and
+ * lockless execution, see CommandPool.
  */
 class Command
 {
@@ -56,6 +58,13 @@ class Command
     virtual ~Command ()
     {};
 
+    /**
+     * Commands are recycled through the CommandPool rather than the heap, so creating
+     * and deleting them doesn't allocate.
+     */
+    static void* operator new (size_t size);
+    static void operator delete (void* p);
+
     /**
      * preExecute is for preparing the command to be executed.  This function is called
      * outside of the processing thread.  Therefore, it is safe to call non-realtime-safe
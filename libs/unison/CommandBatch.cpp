@@ -0,0 +1,86 @@
+/*
+ * CommandBatch.cpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include "CommandBatch.hpp"
+
+#include <QtCore/QtGlobal>
+
+namespace Unison {
+  namespace Internal {
+
+
+CommandBatch::CommandBatch () :
+  Command(false),
+  m_blockingCount(0)
+{
+  setState(Command::Created);
+}
+
+
+CommandBatch::~CommandBatch ()
+{
+  qDeleteAll(m_commands);
+}
+
+
+void CommandBatch::append (Command* command)
+{
+  Q_ASSERT(command->state() == Command::PreExecuted);
+  m_commands.append(command);
+  if (command->isBlocking()) {
+    ++m_blockingCount;
+  }
+}
+
+
+void CommandBatch::preExecute ()
+{
+  // Our Commands were pre-executed when they were appended
+  Command::preExecute();
+}
+
+
+void CommandBatch::execute (ProcessingContext& context)
+{
+  for (int i=0; i<m_commands.count(); ++i) {
+    m_commands.at(i)->execute(context);
+  }
+  Command::execute(context);
+}
+
+
+void CommandBatch::postExecute ()
+{
+  for (int i=0; i<m_commands.count(); ++i) {
+    m_commands.at(i)->postExecute();
+  }
+  Command::postExecute();
+}
+
+
+  } // Internal
+} // Unison
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
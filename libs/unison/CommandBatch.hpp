@@ -0,0 +1,82 @@
+/*
+ * CommandBatch.hpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef UNISON_COMMAND_BATCH_HPP_
+#define UNISON_COMMAND_BATCH_HPP_
+
+#include "Command.hpp"
+
+#include <QList>
+
+namespace Unison {
+  namespace Internal {
+
+/**
+ * Many Commands that the processing thread executes together, in a single period, so
+ * it never runs the graph in a state halfway through the batch.  Commands are
+ * pre-executed as they are appended, the batch only takes them through execution and
+ * post-execution in order, and then deletes them.  Batches are normally built by the
+ * Commander between beginBatch() and endBatch(), see Patch::beginEdit().
+ */
+class CommandBatch : public Command
+{
+  public:
+    CommandBatch ();
+    ~CommandBatch ();
+
+    /**
+     * Take ownership of @p command.  Not RT-safe.
+     * @param command a Command that has already been pre-executed */
+    void append (Command* command);
+
+    /**
+     * @returns the number of Commands in the batch */
+    int count () const
+    {
+      return m_commands.count();
+    }
+
+    /**
+     * @returns the number of Commands in the batch that release the Commander once
+     *          they are post-executed */
+    int blockingCount () const
+    {
+      return m_blockingCount;
+    }
+
+    void preExecute ();
+    void execute (ProcessingContext& context);
+    void postExecute ();
+
+  private:
+    QList<Command*> m_commands;
+    int m_blockingCount;
+};
+
+  } // Internal
+} // Unison
+
+#endif
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
@@ -0,0 +1,170 @@
+/*
+ * CommandPool.cpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include "CommandPool.hpp"
+
+#include "LockFreeStack.hpp"
+#include "RtArena.hpp"
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QDebug>
+
+namespace Unison {
+  namespace Internal {
+
+/**
+ * Equally sized slots in one block of the RtArena, the free ones on a stack */
+class SlotClass
+{
+  Q_DISABLE_COPY(SlotClass)
+
+  public:
+    SlotClass (size_t slotSize, int slotCount) :
+      m_slotSize(slotSize),
+      m_free(slotCount)
+    {
+      m_begin = static_cast<char*>(RtArena::allocate(slotSize * slotCount));
+      m_end = m_begin + slotSize * slotCount;
+      for (int i=0; i<slotCount; ++i) {
+        m_free.push(i);
+      }
+    }
+
+    size_t slotSize () const
+    {
+      return m_slotSize;
+    }
+
+    bool contains (const void* p) const
+    {
+      return p >= m_begin && p < m_end;
+    }
+
+    void* take ()
+    {
+      int slot;
+      if (!m_free.pop(slot)) {
+        return NULL;
+      }
+      return m_begin + m_slotSize * slot;
+    }
+
+    void give (void* p)
+    {
+      m_free.push(int((static_cast<char*>(p) - m_begin) / m_slotSize));
+    }
+
+  private:
+    const size_t m_slotSize;
+    char* m_begin;
+    char* m_end;
+    LockFreeStack<int> m_free;
+};
+
+
+enum {
+  CLASS_COUNT = 4,
+  SMALLEST_CLASS = 64   ///< Each class is twice the size of the previous one
+};
+
+static SlotClass* s_classes[CLASS_COUNT] = { NULL, NULL, NULL, NULL };
+static QAtomicInt s_inUse;
+static volatile int s_peak = 0;
+static QAtomicInt s_fallbacks;
+
+
+void CommandPool::initialize (int slotCount)
+{
+  Q_ASSERT(s_classes[0] == NULL);
+  size_t size = SMALLEST_CLASS;
+  for (int i=0; i<CLASS_COUNT; ++i) {
+    s_classes[i] = new SlotClass(size, slotCount);
+    size *= 2;
+  }
+}
+
+
+void* CommandPool::allocate (size_t size)
+{
+  if (s_classes[0]) {
+    for (int i=0; i<CLASS_COUNT; ++i) {
+      if (size <= s_classes[i]->slotSize()) {
+        void* p = s_classes[i]->take();
+        if (p) {
+          const int inUse = s_inUse.fetchAndAddRelaxed(1) + 1;
+          if (inUse > s_peak) {
+            s_peak = inUse;
+          }
+          return p;
+        }
+        break;
+      }
+    }
+    s_fallbacks.ref();
+  }
+  return ::operator new(size);
+}
+
+
+void CommandPool::free (void* p)
+{
+  if (!p) {
+    return;
+  }
+  if (s_classes[0]) {
+    for (int i=0; i<CLASS_COUNT; ++i) {
+      if (s_classes[i]->contains(p)) {
+        s_classes[i]->give(p);
+        s_inUse.deref();
+        return;
+      }
+    }
+  }
+  ::operator delete(p);
+}
+
+
+CommandPool::Usage CommandPool::usage ()
+{
+  Usage u;
+  u.inUse = s_inUse;
+  u.peak = s_peak;
+  u.fallbacks = s_fallbacks;
+  return u;
+}
+
+
+QDebug operator<< (QDebug dbg, const CommandPool::Usage& usage)
+{
+  dbg.nospace() << "Command pool: " << usage.inUse << " in use, "
+                << usage.peak << " peak, " << usage.fallbacks << " heap fallbacks";
+  return dbg.space();
+}
+
+
+  } // Internal
+} // Unison
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
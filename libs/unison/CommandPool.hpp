@@ -0,0 +1,85 @@
+/*
+ * CommandPool.hpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef UNISON_COMMAND_POOL_HPP_
+#define UNISON_COMMAND_POOL_HPP_
+
+#include <QtCore/QtGlobal>
+#include <stddef.h>
+
+class QDebug;
+
+namespace Unison {
+  namespace Internal {
+
+/**
+ * Process-wide storage for Commands, so pushing one never touches the heap.  Commands
+ * are recycled through lock-free free lists, one per size class, carved out of the
+ * RtArena when the pool is initialized.  Command::operator new and delete go through
+ * here.  Before initialize() is called, for Commands bigger than the largest class, or
+ * once a class has run dry, the general heap is used instead.  Allocating and freeing
+ * never take a lock. */
+class CommandPool
+{
+  public:
+    enum {
+      SLOT_COUNT = 1024 ///< Default number of Commands of each size class
+    };
+
+    /**
+     * How the pool is being used */
+    struct Usage
+    {
+      int inUse;      ///< Slots holding a Command right now
+      int peak;       ///< Highest inUse so far
+      int fallbacks;  ///< Commands that had to come from the heap
+    };
+
+    /**
+     * Set the slots aside.  Must be called once, after RtArena::initialize() and before
+     * any Command is created.
+     * @param slotCount the number of Commands each size class can hold */
+    static void initialize (int slotCount = SLOT_COUNT);
+
+    /**
+     * @returns storage for a Command of @p size bytes */
+    static void* allocate (size_t size);
+
+    /**
+     * Recycle storage from allocate(), NULL is ignored */
+    static void free (void* p);
+
+    /**
+     * @returns a snapshot of the pool's usage */
+    static Usage usage ();
+};
+
+QDebug operator<< (QDebug dbg, const CommandPool::Usage& usage);
+
+  } // Internal
+} // Unison
+
+#endif
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
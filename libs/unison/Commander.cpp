@@ -24,11 +24,15 @@
 
 #include "Commander.hpp"
 #include "Command.hpp"
+#include "CommandBatch.hpp"
+#include "CommandPool.hpp"
 #include "PostExecuter.hpp"
+#include "Profiler.hpp"
 
 #include <QtCore/QtDebug>
 #include <QtCore/QMutex>
 #include <QtCore/QMutexLocker>
+#include <QtCore/QThread>
 
 namespace Unison {
   namespace Internal {
@@ -38,16 +42,27 @@ Commander* Commander::m_instance = static_cast<Commander*>(NULL);
 void Commander::initialize ()
 {
   Q_ASSERT(m_instance == NULL);
+  CommandPool::initialize();
   m_instance = new Commander();
 }
 
 
 Commander::Commander () :
-  m_writeLock(),
+  m_editLock(QMutex::Recursive),
+  m_batch(NULL),
+  m_batchDepth(0),
   m_blockWait(),
-  m_buffer(COMMAND_BUFFER_LENGTH)
+  m_queue(COMMAND_QUEUE_LENGTH),
+  m_epoch(),
+  m_budget(DEFAULT_BUDGET),
+  m_peakDepth(0),
+  m_executed(0),
+  m_totalLatency(0),
+  m_maxLatency(0),
+  m_overruns(0),
+  m_stalls(0)
 {
-  m_postExecuter = new PostExecuter();
+  m_postExecuter = new PostExecuter(m_epoch);
   m_postExecuter->start();
 }
 
@@ -63,25 +78,201 @@ void Commander::push (Command* command)
 {
   bool block = command->isBlocking();
 
-  QMutexLocker locker(&m_writeLock);
+  // preExecute edits the graph, and the processing thread must see Commands in the
+  // order they were prepared, so producers take turns preparing and claiming their
+  // place in the queue.  Waiting for room happens after, so a full queue never holds
+  // up the others.  A blocking Command keeps the lock until it is post-executed,
+  // nothing else is prepared before then.  The processing thread never takes this lock.
+  QMutexLocker locker(&m_editLock);
   command->preExecute();
-  m_buffer.write(&command, 1);
+
+  if (m_batch) {
+    // The batch blocks for us once it is queued
+    m_batch->append(command);
+    return;
+  }
+
+  const unsigned ticket = m_queue.claim();
+  if (!block) {
+    locker.unlock();
+  }
+  publish(ticket, command);
   if (block) {
     m_blockWait.acquire();
   }
 }
 
 
+void Commander::beginBatch ()
+{
+  // Held until the matching endBatch, so the batch is all ours
+  m_editLock.lock();
+  if (m_batchDepth++ == 0) {
+    m_batch = new CommandBatch();
+  }
+}
+
+
+void Commander::endBatch ()
+{
+  Q_ASSERT(m_batchDepth > 0);
+  if (--m_batchDepth > 0) {
+    m_editLock.unlock();
+    return;
+  }
+
+  CommandBatch* batch = m_batch;
+  m_batch = NULL;
+  if (batch->count() == 0) {
+    delete batch;
+    m_editLock.unlock();
+    return;
+  }
+
+  // Same as push()
+  const int blocking = batch->blockingCount();
+  batch->preExecute();
+  const unsigned ticket = m_queue.claim();
+  if (blocking == 0) {
+    m_editLock.unlock();
+  }
+  publish(ticket, batch);
+  if (blocking > 0) {
+    m_blockWait.acquire(blocking);
+    m_editLock.unlock();
+  }
+}
+
+
+void Commander::publish (unsigned ticket, Command* command)
+{
+  Queued queued;
+  queued.command = command;
+  queued.pushed = Profiler::now();
+  if (!m_queue.fill(ticket, queued)) {
+    __sync_fetch_and_add(&m_stalls, 1);
+    forever {
+      const int key = m_space.prepareWait();
+      if (m_queue.fill(ticket, queued)) {
+        m_space.cancelWait();
+        break;
+      }
+      m_space.wait(key);
+    }
+  }
+}
+
+
 void Commander::process (ProcessingContext& context)
 {
-  Command* commands[COMMANDS_PER_PROCESS];
-  int cnt = m_buffer.read(commands, COMMANDS_PER_PROCESS);
+  const int depth = m_queue.count();
+  if (depth == 0) {
+    return;
+  }
+  if (depth > m_peakDepth) {
+    m_peakDepth = depth;
+  }
+
+  executeQueued(context, depth, qint64(m_budget) * 1000);
+  if (m_queue.count() > 0) {
+    ++m_overruns;
+  }
+}
+
+
+void Commander::drain (ProcessingContext& context)
+{
+  // Only what is queued now, producers may keep pushing
+  int remaining = m_queue.count();
+  if (remaining > m_peakDepth) {
+    m_peakDepth = remaining;
+  }
+
+  while (remaining > 0) {
+    remaining -= executeQueued(context, remaining, -1);
+    if (remaining > 0) {
+      // The PostExecuter is full, or a push is still being published
+      m_postExecuter->wake();
+      QThread::yieldCurrentThread();
+    }
+  }
+}
+
+
+int Commander::executeQueued (ProcessingContext& context, int limit, qint64 budget)
+{
+  const qint64 start = Profiler::now();
+  qint64 now = start;
+  int executed = 0;
+  Queued queued;
+
+  // The PostExecuter can't wait, so leave Commands queued while it is full
+  while (executed < limit && m_postExecuter->hasRoom() && m_queue.pop(queued)) {
+    ++executed;
+
+    const qint64 latency = now - queued.pushed;
+    m_totalLatency += latency;
+    if (latency > m_maxLatency) {
+      m_maxLatency = latency;
+    }
+    ++m_executed;
+
+    queued.command->execute(context);
+    m_postExecuter->push(queued.command);
 
-  for (int i=0; i<cnt; ++i) {
-    commands[i]->execute(context);
-    m_postExecuter->push(commands[i]);
+    now = Profiler::now();
+    if (budget >= 0 && now - start >= budget) {
+      break;
+    }
   }
 
+  if (executed > 0) {
+    m_space.notifyAll();
+    m_postExecuter->wake();
+  }
+  return executed;
+}
+
+
+Commander::Stats Commander::stats () const
+{
+  Stats s;
+  s.depth = m_queue.count();
+  s.peakDepth = m_peakDepth;
+  s.executed = m_executed;
+  s.meanLatency = s.executed ? int(m_totalLatency / s.executed / 1000) : 0;
+  s.maxLatency = int(m_maxLatency / 1000);
+  s.overruns = m_overruns;
+  s.stalls = m_stalls;
+
+  const PostExecuter::Latency recycle = m_postExecuter->recycleLatency();
+  s.meanRecycle = recycle.count ? int(recycle.total / recycle.count / 1000) : 0;
+  s.maxRecycle = int(recycle.max / 1000);
+  const PostExecuter::Latency reclaim = m_postExecuter->reclaimLatency();
+  s.meanReclaim = reclaim.count ? int(reclaim.total / reclaim.count / 1000) : 0;
+  s.maxReclaim = int(reclaim.max / 1000);
+  return s;
+}
+
+
+void Commander::retire (Schedule* schedule, int epoch)
+{
+  m_postExecuter->retire(schedule, epoch);
+}
+
+
+QDebug operator<< (QDebug dbg, const Commander::Stats& stats)
+{
+  dbg.nospace() << "Commands: " << stats.executed << " executed, "
+                << stats.depth << " queued, " << stats.peakDepth << " peak queued, "
+                << stats.meanLatency << " usec mean latency, "
+                << stats.maxLatency << " usec max latency, "
+                << stats.overruns << " overruns, " << stats.stalls << " stalled pushes, "
+                << stats.meanRecycle << " usec mean recycle, "
+                << stats.maxRecycle << " usec max recycle, "
+                << stats.meanReclaim << " usec mean schedule reclaim, "
+                << stats.maxReclaim << " usec max schedule reclaim";
+  return dbg.space();
 }
 
 
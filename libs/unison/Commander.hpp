@@ -26,11 +26,15 @@
 #ifndef UNISON_COMMANDER_HPP_
 #define UNISON_COMMANDER_HPP_
 
-#include "RingBuffer.hpp"
+#include "Epoch.hpp"
+#include "EventCount.hpp"
+#include "MpscQueue.hpp"
 
 #include <QtCore/QSemaphore>
 #include <QtCore/QMutex>
 
+class QDebug;
+
 namespace Unison {
 
   class Command;
@@ -38,7 +42,9 @@ namespace Unison {
 
   namespace Internal {
 
+    class CommandBatch;
     class PostExecuter;
+    class Schedule;
 
 /**
  * Commander is a centralized place for components to queue commands that require
@@ -51,10 +57,35 @@ class Commander
 {
   Q_DISABLE_COPY(Commander)
   public:
+    enum {
+      COMMAND_QUEUE_LENGTH = 1024,  ///< Commands that can wait for the processing thread
+      DEFAULT_BUDGET = 100          ///< Default time for Commands per period, in usec
+    };
+
+    /**
+     * How the queue has been doing since the Commander was created.  Updated by the
+     * processing thread without locking, so the values may be slightly out of step with
+     * each other. */
+    struct Stats
+    {
+      int depth;        ///< Commands queued right now
+      int peakDepth;    ///< Most Commands found queued at the start of a period
+      int executed;     ///< Commands executed so far
+      int meanLatency;  ///< Mean time from push to execute, in usec
+      int maxLatency;   ///< Longest time from push to execute, in usec
+      int overruns;     ///< Periods that ended with Commands still queued
+      int stalls;       ///< Pushes that had to wait for room in the queue
+      int meanRecycle;  ///< Mean time from execute to being deleted, in usec
+      int maxRecycle;   ///< Longest time from execute to being deleted, in usec
+      int meanReclaim;  ///< Mean time from a Schedule being retired to freed, in usec
+      int maxReclaim;   ///< Longest time from a Schedule being retired to freed, in usec
+    };
+
     ~Commander ();
 
     /**
-     * Initialize the static Commander instance
+     * Initialize the static Commander instance, and the CommandPool.  Must be called
+     * after RtArena::initialize().
      */
     static void initialize();
 
@@ -73,11 +104,28 @@ class Commander
      * called from a normal context. Later, the Command's execute will fire at the
      * beginning of the processing thread's process function.  postExecute will be called
      * eventually.  Finally, the  Command is deleted.  This function will block until the
-     * Command is postExecuted if the Command has isBlocking=true.
+     * Command is postExecuted if the Command has isBlocking=true.  If the queue is full,
+     * it waits for the processing thread to make room, Commands are never dropped.
      * @param command The command to enqueue
      */
     void push (Command* command);
 
+    /**
+     * Start collecting pushed Commands into a single CommandBatch, instead of queueing
+     * them one by one.  They are still pre-executed right away, in order, but the
+     * processing thread executes all of them in the same period once the matching
+     * endBatch() is called.  Other threads pushing in the meantime wait for the batch
+     * to end.  Batches may be nested, only the outermost one is queued.
+     */
+    void beginBatch ();
+
+    /**
+     * Finish a batch started with beginBatch().  When the outermost batch ends, it is
+     * queued as one Command.  Blocks until it is post-executed if any Command in it is
+     * blocking.
+     */
+    void endBatch ();
+
     /**
      * Releases the block (counting semaphore).  This function must only be called from
      * blocking Commands within the postExecute method.  The Command must call release
@@ -92,10 +140,58 @@ class Commander
      * Process Commands needing to be executed during this processing pass.  MUST be
      * called in realtime. MUST NOT be called while the graph is actually process()ing.
      * This function will probably only ever be called by Backend's processing logic.
+     * Commands are executed in the order they were pushed until the budget is used up,
+     * at least one is executed per period.
      * @param context The current processing context
      */
     void process (ProcessingContext& context);
 
+    /**
+     * Execute every Command queued so far, regardless of the budget, waiting for the
+     * PostExecuter if need be.  For backends without a deadline, like offline
+     * rendering, so a period never starts before the edits pushed ahead of it are
+     * applied.  Same rules as process() otherwise.
+     * @param context The current processing context
+     */
+    void drain (ProcessingContext& context);
+
+    /**
+     * The Epoch of the processing thread.  The Backend must enter() it before calling
+     * process() and leave() it once the whole graph has been processed.
+     */
+    Epoch& epoch ()
+    {
+      return m_epoch;
+    }
+
+    /**
+     * Free a Schedule that has been replaced, once the processing thread can no longer
+     * see it.  Must only be called from Command::postExecute.
+     * @param schedule the replaced Schedule
+     * @param epoch epoch().current() at the time @p schedule was replaced
+     */
+    void retire (Schedule* schedule, int epoch);
+
+    /**
+     * Set how long process() may keep executing Commands in a single period.  Any
+     * thread may call this.
+     * @param usec the budget, in microseconds */
+    void setBudget (int usec)
+    {
+      m_budget = usec;
+    }
+
+    /**
+     * @returns how long process() may keep executing Commands, in microseconds */
+    int budget () const
+    {
+      return m_budget;
+    }
+
+    /**
+     * @returns a snapshot of the queue statistics */
+    Stats stats () const;
+
   protected:
     /**
      * Construct a Commander, must use the static initialize() function instead
@@ -103,20 +199,53 @@ class Commander
     Commander ();
 
   private:
-    enum {
-      COMMAND_BUFFER_LENGTH = 1024,   ///< How big is our buffer?
-      COMMANDS_PER_PROCESS =  8       ///< How many commands to process per period
+    /**
+     * A Command waiting for the processing thread */
+    struct Queued
+    {
+      Command* command;
+      qint64 pushed;  ///< Profiler::now() when it was pushed
     };
 
+    /**
+     * Queue an already pre-executed Command in the place claimed for it, waiting for room
+     * if need be.  Only blocking Commands may call this with m_editLock held, they wait
+     * for the processing thread anyway.
+     * @param ticket the position claimed in m_queue while m_editLock was held
+     * @param command the Command */
+    void publish (unsigned ticket, Command* command);
+
+    /**
+     * Execute up to @p limit queued Commands and hand them to the PostExecuter, which
+     * must have room for them.
+     * @param budget time to stop after, in nsec, or negative for no limit
+     * @returns how many were executed */
+    int executeQueued (ProcessingContext& context, int limit, qint64 budget);
+
     static Commander* m_instance;   ///< The instance
-    QMutex m_writeLock;             ///< Protect us from affinity issues
+    QMutex m_editLock;              ///< Producers take turns pre-executing, recursive
+    CommandBatch* m_batch;          ///< Batch being collected, protected by m_editLock
+    int m_batchDepth;               ///< Nesting of beginBatch() calls
     QSemaphore m_blockWait;         ///< Blocking for blocking Commands
 
-    RingBuffer<Command*> m_buffer;  ///< Storage for queued Commands
+    MpscQueue<Queued> m_queue;      ///< Commands waiting to be executed
+    EventCount m_space;             ///< Notified when the queue has room again
+    Epoch m_epoch;                  ///< Periods of the processing thread
+    volatile int m_budget;          ///< Time for Commands per period, in usec
+
+    // Statistics, only written by the processing thread, except m_stalls
+    int m_peakDepth;
+    int m_executed;
+    qint64 m_totalLatency;          ///< Sum of push to execute times, in nsec
+    qint64 m_maxLatency;            ///< In nsec
+    int m_overruns;
+    volatile int m_stalls;          ///< Counted atomically by producers
 
     PostExecuter* m_postExecuter;
 };
 
+QDebug operator<< (QDebug dbg, const Commander::Stats& stats);
+
   } // Internal
 } // Unison
 
@@ -0,0 +1,135 @@
+/*
+ * ControlStream.cpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include "ControlStream.hpp"
+
+#include "RtArena.hpp"
+
+namespace Unison {
+
+
+ControlStream::ControlStream (float value, int capacity) :
+  m_queue(capacity),
+  m_overflow(0),
+  m_latest(value),
+  m_start(0),
+  m_value(value),
+  m_dueCount(0),
+  m_next(0),
+  m_length(0),
+  m_holding(false)
+{
+  // Coalescing means no more than one change per queued one, plus the one held back
+  m_due = static_cast<ControlEvent*>(
+      RtArena::allocate(sizeof(ControlEvent) * (m_queue.capacity() + 1)));
+}
+
+
+ControlStream::~ControlStream ()
+{
+  RtArena::free(m_due);
+}
+
+
+void ControlStream::push (float value, nframes_t time)
+{
+  ControlEvent event;
+  event.time = time;
+  event.value = value;
+  if (!m_queue.push(event)) {
+    m_latest = value;
+    m_overflow.fetchAndStoreOrdered(1);
+  }
+}
+
+
+void ControlStream::push (float value)
+{
+  // Anything at or before the start of the last period is due right away
+  push(value, m_start);
+}
+
+
+void ControlStream::beginPeriod (nframes_t start, nframes_t length)
+{
+  m_start = start;
+  m_length = length;
+  m_dueCount = 0;
+  m_next = 0;
+
+  if (m_overflow.fetchAndStoreOrdered(0)) {
+    // Lost track, skip straight to the last value pushed
+    ControlEvent dropped;
+    while (m_queue.pop(dropped)) {
+    }
+    m_holding = false;
+    due(0, m_latest);
+    return;
+  }
+
+  // Producers may keep pushing while we pop, take no more than fits in m_due
+  for (int popped=0; popped < m_queue.capacity(); ) {
+    if (!m_holding) {
+      if (!m_queue.pop(m_held)) {
+        break;
+      }
+      m_holding = true;
+      ++popped;
+    }
+    // Relative to the period, so the clock may wrap around
+    const int offset = int(m_held.time - start);
+    if (offset >= int(length)) {
+      break;
+    }
+    due(offset > 0 ? nframes_t(offset) : 0, m_held.value);
+    m_holding = false;
+  }
+}
+
+
+void ControlStream::due (nframes_t offset, float value)
+{
+  float previous = m_value;
+  if (m_dueCount > 0) {
+    ControlEvent& last = m_due[m_dueCount - 1];
+    if (offset <= last.time) {
+      // Never before a change pushed earlier, and the last one pushed for a frame wins
+      last.value = value;
+      return;
+    }
+    previous = last.value;
+  }
+  if (value == previous) {
+    return;
+  }
+  m_due[m_dueCount].time = offset;
+  m_due[m_dueCount].value = value;
+  ++m_dueCount;
+}
+
+
+} // Unison
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
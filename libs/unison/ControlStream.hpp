@@ -0,0 +1,147 @@
+/*
+ * ControlStream.hpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef UNISON_CONTROL_STREAM_HPP_
+#define UNISON_CONTROL_STREAM_HPP_
+
+#include "MpscQueue.hpp"
+#include "types.hpp"
+
+#include <QtCore/QAtomicInt>
+
+namespace Unison {
+
+/**
+ * A change of a control value at a given frame */
+struct ControlEvent
+{
+  nframes_t time; ///< Frame the value takes effect at, see Backend::frameTime()
+  float value;    ///< The new value
+};
+
+
+/**
+ * Carries changes of a control input from any thread to the processing thread, so each
+ * one takes effect at the exact frame it was meant for.  Producers push timestamped
+ * values without locking.  Every period, the processing thread picks up the changes due
+ * in it with beginPeriod(), then runs the plugin in blocks from one change to the next,
+ * see nextChange() and apply().
+ *
+ * Changes are coalesced.  Of several changes landing on the same frame only the last
+ * one is kept, and a change to the value already in effect is dropped, so controls
+ * that don't move cost nothing.  Changes take effect in the order they were pushed, one
+ * due before a change pushed earlier takes effect together with it.  Should the queue
+ * overflow, the value pushed last takes effect at the start of the next period instead
+ * of everything queued, so the final value is never lost.
+ */
+class ControlStream
+{
+  Q_DISABLE_COPY(ControlStream)
+
+  public:
+    enum {
+      DEFAULT_CAPACITY = 64 ///< Changes that can wait for the processing thread
+    };
+
+    /**
+     * Not RT-safe.
+     * @param value the value in effect to begin with
+     * @param capacity the most changes that can be queued */
+    ControlStream (float value, int capacity = DEFAULT_CAPACITY);
+    ~ControlStream ();
+
+    /**
+     * Change the value at frame @p time.  May be called from any number of threads at
+     * once.  RT-safe
+     * @param value the new value
+     * @param time when it takes effect, on the clock of Backend::frameTime() */
+    void push (float value, nframes_t time);
+
+    /**
+     * Change the value at the start of the next period.  RT-safe
+     * @param value the new value */
+    void push (float value);
+
+    /**
+     * Collect the changes due in the period starting at @p start, the ones due later
+     * stay queued.  Processing thread only.
+     * @param start ProcessingContext::frameTime() of the period
+     * @param length the length of the period, in frames */
+    void beginPeriod (nframes_t start, nframes_t length);
+
+    /**
+     * @returns the offset into the period of the next change not applied yet, or the
+     *          length of the period if there is none.  Processing thread only. */
+    nframes_t nextChange () const
+    {
+      return m_next < m_dueCount ? m_due[m_next].time : m_length;
+    }
+
+    /**
+     * Apply the changes due up to @p offset into the period.  Processing thread only.
+     * @param offset frames since the start of the period
+     * @param value where the value in effect is kept, only written if it changes */
+    void apply (nframes_t offset, float* value)
+    {
+      if (m_next < m_dueCount && m_due[m_next].time <= offset) {
+        do {
+          m_value = m_due[m_next++].value;
+        } while (m_next < m_dueCount && m_due[m_next].time <= offset);
+        *value = m_value;
+      }
+    }
+
+    /**
+     * @returns the value in effect, as far as the processing thread is concerned.  Safe
+     * to read from the editing thread, e.g. to seed a new buffer */
+    float value () const
+    {
+      return m_value;
+    }
+
+  private:
+    /**
+     * Add a change to the ones due this period, coalescing it with the last one */
+    void due (nframes_t offset, float value);
+
+    Internal::MpscQueue<ControlEvent> m_queue; ///< Changes pushed, oldest first
+    QAtomicInt m_overflow;          ///< Set when a push found the queue full
+    volatile float m_latest;        ///< The value pushed when the queue was full
+    volatile nframes_t m_start;     ///< Start of the period last begun
+    volatile float m_value;         ///< Value in effect, written by the processing thread
+
+    // Processing thread only
+    ControlEvent* m_due;            ///< Changes due this period, time is the offset
+    int m_dueCount;
+    int m_next;                     ///< Index of the next change to apply
+    nframes_t m_length;             ///< Length of the current period
+    ControlEvent m_held;            ///< Change popped early, due in a later period
+    bool m_holding;
+};
+
+} // Unison
+
+#endif
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
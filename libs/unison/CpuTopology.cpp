@@ -0,0 +1,337 @@
+/*
+ * CpuTopology.cpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "CpuTopology.hpp"
+
+#include <QSet>
+#include <QThread>
+#include <QtAlgorithms>
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace Unison {
+
+static const char* const SYSFS_CPU = "/sys/devices/system/cpu";
+static const char* const SYSFS_NODE = "/sys/devices/system/node";
+
+#ifdef CPU_SETSIZE
+static const long MAX_CPUS = CPU_SETSIZE;
+#else
+static const long MAX_CPUS = 1024;
+#endif
+
+
+/**
+ * Read a single integer from a sysfs file
+ * @returns false if the file is missing or does not hold a number */
+static bool readInt (const char* path, int& value)
+{
+  FILE* f = fopen(path, "r");
+  if (!f) {
+    return false;
+  }
+  const bool ok = (fscanf(f, "%d", &value) == 1);
+  fclose(f);
+  return ok;
+}
+
+
+/**
+ * Read a CPU list from a sysfs file
+ * @returns false if the file is missing or malformed */
+static bool readCpuList (const char* path, QList<int>& cpus)
+{
+  FILE* f = fopen(path, "r");
+  if (!f) {
+    return false;
+  }
+  char buf[4096];
+  const bool ok = fgets(buf, sizeof(buf), f) && CpuTopology::parseCpuList(buf, cpus);
+  fclose(f);
+  return ok;
+}
+
+
+/**
+ * Orders CPUs so that those sharing the most come next to each other */
+static bool compactOrder (const CpuInfo& a, const CpuInfo& b)
+{
+  if (a.node != b.node)       return a.node < b.node;
+  if (a.package != b.package) return a.package < b.package;
+  if (a.l3 != b.l3)           return a.l3 < b.l3;
+  if (a.l2 != b.l2)           return a.l2 < b.l2;
+  if (a.core != b.core)       return a.core < b.core;
+  return a.id < b.id;
+}
+
+
+/** @returns a key that is unique for every physical core */
+static inline int coreKey (const CpuInfo& cpu)
+{
+  return (cpu.package << 16) | cpu.core;
+}
+
+
+CpuTopology::CpuTopology ()
+{
+  read();
+}
+
+
+void CpuTopology::read ()
+{
+#ifdef __linux__
+  cpu_set_t set;
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int i=0; i<CPU_SETSIZE; ++i) {
+      if (CPU_ISSET(i, &set)) {
+        m_allowed.append(i);
+      }
+    }
+  }
+#endif
+  if (m_allowed.isEmpty()) {
+    for (int i=0; i<QThread::idealThreadCount(); ++i) {
+      m_allowed.append(i);
+    }
+  }
+
+  m_info.resize(m_allowed.last() + 1);
+  for (int i=0; i<m_info.count(); ++i) {
+    m_info[i].id = -1;
+  }
+
+  char path[256];
+  foreach (int id, m_allowed) {
+    CpuInfo& cpu = m_info[id];
+    cpu.id = id;
+    cpu.node = 0;
+
+    snprintf(path, sizeof(path), "%s/cpu%d/topology/physical_package_id", SYSFS_CPU, id);
+    if (!readInt(path, cpu.package)) {
+      cpu.package = 0;
+    }
+    snprintf(path, sizeof(path), "%s/cpu%d/topology/core_id", SYSFS_CPU, id);
+    if (!readInt(path, cpu.core)) {
+      cpu.core = id;
+    }
+    readCaches(cpu);
+  }
+
+  readNodes();
+}
+
+
+void CpuTopology::readCaches (CpuInfo& cpu)
+{
+  cpu.l2 = -1;
+  cpu.l3 = -1;
+
+  char path[256];
+  for (int index=0; ; ++index) {
+    int level;
+    snprintf(path, sizeof(path), "%s/cpu%d/cache/index%d/level", SYSFS_CPU, cpu.id, index);
+    if (!readInt(path, level)) {
+      break;
+    }
+    if (level != 2 && level != 3) {
+      continue;
+    }
+
+    QList<int> shared;
+    snprintf(path, sizeof(path), "%s/cpu%d/cache/index%d/shared_cpu_list",
+             SYSFS_CPU, cpu.id, index);
+    if (readCpuList(path, shared) && !shared.isEmpty()) {
+      (level == 2 ? cpu.l2 : cpu.l3) = shared.first();
+    }
+  }
+}
+
+
+void CpuTopology::readNodes ()
+{
+  char path[256];
+  QList<int> nodes;
+  snprintf(path, sizeof(path), "%s/possible", SYSFS_NODE);
+  if (!readCpuList(path, nodes)) {
+    return; // No NUMA, everything stays on node 0
+  }
+
+  foreach (int node, nodes) {
+    QList<int> cpus;
+    snprintf(path, sizeof(path), "%s/node%d/cpulist", SYSFS_NODE, node);
+    if (!readCpuList(path, cpus)) {
+      continue;
+    }
+    foreach (int id, cpus) {
+      if (id < m_info.count() && m_info.at(id).id == id) {
+        m_info[id].node = node;
+      }
+    }
+  }
+}
+
+
+const CpuInfo& CpuTopology::info (int id) const
+{
+  Q_ASSERT(id >= 0 && id < m_info.count() && m_info.at(id).id == id);
+  return m_info.at(id);
+}
+
+
+CpuTopology::Distance CpuTopology::distance (int a, int b) const
+{
+  if (a == b) {
+    return SameCpu;
+  }
+  const CpuInfo& x = info(a);
+  const CpuInfo& y = info(b);
+  if (coreKey(x) == coreKey(y)) {
+    return SameCore;
+  }
+  if (x.l2 != -1 && x.l2 == y.l2) {
+    return SameL2;
+  }
+  if (x.l3 != -1 && x.l3 == y.l3) {
+    return SameL3;
+  }
+  if (x.node == y.node) {
+    return SameNode;
+  }
+  return Remote;
+}
+
+
+int CpuTopology::physicalCores (const QList<int>& cpus) const
+{
+  QSet<int> cores;
+  foreach (int id, cpus) {
+    cores.insert(coreKey(info(id)));
+  }
+  return cores.count();
+}
+
+
+QList<int> CpuTopology::place (const QList<int>& cpus, int count) const
+{
+  QList<CpuInfo> sorted;
+  foreach (int id, cpus) {
+    sorted.append(info(id));
+  }
+  qSort(sorted.begin(), sorted.end(), compactOrder);
+
+  // One CPU of every core first, then the SMT siblings
+  QList<int> order;
+  QList<int> siblings;
+  QSet<int> cores;
+  foreach (const CpuInfo& cpu, sorted) {
+    if (cores.contains(coreKey(cpu))) {
+      siblings.append(cpu.id);
+    }
+    else {
+      cores.insert(coreKey(cpu));
+      order.append(cpu.id);
+    }
+  }
+  order += siblings;
+
+  QList<int> placement;
+  for (int i=0; i<count && !order.isEmpty(); ++i) {
+    placement.append(order.at(i % order.count()));
+  }
+  return placement;
+}
+
+
+bool CpuTopology::parseCpuList (const char* list, QList<int>& cpus)
+{
+  QSet<int> found;
+  const char* p = list;
+  while (isspace(*p)) {
+    ++p;
+  }
+
+  while (*p) {
+    char* end;
+    const long first = strtol(p, &end, 10);
+    if (end == p || first < 0 || first >= MAX_CPUS) {
+      return false;
+    }
+    long last = first;
+    p = end;
+    if (*p == '-') {
+      ++p;
+      last = strtol(p, &end, 10);
+      if (end == p || last < first || last >= MAX_CPUS) {
+        return false;
+      }
+      p = end;
+    }
+    for (long id = first; id <= last; ++id) {
+      found.insert(int(id));
+    }
+
+    while (isspace(*p)) {
+      ++p;
+    }
+    if (*p == ',') {
+      ++p;
+    }
+    else if (*p) {
+      return false;
+    }
+  }
+
+  cpus = found.toList();
+  qSort(cpus);
+  return true;
+}
+
+
+bool CpuTopology::pinCurrentThread (int id)
+{
+#ifdef __linux__
+  if (id < 0 || id >= CPU_SETSIZE) {
+    return false;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(id, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  Q_UNUSED(id);
+  return false;
+#endif
+}
+
+} // Unison
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
@@ -0,0 +1,124 @@
+/*
+ * CpuTopology.hpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#ifndef UNISON_CPU_TOPOLOGY_HPP_
+#define UNISON_CPU_TOPOLOGY_HPP_
+
+#include <QList>
+#include <QVector>
+
+namespace Unison {
+
+/**
+ * Where a single logical CPU sits in the machine.  Caches are identified by the lowest
+ * numbered CPU sharing them, -1 if unknown. */
+struct CpuInfo
+{
+  int id;       ///< Logical CPU number, as used by the kernel
+  int package;  ///< Physical package (socket)
+  int core;     ///< Core within the package, shared by SMT siblings
+  int l2;       ///< Level 2 cache
+  int l3;       ///< Level 3 cache
+  int node;     ///< NUMA node
+};
+
+
+/**
+ * The CPUs we may run on and how they relate to each other, as read from
+ * /sys/devices/system/cpu.  Backends use this to pin their worker threads and to tell
+ * each Worker which of the others are cheap to steal from.  Where sysfs is not available
+ * every CPU is assumed to be a core of its own, all on the same node. */
+class CpuTopology
+{
+  public:
+    /**
+     * How far apart two CPUs are, see distance() */
+    enum Distance {
+      SameCpu = 0,
+      SameCore = 1,     ///< SMT siblings
+      SameL2 = 2,
+      SameL3 = 3,
+      SameNode = 4,
+      Remote = 5        ///< Another NUMA node
+    };
+
+    /**
+     * Reads the topology of the CPUs this process is allowed to run on.  Not RT-safe */
+    CpuTopology ();
+
+    /**
+     * @returns the CPUs we are allowed to run on, by id */
+    const QList<int>& cpus () const
+    {
+      return m_allowed;
+    }
+
+    /**
+     * @returns everything known about CPU @p id */
+    const CpuInfo& info (int id) const;
+
+    /**
+     * @returns how close CPUs @p a and @p b are */
+    Distance distance (int a, int b) const;
+
+    /**
+     * @returns the number of distinct physical cores among @p cpus */
+    int physicalCores (const QList<int>& cpus) const;
+
+    /**
+     * Choose a CPU for each of @p count threads.  Keeps the threads close together,
+     * and gives each its own physical core before doubling up on SMT siblings.  CPUs
+     * are reused once they run out.
+     * @param cpus the CPUs to choose from
+     * @param count the number of threads
+     * @returns the CPU of each thread */
+    QList<int> place (const QList<int>& cpus, int count) const;
+
+    /**
+     * Parse a CPU list in the kernel's format, for example "0-3,8,10-11"
+     * @param list the text to parse
+     * @param cpus receives the CPUs, in ascending order without duplicates
+     * @returns false if @p list is malformed, or names a CPU id that can't be pinned */
+    static bool parseCpuList (const char* list, QList<int>& cpus);
+
+    /**
+     * Restrict the calling thread to CPU @p id.
+     * @returns false if that is not supported or not allowed */
+    static bool pinCurrentThread (int id);
+
+  private:
+    void read ();
+    void readCaches (CpuInfo& cpu);
+    void readNodes ();
+
+    QVector<CpuInfo> m_info;  ///< By CPU id, holes have an id of -1
+    QList<int> m_allowed;     ///< CPUs in our affinity mask
+};
+
+} // Unison
+
+#endif
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
@@ -0,0 +1,181 @@
+/*
+ * Dsp.cpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "DspKernels.hpp"
+
+using namespace Unison::Internal;
+
+namespace {
+
+/**
+ * One sample at a time; the compiler may still vectorize for the baseline target */
+struct Scalar
+{
+  typedef float V;
+  enum { WIDTH = 1 };
+
+  static V load (const float* p) { return *p; }
+  static void store (float* p, V v) { *p = v; }
+  static V set1 (float x) { return x; }
+  static V zero () { return 0.0f; }
+  static V add (V a, V b) { return a + b; }
+  static V mul (V a, V b) { return a * b; }
+  static V max (V a, V b) { return a > b ? a : b; }
+  static V abs (V a) { return a < 0.0f ? -a : a; }
+  static float hmax (V v) { return v; }
+  static float hsum (V v) { return v; }
+
+  static void interleave2 (V l, V r, V& lo, V& hi)
+  {
+    lo = l;
+    hi = r;
+  }
+
+  static void deinterleave2 (V lo, V hi, V& l, V& r)
+  {
+    l = lo;
+    r = hi;
+  }
+};
+
+typedef DspKernels<Scalar> GenericKernels;
+
+/**
+ * Spelled out instead of using DspKernels::table() so it is constant-initialized, and
+ * usable by static constructors running before ours. */
+const Unison::Dsp::Kernels s_generic = {
+  Unison::Dsp::Generic,
+  GenericKernels::copy,
+  GenericKernels::zero,
+  GenericKernels::gain,
+  GenericKernels::mix,
+  GenericKernels::mixGain,
+  GenericKernels::interleave,
+  GenericKernels::deinterleave,
+  GenericKernels::peak,
+  GenericKernels::rms
+};
+
+/**
+ * @returns whether the CPU, and the OS, support @p isa */
+bool cpuSupports (Unison::Dsp::Isa isa)
+{
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+  // We may run from a static constructor, before libgcc has looked at the CPU
+  __builtin_cpu_init();
+#endif
+  switch (isa) {
+    case Unison::Dsp::Generic:
+      return true;
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+    case Unison::Dsp::Sse2:
+      return __builtin_cpu_supports("sse2");
+    case Unison::Dsp::Avx2:
+      return __builtin_cpu_supports("avx2");
+    case Unison::Dsp::Avx512:
+      return __builtin_cpu_supports("avx512f");
+#endif
+    default:
+      return false;
+  }
+}
+
+/**
+ * Switches to the best kernels when the library is loaded */
+struct Dispatch
+{
+  Dispatch ()
+  {
+    for (int isa = Unison::Dsp::Avx512; isa > Unison::Dsp::Generic; --isa) {
+      if (Unison::Dsp::setIsa(Unison::Dsp::Isa(isa))) {
+        break;
+      }
+    }
+  }
+} s_dispatch;
+
+} // anonymous
+
+namespace Unison {
+
+const Dsp::Kernels* Dsp::s_kernels = &s_generic;
+
+
+const Dsp::Kernels* Dsp::kernels (Isa isa)
+{
+  if (!cpuSupports(isa)) {
+    return NULL;
+  }
+  switch (isa) {
+    case Generic:
+      return genericKernels();
+    case Sse2:
+      return sse2Kernels();
+    case Avx2:
+      return avx2Kernels();
+    case Avx512:
+      return avx512Kernels();
+  }
+  return NULL;
+}
+
+
+bool Dsp::setIsa (Isa isa)
+{
+  const Kernels* k = kernels(isa);
+  if (!k) {
+    return false;
+  }
+  s_kernels = k;
+  return true;
+}
+
+
+const char* Dsp::isaName (Isa isa)
+{
+  switch (isa) {
+    case Generic:
+      return "generic";
+    case Sse2:
+      return "SSE2";
+    case Avx2:
+      return "AVX2";
+    case Avx512:
+      return "AVX-512";
+  }
+  return "unknown";
+}
+
+
+  namespace Internal {
+
+const Dsp::Kernels* genericKernels ()
+{
+  return &s_generic;
+}
+
+  } // Internal
+} // Unison
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
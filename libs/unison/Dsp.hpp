@@ -0,0 +1,159 @@
+/*
+ * Dsp.hpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef UNISON_DSP_HPP_
+#define UNISON_DSP_HPP_
+
+#include "types.hpp"
+
+namespace Unison {
+
+/**
+ * The DSP primitives shared by ports, backends and internal processors.  Every kernel
+ * has a plain C++ version and versions for the vector instruction sets the build and
+ * the CPU support.  The fastest one is picked when the library is loaded, and called
+ * through a table from then on.
+ *
+ * The kernels accept any pointers and lengths, but run fastest on data aligned to
+ * CACHE_LINE_SIZE, which is what AudioBuffer hands out.  Source and destination may be
+ * the same buffer, other overlaps are not allowed.  All kernels are RT-safe. */
+class Dsp
+{
+  public:
+    enum Isa
+    {
+      Generic,  ///< Plain C++, whatever the compiler makes of it
+      Sse2,
+      Avx2,
+      Avx512
+    };
+
+    /**
+     * The kernels of one instruction set */
+    struct Kernels
+    {
+      Isa isa;
+      void (*copy) (sample_t* dst, const sample_t* src, nframes_t n);
+      void (*zero) (sample_t* dst, nframes_t n);
+      void (*gain) (sample_t* dst, const sample_t* src, float gain, nframes_t n);
+      void (*mix) (sample_t* dst, const sample_t* src, nframes_t n);
+      void (*mixGain) (sample_t* dst, const sample_t* src, float gain, nframes_t n);
+      void (*interleave) (sample_t* dst, const sample_t* const* src, int channels,
+                          nframes_t n);
+      void (*deinterleave) (sample_t* const* dst, const sample_t* src, int channels,
+                            nframes_t n);
+      float (*peak) (const sample_t* src, nframes_t n);
+      float (*rms) (const sample_t* src, nframes_t n);
+    };
+
+    /** dst = src */
+    static inline void copy (sample_t* dst, const sample_t* src, nframes_t n)
+    {
+      s_kernels->copy(dst, src, n);
+    }
+
+    /** dst = 0 */
+    static inline void zero (sample_t* dst, nframes_t n)
+    {
+      s_kernels->zero(dst, n);
+    }
+
+    /** dst = src * gain */
+    static inline void gain (sample_t* dst, const sample_t* src, float gain, nframes_t n)
+    {
+      s_kernels->gain(dst, src, gain, n);
+    }
+
+    /** dst += src */
+    static inline void mix (sample_t* dst, const sample_t* src, nframes_t n)
+    {
+      s_kernels->mix(dst, src, n);
+    }
+
+    /** dst += src * gain */
+    static inline void mixGain (sample_t* dst, const sample_t* src, float gain,
+                                nframes_t n)
+    {
+      s_kernels->mixGain(dst, src, gain, n);
+    }
+
+    /**
+     * Interleave @p channels buffers of @p n frames into @p dst, which holds
+     * channels * n samples */
+    static inline void interleave (sample_t* dst, const sample_t* const* src,
+                                   int channels, nframes_t n)
+    {
+      s_kernels->interleave(dst, src, channels, n);
+    }
+
+    /**
+     * Split @p n interleaved frames of @p channels channels into a buffer each */
+    static inline void deinterleave (sample_t* const* dst, const sample_t* src,
+                                     int channels, nframes_t n)
+    {
+      s_kernels->deinterleave(dst, src, channels, n);
+    }
+
+    /** @returns the largest absolute value of @p src, 0 if @p n is 0 */
+    static inline float peak (const sample_t* src, nframes_t n)
+    {
+      return s_kernels->peak(src, n);
+    }
+
+    /** @returns the root mean square of @p src, 0 if @p n is 0 */
+    static inline float rms (const sample_t* src, nframes_t n)
+    {
+      return s_kernels->rms(src, n);
+    }
+
+    /**
+     * @returns the instruction set of the kernels in use */
+    static Isa isa ()
+    {
+      return s_kernels->isa;
+    }
+
+    /**
+     * @returns the kernels for @p isa, or NULL if the build or the CPU lacks it */
+    static const Kernels* kernels (Isa isa);
+
+    /**
+     * Use the kernels of @p isa from now on, for testing and benchmarking.  Must not be
+     * called while anything may be processing.
+     * @returns @c false if the build or the CPU lacks @p isa, nothing changes then */
+    static bool setIsa (Isa isa);
+
+    /**
+     * @returns a printable name for @p isa */
+    static const char* isaName (Isa isa);
+
+  private:
+    static const Kernels* s_kernels;  ///< The kernels in use
+};
+
+} // Unison
+
+#endif
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
@@ -0,0 +1,106 @@
+/*
+ * DspAvx2.cpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+/* Built with -mavx2 where the compiler supports it, see CMakeLists.txt */
+
+#include "DspKernels.hpp"
+
+#ifdef __AVX2__
+
+#include <immintrin.h>
+
+namespace {
+
+struct Avx2
+{
+  typedef __m256 V;
+  enum { WIDTH = 8 };
+
+  static V load (const float* p) { return _mm256_loadu_ps(p); }
+  static void store (float* p, V v) { _mm256_storeu_ps(p, v); }
+  static V set1 (float x) { return _mm256_set1_ps(x); }
+  static V zero () { return _mm256_setzero_ps(); }
+  static V add (V a, V b) { return _mm256_add_ps(a, b); }
+  static V mul (V a, V b) { return _mm256_mul_ps(a, b); }
+  static V max (V a, V b) { return _mm256_max_ps(a, b); }
+
+  static V abs (V a)
+  {
+    return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a);
+  }
+
+  static float hmax (V v)
+  {
+    __m128 x = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    x = _mm_max_ps(x, _mm_movehl_ps(x, x));
+    x = _mm_max_ss(x, _mm_shuffle_ps(x, x, 1));
+    return _mm_cvtss_f32(x);
+  }
+
+  static float hsum (V v)
+  {
+    __m128 x = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    x = _mm_add_ps(x, _mm_movehl_ps(x, x));
+    x = _mm_add_ss(x, _mm_shuffle_ps(x, x, 1));
+    return _mm_cvtss_f32(x);
+  }
+
+  static void interleave2 (V l, V r, V& lo, V& hi)
+  {
+    // unpack works within each 128 bit lane, put the lanes back in order afterwards
+    V a = _mm256_unpacklo_ps(l, r);
+    V b = _mm256_unpackhi_ps(l, r);
+    lo = _mm256_permute2f128_ps(a, b, 0x20);
+    hi = _mm256_permute2f128_ps(a, b, 0x31);
+  }
+
+  static void deinterleave2 (V lo, V hi, V& l, V& r)
+  {
+    V a = _mm256_permute2f128_ps(lo, hi, 0x20);
+    V b = _mm256_permute2f128_ps(lo, hi, 0x31);
+    l = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+    r = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+  }
+};
+
+} // anonymous
+
+#endif
+
+namespace Unison {
+  namespace Internal {
+
+const Dsp::Kernels* avx2Kernels ()
+{
+#ifdef __AVX2__
+  return DspKernels<Avx2>::table(Dsp::Avx2);
+#else
+  return NULL;
+#endif
+}
+
+  } // Internal
+} // Unison
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
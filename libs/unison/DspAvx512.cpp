@@ -0,0 +1,105 @@
+/*
+ * DspAvx512.cpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+/* Built with -mavx512f where the compiler supports it, see CMakeLists.txt */
+
+#include "DspKernels.hpp"
+
+#ifdef __AVX512F__
+
+#include <immintrin.h>
+
+namespace {
+
+struct Avx512
+{
+  typedef __m512 V;
+  enum { WIDTH = 16 };
+
+  static V load (const float* p) { return _mm512_loadu_ps(p); }
+  static void store (float* p, V v) { _mm512_storeu_ps(p, v); }
+  static V set1 (float x) { return _mm512_set1_ps(x); }
+  static V zero () { return _mm512_setzero_ps(); }
+  static V add (V a, V b) { return _mm512_add_ps(a, b); }
+  static V mul (V a, V b) { return _mm512_mul_ps(a, b); }
+  static V max (V a, V b) { return _mm512_max_ps(a, b); }
+
+  static V abs (V a)
+  {
+    // AVX-512F has no float logic ops, do it on the integer view
+    return _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(a),
+                                                _mm512_set1_epi32(0x7fffffff)));
+  }
+
+  static float hmax (V v)
+  {
+    return _mm512_reduce_max_ps(v);
+  }
+
+  static float hsum (V v)
+  {
+    return _mm512_reduce_add_ps(v);
+  }
+
+  static void interleave2 (V l, V r, V& lo, V& hi)
+  {
+    const __m512i lof = _mm512_set_epi32(23, 7, 22, 6, 21, 5, 20, 4,
+                                         19, 3, 18, 2, 17, 1, 16, 0);
+    const __m512i hif = _mm512_set_epi32(31, 15, 30, 14, 29, 13, 28, 12,
+                                         27, 11, 26, 10, 25, 9, 24, 8);
+    lo = _mm512_permutex2var_ps(l, lof, r);
+    hi = _mm512_permutex2var_ps(l, hif, r);
+  }
+
+  static void deinterleave2 (V lo, V hi, V& l, V& r)
+  {
+    const __m512i even = _mm512_set_epi32(30, 28, 26, 24, 22, 20, 18, 16,
+                                          14, 12, 10, 8, 6, 4, 2, 0);
+    const __m512i odd = _mm512_set_epi32(31, 29, 27, 25, 23, 21, 19, 17,
+                                         15, 13, 11, 9, 7, 5, 3, 1);
+    l = _mm512_permutex2var_ps(lo, even, hi);
+    r = _mm512_permutex2var_ps(lo, odd, hi);
+  }
+};
+
+} // anonymous
+
+#endif
+
+namespace Unison {
+  namespace Internal {
+
+const Dsp::Kernels* avx512Kernels ()
+{
+#ifdef __AVX512F__
+  return DspKernels<Avx512>::table(Dsp::Avx512);
+#else
+  return NULL;
+#endif
+}
+
+  } // Internal
+} // Unison
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
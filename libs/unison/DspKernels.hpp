@@ -0,0 +1,232 @@
+/*
+ * DspKernels.hpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef UNISON_DSP_KERNELS_HPP_
+#define UNISON_DSP_KERNELS_HPP_
+
+#include "Dsp.hpp"
+
+#include <math.h>
+
+namespace Unison {
+  namespace Internal {
+
+/**
+ * The DSP kernels, written once against a vector type.  Each instruction set gets its
+ * own translation unit which defines the traits and is compiled for that instruction set
+ * only, then instantiates DspKernels with them.  The traits must live in an anonymous
+ * namespace and the kernels must not call inline functions shared with other
+ * translation units (std::fabs, for one): the linker could otherwise pick the AVX copy
+ * of a function for code that runs on any CPU.
+ *
+ * The traits provide the vector type V holding WIDTH samples, and:
+ *  - load(p), store(p, v): unaligned memory access
+ *  - set1(x), zero(): broadcasts
+ *  - add(a, b), mul(a, b), max(a, b), abs(a)
+ *  - hmax(v), hsum(v): horizontal reductions to a float
+ *  - interleave2(l, r, lo, hi): lo and hi get l[0] r[0] l[1] r[1] ...
+ *  - deinterleave2(lo, hi, l, r): the inverse
+ *
+ * Every loop handles the frames that do not fill a vector in plain C++. */
+template<class T>
+struct DspKernels
+{
+  typedef typename T::V V;
+
+  static void copy (sample_t* dst, const sample_t* src, nframes_t n)
+  {
+    nframes_t i = 0;
+    for (; i + 4*T::WIDTH <= n; i += 4*T::WIDTH) {
+      V a = T::load(src + i);
+      V b = T::load(src + i + T::WIDTH);
+      V c = T::load(src + i + 2*T::WIDTH);
+      V d = T::load(src + i + 3*T::WIDTH);
+      T::store(dst + i, a);
+      T::store(dst + i + T::WIDTH, b);
+      T::store(dst + i + 2*T::WIDTH, c);
+      T::store(dst + i + 3*T::WIDTH, d);
+    }
+    for (; i + T::WIDTH <= n; i += T::WIDTH) {
+      T::store(dst + i, T::load(src + i));
+    }
+    for (; i < n; ++i) {
+      dst[i] = src[i];
+    }
+  }
+
+  static void zero (sample_t* dst, nframes_t n)
+  {
+    const V z = T::zero();
+    nframes_t i = 0;
+    for (; i + T::WIDTH <= n; i += T::WIDTH) {
+      T::store(dst + i, z);
+    }
+    for (; i < n; ++i) {
+      dst[i] = 0.0f;
+    }
+  }
+
+  static void gain (sample_t* dst, const sample_t* src, float g, nframes_t n)
+  {
+    const V vg = T::set1(g);
+    nframes_t i = 0;
+    for (; i + T::WIDTH <= n; i += T::WIDTH) {
+      T::store(dst + i, T::mul(T::load(src + i), vg));
+    }
+    for (; i < n; ++i) {
+      dst[i] = src[i] * g;
+    }
+  }
+
+  static void mix (sample_t* dst, const sample_t* src, nframes_t n)
+  {
+    nframes_t i = 0;
+    for (; i + T::WIDTH <= n; i += T::WIDTH) {
+      T::store(dst + i, T::add(T::load(dst + i), T::load(src + i)));
+    }
+    for (; i < n; ++i) {
+      dst[i] += src[i];
+    }
+  }
+
+  static void mixGain (sample_t* dst, const sample_t* src, float g, nframes_t n)
+  {
+    const V vg = T::set1(g);
+    nframes_t i = 0;
+    for (; i + T::WIDTH <= n; i += T::WIDTH) {
+      T::store(dst + i, T::add(T::load(dst + i), T::mul(T::load(src + i), vg)));
+    }
+    for (; i < n; ++i) {
+      dst[i] += src[i] * g;
+    }
+  }
+
+  static void interleave (sample_t* dst, const sample_t* const* src, int channels,
+                          nframes_t n)
+  {
+    nframes_t i = 0;
+    if (channels == 1) {
+      copy(dst, src[0], n);
+      return;
+    }
+    if (channels == 2) {
+      const sample_t* l = src[0];
+      const sample_t* r = src[1];
+      for (; i + T::WIDTH <= n; i += T::WIDTH) {
+        V lo, hi;
+        T::interleave2(T::load(l + i), T::load(r + i), lo, hi);
+        T::store(dst + 2*i, lo);
+        T::store(dst + 2*i + T::WIDTH, hi);
+      }
+    }
+    for (; i < n; ++i) {
+      for (int c = 0; c < channels; ++c) {
+        dst[i*channels + c] = src[c][i];
+      }
+    }
+  }
+
+  static void deinterleave (sample_t* const* dst, const sample_t* src, int channels,
+                            nframes_t n)
+  {
+    nframes_t i = 0;
+    if (channels == 1) {
+      copy(dst[0], src, n);
+      return;
+    }
+    if (channels == 2) {
+      sample_t* l = dst[0];
+      sample_t* r = dst[1];
+      for (; i + T::WIDTH <= n; i += T::WIDTH) {
+        V vl, vr;
+        T::deinterleave2(T::load(src + 2*i), T::load(src + 2*i + T::WIDTH), vl, vr);
+        T::store(l + i, vl);
+        T::store(r + i, vr);
+      }
+    }
+    for (; i < n; ++i) {
+      for (int c = 0; c < channels; ++c) {
+        dst[c][i] = src[i*channels + c];
+      }
+    }
+  }
+
+  static float peak (const sample_t* src, nframes_t n)
+  {
+    V m = T::zero();
+    nframes_t i = 0;
+    for (; i + T::WIDTH <= n; i += T::WIDTH) {
+      m = T::max(m, T::abs(T::load(src + i)));
+    }
+    float result = T::hmax(m);
+    for (; i < n; ++i) {
+      float a = src[i] < 0.0f ? -src[i] : src[i];
+      if (a > result) {
+        result = a;
+      }
+    }
+    return result;
+  }
+
+  static float rms (const sample_t* src, nframes_t n)
+  {
+    if (n == 0) {
+      return 0.0f;
+    }
+    V sum = T::zero();
+    nframes_t i = 0;
+    for (; i + T::WIDTH <= n; i += T::WIDTH) {
+      V x = T::load(src + i);
+      sum = T::add(sum, T::mul(x, x));
+    }
+    float result = T::hsum(sum);
+    for (; i < n; ++i) {
+      result += src[i] * src[i];
+    }
+    return float(::sqrt(double(result) / n));
+  }
+
+  static const Dsp::Kernels* table (Dsp::Isa isa)
+  {
+    static const Dsp::Kernels kernels = {
+      isa, copy, zero, gain, mix, mixGain, interleave, deinterleave, peak, rms
+    };
+    return &kernels;
+  }
+};
+
+/**
+ * @returns the kernels for each instruction set, NULL where the build lacks it.  The
+ * CPU is not checked here, that is Dsp's job. */
+const Dsp::Kernels* genericKernels ();
+const Dsp::Kernels* sse2Kernels ();
+const Dsp::Kernels* avx2Kernels ();
+const Dsp::Kernels* avx512Kernels ();
+
+  } // Internal
+} // Unison
+
+#endif
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
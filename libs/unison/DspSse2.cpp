@@ -0,0 +1,99 @@
+/*
+ * DspSse2.cpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+/* Built with -msse2 where the compiler supports it, see CMakeLists.txt */
+
+#include "DspKernels.hpp"
+
+#ifdef __SSE2__
+
+#include <emmintrin.h>
+
+namespace {
+
+struct Sse2
+{
+  typedef __m128 V;
+  enum { WIDTH = 4 };
+
+  static V load (const float* p) { return _mm_loadu_ps(p); }
+  static void store (float* p, V v) { _mm_storeu_ps(p, v); }
+  static V set1 (float x) { return _mm_set1_ps(x); }
+  static V zero () { return _mm_setzero_ps(); }
+  static V add (V a, V b) { return _mm_add_ps(a, b); }
+  static V mul (V a, V b) { return _mm_mul_ps(a, b); }
+  static V max (V a, V b) { return _mm_max_ps(a, b); }
+
+  static V abs (V a)
+  {
+    return _mm_andnot_ps(_mm_set1_ps(-0.0f), a);
+  }
+
+  static float hmax (V v)
+  {
+    v = _mm_max_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_max_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+  }
+
+  static float hsum (V v)
+  {
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+  }
+
+  static void interleave2 (V l, V r, V& lo, V& hi)
+  {
+    lo = _mm_unpacklo_ps(l, r);
+    hi = _mm_unpackhi_ps(l, r);
+  }
+
+  static void deinterleave2 (V lo, V hi, V& l, V& r)
+  {
+    l = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+    r = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1));
+  }
+};
+
+} // anonymous
+
+#endif
+
+namespace Unison {
+  namespace Internal {
+
+const Dsp::Kernels* sse2Kernels ()
+{
+#ifdef __SSE2__
+  return DspKernels<Sse2>::table(Dsp::Sse2);
+#else
+  return NULL;
+#endif
+}
+
+  } // Internal
+} // Unison
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
@@ -0,0 +1,91 @@
+/*
+ * Epoch.hpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#ifndef UNISON_EPOCH_HPP_
+#define UNISON_EPOCH_HPP_
+
+#include <QAtomicInt>
+
+namespace Unison {
+  namespace Internal {
+
+/**
+ * Tracks processing periods so non-RT code knows when the processing thread can no
+ * longer be looking at something it has replaced.  The processing thread calls enter()
+ * before it reads any shared state for a period and leave() when every Worker has
+ * finished.  The counter is odd while inside a period and even otherwise.
+ *
+ * Whatever was unpublished while the counter read @c e is safe to free once
+ * isQuiescentSince(e) is true: either no period was running at the time, or that period
+ * has since ended.  Any later period can only see the replacement.  Only a single
+ * processing thread may enter and leave. */
+class Epoch
+{
+  Q_DISABLE_COPY(Epoch)
+
+  public:
+    Epoch () :
+      m_counter(0)
+    {}
+
+    /**
+     * Mark the beginning of a processing period.  RT-safe */
+    inline void enter ()
+    {
+      m_counter.fetchAndAddOrdered(1);
+    }
+
+    /**
+     * Mark the end of a processing period.  RT-safe */
+    inline void leave ()
+    {
+      m_counter.fetchAndAddOrdered(1);
+    }
+
+    /**
+     * @returns the current value of the counter, to be passed to isQuiescentSince */
+    inline int current () const
+    {
+      return m_counter;
+    }
+
+    /**
+     * @param snapshot a value returned by current()
+     * @returns true if no period that was running at @p snapshot is still running */
+    inline bool isQuiescentSince (int snapshot) const
+    {
+      return (snapshot & 1) == 0 || current() != snapshot;
+    }
+
+  private:
+    QAtomicInt m_counter;
+};
+
+  } // Internal
+} // Unison
+
+#endif
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
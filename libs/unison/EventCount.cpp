@@ -0,0 +1,84 @@
+/*
+ * EventCount.cpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "EventCount.hpp"
+
+#ifdef __linux__
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace Unison {
+  namespace Internal {
+
+#ifdef __linux__
+/** @returns the futex word of @p atomic, QAtomicInt is nothing but an int */
+static inline int* futexWord (QAtomicInt& atomic)
+{
+  return reinterpret_cast<int*>(&atomic);
+}
+#endif
+
+
+EventCount::EventCount () :
+  m_generation(0),
+  m_waiters(0)
+{}
+
+
+void EventCount::wait (int key)
+{
+#ifdef __linux__
+  // Returns at once if the generation is no longer key
+  syscall(SYS_futex, futexWord(m_generation), FUTEX_WAIT_PRIVATE, key, NULL, NULL, 0);
+#else
+  m_mutex.lock();
+  if (m_generation == key) {
+    m_condition.wait(&m_mutex);
+  }
+  m_mutex.unlock();
+#endif
+  m_waiters.fetchAndAddOrdered(-1);
+}
+
+
+void EventCount::wake ()
+{
+#ifdef __linux__
+  m_generation.fetchAndAddOrdered(1);
+  syscall(SYS_futex, futexWord(m_generation), FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#else
+  m_mutex.lock();
+  m_generation.fetchAndAddOrdered(1);
+  m_condition.wakeAll();
+  m_mutex.unlock();
+#endif
+}
+
+  } // Internal
+} // Unison
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
@@ -0,0 +1,116 @@
+/*
+ * EventCount.hpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#ifndef UNISON_EVENT_COUNT_HPP_
+#define UNISON_EVENT_COUNT_HPP_
+
+#include <QAtomicInt>
+
+#ifndef __linux__
+#include <QMutex>
+#include <QWaitCondition>
+#endif
+
+namespace Unison {
+  namespace Internal {
+
+/**
+ * Lets threads sleep until some condition becomes true, without the notifier paying for
+ * a system call unless somebody is actually asleep.  A waiter registers with
+ * prepareWait(), checks its condition and then either calls cancelWait() or wait().
+ * A notifier makes the condition true and calls notifyAll().  A notification that
+ * comes between prepareWait() and wait() is never lost, wait() simply returns.
+ *
+ * On Linux the sleeping is done on a futex, so notifyAll() wakes every waiter with a
+ * single system call.  Elsewhere a QWaitCondition is used. */
+class EventCount
+{
+  Q_DISABLE_COPY(EventCount)
+
+  public:
+    EventCount ();
+
+    /**
+     * Register as a waiter.  Must be followed by either cancelWait() or wait().  RT-safe
+     * @returns the key to pass to wait() */
+    inline int prepareWait ()
+    {
+      m_waiters.fetchAndAddOrdered(1);
+      return m_generation;
+    }
+
+    /**
+     * Unregister, the condition turned out to be true after all.  RT-safe */
+    inline void cancelWait ()
+    {
+      m_waiters.fetchAndAddOrdered(-1);
+    }
+
+    /**
+     * Sleep until notifyAll() is called, unless it already has been since
+     * prepareWait() returned @p key.  May wake spuriously, so the caller should check its
+     * condition again.  Unregisters.
+     * @param key the value returned by prepareWait() */
+    void wait (int key);
+
+    /**
+     * Wake everyone waiting.  The notifier must have made the condition true before
+     * calling this.  Costs a memory barrier when nobody waits.  RT-safe */
+    inline void notifyAll ()
+    {
+      // Pairs with the barrier in prepareWait: either the waiter sees our condition, or
+      // we see the waiter.
+      __sync_synchronize();
+      if (m_waiters != 0) {
+        wake();
+      }
+    }
+
+    /**
+     * Tell the CPU we are busy-waiting, it can save power and stop speculating. */
+    static inline void pause ()
+    {
+#if defined __i386__ || defined __x86_64
+      __asm__ __volatile__("pause");
+#endif
+    }
+
+  private:
+    void wake ();
+
+    QAtomicInt m_generation;  ///< Bumped by every wake, the futex word
+    QAtomicInt m_waiters;     ///< Threads between prepareWait and returning from wait
+#ifndef __linux__
+    QMutex m_mutex;
+    QWaitCondition m_condition;
+#endif
+};
+
+  } // Internal
+} // Unison
+
+#endif
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
@@ -0,0 +1,178 @@
+/*
+ * LockFreeStack.hpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef UNISON_LOCK_FREE_STACK_HPP_
+#define UNISON_LOCK_FREE_STACK_HPP_
+
+#include "RtArena.hpp"
+#include "types.hpp"
+
+#include <QtCore/QtGlobal>
+
+#include <new>
+
+namespace Unison {
+  namespace Internal {
+
+/**
+ * A bounded stack that any number of threads may push to and pop from at the same
+ * time, without locks.  The values live in a fixed array of nodes.  Nodes holding a
+ * value are linked into one Treiber stack, spare nodes into another, so nothing is
+ * allocated after construction.  Each head is a node index paired with a tag that is
+ * bumped on every change, and both are swapped together in 64 bits, so a head that was
+ * popped and pushed again in between (ABA) is never mistaken for the one a thread read.
+ *
+ * A thread preempted halfway through only holds on to its own node, it never keeps
+ * anybody else from making progress.  The stack is LIFO, so the value pushed last,
+ * likely still in cache, is the first one popped. */
+template <typename T>
+class LockFreeStack
+{
+  Q_DISABLE_COPY(LockFreeStack)
+
+  public:
+    /**
+     * @param capacity the most values the stack can hold.  Not RT-safe. */
+    LockFreeStack (int capacity) :
+      m_capacity(capacity),
+      m_full(EMPTY),
+      m_spare(EMPTY)
+    {
+      m_nodes = static_cast<Node*>(RtArena::allocate(sizeof(Node) * capacity));
+      for (int i=0; i<capacity; ++i) {
+        new (&m_nodes[i]) Node();
+        pushNode(m_spare, i);
+      }
+    }
+
+    ~LockFreeStack ()
+    {
+      for (int i=0; i<m_capacity; ++i) {
+        m_nodes[i].~Node();
+      }
+      RtArena::free(m_nodes);
+    }
+
+    int capacity () const
+    {
+      return m_capacity;
+    }
+
+    /**
+     * Push @p value on top of the stack.  RT-safe
+     * @returns @c false if the stack is full */
+    bool push (const T& value)
+    {
+      const int node = popNode(m_spare);
+      if (node < 0) {
+        return false;
+      }
+      m_nodes[node].value = value;
+      pushNode(m_full, node);
+      return true;
+    }
+
+    /**
+     * Pop the value on top of the stack.  RT-safe
+     * @param value receives the value
+     * @returns @c false if the stack is empty */
+    bool pop (T& value)
+    {
+      const int node = popNode(m_full);
+      if (node < 0) {
+        return false;
+      }
+      value = m_nodes[node].value;
+      pushNode(m_spare, node);
+      return true;
+    }
+
+  private:
+    /** The tag is in the upper half, the index of the top node plus one in the lower */
+    typedef quint64 Head;
+    static const Head EMPTY = 0;
+
+    struct Node
+    {
+      T value;
+      volatile int next; ///< Index of the node below us, or -1
+    };
+
+    static inline Head load (volatile Head& head)
+    {
+      // A plain read may tear on 32-bit machines
+      return __sync_fetch_and_add(&head, 0);
+    }
+
+    static inline Head make (Head previous, int node)
+    {
+      return (((previous >> 32) + 1) << 32) | Head(unsigned(node + 1));
+    }
+
+    static inline int top (Head head)
+    {
+      return int(unsigned(head)) - 1;
+    }
+
+    int popNode (volatile Head& head)
+    {
+      forever {
+        const Head old = load(head);
+        const int node = top(old);
+        if (node < 0) {
+          return -1;
+        }
+        // May be stale if somebody beats us to the node, then the swap fails anyways
+        if (__sync_bool_compare_and_swap(&head, old, make(old, m_nodes[node].next))) {
+          return node;
+        }
+      }
+    }
+
+    void pushNode (volatile Head& head, int node)
+    {
+      forever {
+        const Head old = load(head);
+        m_nodes[node].next = top(old);
+        if (__sync_bool_compare_and_swap(&head, old, make(old, node))) {
+          return;
+        }
+      }
+    }
+
+    Node* m_nodes;
+    int m_capacity;
+    char padFull[CACHE_LINE_SIZE];  ///< Keeps both heads on lines of their own
+    volatile Head m_full;           ///< Nodes holding a value
+    char padSpare[CACHE_LINE_SIZE];
+    volatile Head m_spare;          ///< Nodes free to take a value
+    char padEnd[CACHE_LINE_SIZE];
+};
+
+  } // Internal
+} // Unison
+
+#endif
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
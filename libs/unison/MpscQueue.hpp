@@ -0,0 +1,191 @@
+/*
+ * MpscQueue.hpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef UNISON_MPSC_QUEUE_HPP_
+#define UNISON_MPSC_QUEUE_HPP_
+
+#include "RtArena.hpp"
+#include "types.hpp"
+
+#include <QtCore/QtGlobal>
+
+#include <new>
+
+namespace Unison {
+  namespace Internal {
+
+/**
+ * A bounded FIFO that any number of threads may push to while a single thread pops,
+ * without locks.  Every cell of the ring carries a sequence number telling whose turn it
+ * is: a producer claims the next position with a single compare-and-swap on the tail,
+ * fills the cell and then publishes it by bumping its sequence.  The consumer only takes
+ * a cell once it has been published, so a producer preempted halfway through only
+ * delays the values queued after its own, it never corrupts the queue.  Nothing is
+ * allocated after construction.  Positions are free running and compared by their
+ * difference, so they may wrap. */
+template <typename T>
+class MpscQueue
+{
+  Q_DISABLE_COPY(MpscQueue)
+
+  public:
+    /**
+     * @param capacity the most values the queue can hold, rounded up to a power of two.
+     *                 Not RT-safe. */
+    MpscQueue (int capacity) :
+      m_mask(1),
+      m_head(0),
+      m_tail(0)
+    {
+      while (int(m_mask) < capacity) {
+        m_mask <<= 1;
+      }
+      m_cells = static_cast<Cell*>(RtArena::allocate(sizeof(Cell) * m_mask));
+      for (unsigned i=0; i<m_mask; ++i) {
+        new (&m_cells[i]) Cell();
+        m_cells[i].sequence = i;
+      }
+      m_mask -= 1;
+    }
+
+    ~MpscQueue ()
+    {
+      for (unsigned i=0; i<=m_mask; ++i) {
+        m_cells[i].~Cell();
+      }
+      RtArena::free(m_cells);
+    }
+
+    int capacity () const
+    {
+      return int(m_mask) + 1;
+    }
+
+    /**
+     * @returns roughly how many values are queued, exact only while nobody pushes or
+     *          pops.  RT-safe */
+    int count () const
+    {
+      const int n = int(m_tail - m_head);
+      return n < 0 ? 0 : n;
+    }
+
+    /**
+     * Append @p value.  May be called from any number of threads at once.  RT-safe
+     * @returns @c false if the queue is full */
+    bool push (const T& value)
+    {
+      forever {
+        const unsigned pos = m_tail;
+        Cell& cell = m_cells[pos & m_mask];
+        const int turn = int(cell.sequence - pos);
+        if (turn == 0) {
+          // Our turn to fill the cell, unless another producer claims it first
+          if (__sync_bool_compare_and_swap(&m_tail, pos, pos + 1)) {
+            cell.value = value;
+            __sync_synchronize();
+            cell.sequence = pos + 1;
+            return true;
+          }
+        }
+        else if (turn < 0) {
+          // The consumer has not emptied the cell yet, a whole lap behind
+          return false;
+        }
+        // Otherwise m_tail moved on since we read it, try again
+      }
+    }
+
+    /**
+     * Claim the next position without filling it yet, so the order of values is fixed
+     * before the caller waits for room, see fill().  A position is claimed even while
+     * the queue is full.  The consumer stops at the first position not filled yet, so
+     * every claim must be filled eventually.  RT-safe
+     * @returns the position claimed */
+    unsigned claim ()
+    {
+      return __sync_fetch_and_add(&m_tail, 1);
+    }
+
+    /**
+     * Fill a position claimed with claim().  Only the thread that claimed it may call
+     * this, again until it succeeds.  RT-safe
+     * @param pos the position claimed
+     * @returns @c false if the consumer has not emptied the cell a lap behind yet */
+    bool fill (unsigned pos, const T& value)
+    {
+      Cell& cell = m_cells[pos & m_mask];
+      if (int(cell.sequence - pos) != 0) {
+        return false;
+      }
+      __sync_synchronize();
+      cell.value = value;
+      __sync_synchronize();
+      cell.sequence = pos + 1;
+      return true;
+    }
+
+    /**
+     * Take the oldest value.  Must only be called from the consumer thread.  RT-safe
+     * @param value receives the value
+     * @returns @c false if the queue is empty, or the oldest value is not published
+     *          yet */
+    bool pop (T& value)
+    {
+      const unsigned pos = m_head;
+      Cell& cell = m_cells[pos & m_mask];
+      if (int(cell.sequence - (pos + 1)) < 0) {
+        return false;
+      }
+      __sync_synchronize();
+      value = cell.value;
+      __sync_synchronize();
+      // Hand the cell to the producer of the next lap
+      cell.sequence = pos + m_mask + 1;
+      m_head = pos + 1;
+      return true;
+    }
+
+  private:
+    struct Cell
+    {
+      volatile unsigned sequence; ///< Position whose turn it is, plus one once filled
+      T value;
+    };
+
+    Cell* m_cells;
+    unsigned m_mask;                  ///< Number of cells minus one
+    char padHead[CACHE_LINE_SIZE];    ///< Keeps producers and consumer apart
+    volatile unsigned m_head;         ///< Next position to pop, consumer only
+    char padTail[CACHE_LINE_SIZE];
+    volatile unsigned m_tail;         ///< Next position to claim, producers
+    char padEnd[CACHE_LINE_SIZE];
+};
+
+  } // Internal
+} // Unison
+
+#endif
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
@@ -24,8 +24,12 @@
 
 #include "Patch.hpp"
 
+#include "BackendPort.hpp"
+#include "BufferPlanner.hpp"
+#include "Commander.hpp"
 #include "Node.hpp"
 #include "Port.hpp"
+#include "PublishSchedule.hpp"
 #include "Scheduler.hpp"
 
 #include <QtCore/QDebug>
@@ -33,11 +37,11 @@
 namespace Unison {
 
 Patch::Patch () :
-  Processor()
+  Processor(),
+  m_editDepth(0),
+  m_bufferProvider(NULL)
 {
   m_schedule = new Internal::Schedule();
-  m_schedule->work = NULL;
-  m_schedule->workCount = 0;
 }
 
 int Patch::portCount () const
@@ -66,6 +70,7 @@ Port* Patch::port (const QString& id) const
 
 void Patch::activate (BufferProvider& bp)
 {
+  m_bufferProvider = &bp;
   foreach (Processor* p, m_processors) {
     p->activate(bp);
   }
@@ -74,6 +79,7 @@ void Patch::activate (BufferProvider& bp)
 
 void Patch::deactivate ()
 {
+  m_bufferProvider = NULL;
   foreach (Processor* p, m_processors) {
     p->deactivate();
   }
@@ -82,9 +88,12 @@ void Patch::deactivate ()
 
 void Patch::setBufferLength (PortType type, nframes_t len)
 {
+  // Compiling replaces every buffer that is the wrong length, see BufferPlanner
+  beginEdit();
   foreach (Processor* p, m_processors) {
     p->setBufferLength(type, len);
   }
+  endEdit();
 }
 
 
@@ -92,12 +101,8 @@ void Patch::process (const ProcessingContext& context)
 {
   Q_UNUSED(context);
 
-  // We don't actually need to do anything, scheduler will
-  // pull in our children as dependents
-  for (int i=0; i<m_schedule->workCount; ++i) {
-    Unison::Internal::WorkUnit& w = m_schedule->work[i];
-    w.wait = w.initialWait;
-  } 
+  // We don't actually need to do anything, the backend runs our schedule and the
+  // work units rearm themselves
 }
 
 
@@ -150,6 +155,7 @@ void Patch::add (Processor* processor)
   if (!m_processors.contains(processor)) {
     m_processors.append(processor);
     processor->setParent(this);
+    m_compiler.add(processor);
   }
 }
 
@@ -159,71 +165,87 @@ void Patch::remove (Processor* processor)
   Q_ASSERT(processor != NULL);
   Q_ASSERT(processor->parent() == this);
   m_processors.removeOne(processor);
+  m_compiler.remove(processor);
+  m_costs.remove(processor);
   processor->setParent(NULL);
   // XXX: Need to fix connections!
 }
 
 
+void Patch::addBackendPort (BackendPort* port)
+{
+  Q_ASSERT(port != NULL);
+  beginEdit();
+  m_compiler.add(port);
+  endEdit();
+}
+
+
+void Patch::removeBackendPort (BackendPort* port)
+{
+  Q_ASSERT(port != NULL);
+  beginEdit();
+  m_compiler.remove(port);
+  endEdit();
+}
+
+
+void Patch::setCost (const Processor* processor, int cost)
+{
+  Q_ASSERT(processor != NULL);
+  Q_ASSERT(cost >= 0);
+  m_costs.insert(processor, cost);
+}
+
+
+int Patch::cost (const Processor* processor) const
+{
+  return m_costs.value(processor, DEFAULT_COST);
+}
+
+
+void Patch::beginEdit ()
+{
+  if (m_editDepth++ == 0) {
+    Internal::Commander::instance()->beginBatch();
+  }
+}
+
+
+void Patch::endEdit ()
+{
+  Q_ASSERT(m_editDepth > 0);
+  if (--m_editDepth == 0) {
+    // Compiles once, and swaps the schedule in the same period as the rest of the batch
+    Internal::Commander* commander = Internal::Commander::instance();
+    commander->push(new Internal::PublishSchedule(this));
+    commander->endBatch();
+  }
+}
+
+
 void Patch::compileSchedule (Internal::Schedule& output)
 {
   //qDebug() << "Compiling schedule for" << name()
   //         << "with" << m_processors.count() << "children.";
-  // FIXME: this is not threadsafe, lock m_processors.
-  output.workCount = m_processors.count();
-  output.work = new Internal::WorkUnit[output.workCount];
-
-  output.readyWorkCount = 1;
-  output.readyWork = new Internal::WorkUnit[output.readyWorkCount];
-  
-  QListIterator<Processor*> i( m_processors );
-  for (int wc=0; i.hasNext(); ++wc) {
-    Processor* proc = i.next();
-
-    // A rather naster traversal to find processors
-    QSet<Node* const> dependencies;
-    QSet<Node* const> dependents;
-
-    // For each output port
-    for (int pc = 0; pc < proc->portCount(); ++pc) {
-      Port* port = proc->port(pc);
-
-      // For all connected Ports.
-      for (QSet<Port* const>::const_iterator pi = port->connectionsBegin();
-           pi != port->connectionsEnd(); ++pi) {
-
-        Port* const otherPort = *pi;
-
-        // We can count on getting processors from this relationship, but it sucks to.
-        if (port->direction() == Input) {
-          dependencies.unite(otherPort->dependencies());
-        }
-        else {
-          dependents.unite(otherPort->dependents());
-        }
-      }
-    }
-
-    output.work[wc].processor = proc;
-    output.work[wc].initialWait = dependencies.count() + 1; // dependents + patch;
+  m_compiler.compile(output);
 
-    output.work[wc].dependents = new Internal::WorkUnit*[dependents.count()+1];
-    int dc=0;
-    for (QSetIterator<Node* const> ni(dependents); ni.hasNext(); ++dc) {
-      int dwc = m_processors.indexOf((Processor*)ni.next());
-      output.work[wc].dependents[dc] = &output.work[dwc];
-    }
-    output.work[wc].dependents[dc] = NULL; // NULL termination
+  for (int wc=0; wc < output.workCount; ++wc) {
+    const Processor* p = output.work[wc].processor;
+    // Anything that isn't our child is moving a backend port's data, or mixing
+    output.work[wc].cost = (p->parent() == this) ? cost(p) : PORT_COST;
   }
 
-  // Now prepare the Patch gwork
-  output.readyWork[0].processor = this;
-  output.readyWork[0].initialWait = 0;
-  output.readyWork[0].dependents = new Internal::WorkUnit*[output.workCount+1];
-  int dc=0;
-  for (; dc < output.workCount; ++dc) {
-    output.readyWork[0].dependents[dc] = &output.work[dc];
+  output.prioritize();
+
+  // Share buffers between ports that are never live at the same time
+  if (m_bufferProvider) {
+    Internal::BufferPlanner planner(*this, output);
+    planner.plan(*m_bufferProvider);
   }
-  output.readyWork[0].dependents[dc] = NULL; // NULL termination
+  output.trackMixers();
+  // Let units be skipped while their inputs are silent
+  output.trackSilence();
 
   // Print it out
   /*
@@ -233,18 +255,15 @@ void Patch::compileSchedule (Internal::Schedule& output)
     Unison::Internal::WorkUnit& w = output.work[wc];
     printf(" Work: `%s` (%x) wait: %d\n",
            qPrintable(w.processor->name()), w.processor, w.initialWait);
-    for (Unison::Internal::WorkUnit** wpp = w.dependents; *wpp; ++wpp) {
+    for (int d=0; d<w.dependentCount; ++d) {
+      Unison::Internal::WorkUnit* dep = w.dependents[d];
       printf("  Dep: `%s` (%x) wait: %d\n",
-             qPrintable((*wpp)->processor->name()), (*wpp)->processor, (*wpp)->initialWait);
+             qPrintable(dep->processor->name()), dep->processor, dep->initialWait);
     }
   }
   for (wc=0; wc< output.readyWorkCount; ++wc) {
-    Unison::Internal::WorkUnit &w = output.readyWork[wc];
-    printf(" Rdy Work: `%s` (%x) wait: %d\n", qPrintable(w.processor->name()), w.processor, w.initialWait);
-    for (Unison::Internal::WorkUnit** wpp = w.dependents; *wpp; ++wpp) {
-      printf("  Dep: `%s` (%x) wait: %d\n",
-             qPrintable((*wpp)->processor->name()), (*wpp)->processor, (*wpp)->initialWait);
-    }
+    Unison::Internal::WorkUnit &w = *output.readyWork[wc];
+    printf(" Rdy Work: `%s` (%x)\n", qPrintable(w.processor->name()), w.processor);
   }
   printf("\n");
 */
@@ -27,10 +27,14 @@
 #define UNISON_PATCH_HPP_
 
 #include "Processor.hpp"
+#include "ScheduleCompiler.hpp"
 #include "Scheduler.hpp"
 
+#include <QHash>
+
 namespace Unison {
 
+  class BackendPort;
   class BufferProvider;
   class ProcessingContext;
 
@@ -41,10 +45,18 @@ namespace Unison {
  * processor of a @c Backend is represented as a Patch.  Patch is optimized by compiling a
  * proper traversal of the children when the graph is changed.  The @c Commander is used
  * to allow us to use the new traversal in the rendering phrase in a RT safe manner.
+ * Many changes can be grouped between beginEdit() and endEdit(), so the traversal is
+ * only compiled and published once.  While the Patch is active, compiling also decides
+ * which audio buffers the ports of the children share, see @c BufferPlanner.
  */
 class Patch : public Processor
 {
   public:
+    enum {
+      DEFAULT_COST = 1000, ///< Assumed cost of a processor that hasn't been measured
+      PORT_COST = 100      ///< Assumed cost of moving a backend port's data
+    };
+
     Patch ();
 
     virtual ~Patch ()
@@ -66,6 +78,68 @@ class Patch : public Processor
      */
     void remove (Processor* processor);
 
+    /**
+     * Schedule moving the data of @p port to or from its Backend along with our
+     * children, instead of before or after all of them.  A new schedule is published,
+     * unless we are inside a beginEdit() / endEdit() batch.
+     * @param port a port of the Backend we are the root patch of
+     */
+    void addBackendPort (BackendPort* port);
+
+    /**
+     * Stop scheduling @p port, and take it over.  The processing thread may still be
+     * running the previous schedule, so the port is deleted along with the schedule
+     * that replaces it.
+     * @param port a port previously given to addBackendPort()
+     */
+    void removeBackendPort (BackendPort* port);
+
+    /**
+     * @returns the children of this Patch
+     */
+    const QList<Processor*>& processors () const
+    {
+      return m_processors;
+    }
+
+    /**
+     * Set the estimated cost of running @p processor.  The scheduler uses costs to find
+     * the critical path through the patch and starts it as early as possible.  Takes
+     * effect the next time the schedule is compiled.
+     * @param processor a child of this Patch
+     * @param cost time spent in Processor::process, in nanoseconds
+     */
+    void setCost (const Processor* processor, int cost);
+
+    /**
+     * @returns the estimated cost of running @p processor, or DEFAULT_COST if unknown
+     */
+    int cost (const Processor* processor) const;
+
+    /**
+     * Start a batch of edits.  Connecting or disconnecting ports of our children will
+     * not compile a new schedule until the matching endEdit().  Batches may be nested.
+     * The edits are collected into a single CommandBatch, so the processing thread
+     * applies all of them, and the new schedule, in the same period.  Other threads
+     * can't push Commands until the batch ends.
+     */
+    void beginEdit ();
+
+    /**
+     * Finish a batch of edits.  When the outermost batch ends, the schedule is compiled
+     * once and published to the processing thread through the @c Commander, together
+     * with the edits.
+     */
+    void endEdit ();
+
+    /**
+     * @returns @c true if we are inside a beginEdit() / endEdit() batch
+     */
+    bool isEditing () const
+    {
+      return m_editDepth > 0;
+    }
+
     virtual int portCount () const;
 
     virtual Port* port (int idx) const;
@@ -74,6 +148,15 @@ class Patch : public Processor
     virtual void activate (BufferProvider& bp);
     virtual void deactivate ();
 
+    /**
+     * Pass the new period length on to our children, and publish a schedule that gives
+     * the audio ports of our children and backend ports buffers of the new length.  The
+     * processing thread keeps using the old buffers until it picks up the schedule, then
+     * switches all of them at once.  The BufferProvider we were activated with must
+     * already hand out buffers of @p len.  Not RT-safe.
+     * @param type the type of Port that needs to be resized
+     * @param len the new length, in frames
+     */
     virtual void setBufferLength (PortType type, nframes_t len);
 
     virtual void process (const ProcessingContext& context);
@@ -85,9 +168,21 @@ class Patch : public Processor
 
     void compileSchedule (Internal::Schedule& output);
 
-    void setSchedule (Internal::Schedule* schedule)
+    Internal::ScheduleCompiler& compiler ()
+    {
+      return m_compiler;
+    }
+
+    /**
+     * Publish a new schedule to the processing thread, and point the ports at the
+     * buffers it shares between them.  RT-safe.
+     * @returns the previous schedule, to be retired through the @c Commander once the
+     *          processing thread is done with it
+     */
+    Internal::Schedule* setSchedule (Internal::Schedule* schedule)
     {
-      m_schedule = schedule;
+      schedule->assignBuffers();
+      return m_schedule.fetchAndStoreOrdered(schedule);
     }
 
     Internal::Schedule* schedule () const
@@ -105,6 +200,10 @@ class Patch : public Processor
   private:
     QAtomicPointer<Internal::Schedule> m_schedule; // current schedule
     QList<Processor*> m_processors; ///< our children
+    QHash<const Processor*, int> m_costs; ///< estimated costs of our children
+    Internal::ScheduleCompiler m_compiler; ///< dependency graph of our children
+    int m_editDepth;                ///< nesting of beginEdit() calls
+    BufferProvider* m_bufferProvider; ///< shared buffers come from here, while active
 };
 
 } // Unison
@@ -0,0 +1,87 @@
+/*
+ * Plugin.cpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include "Plugin.hpp"
+
+#include "ControlStream.hpp"
+#include "Port.hpp"
+#include "ProcessingContext.hpp"
+
+namespace Unison {
+
+static int s_assumedTail = Plugin::NO_ASSUMED_TAIL;
+
+
+void Plugin::setAssumedTail (int seconds)
+{
+  s_assumedTail = seconds;
+}
+
+
+int Plugin::assumedTail ()
+{
+  return s_assumedTail;
+}
+
+
+nframes_t Plugin::tailLength () const
+{
+  if (s_assumedTail == NO_ASSUMED_TAIL) {
+    return UNKNOWN_TAIL;
+  }
+  for (int i=0; i<portCount(); ++i) {
+    const Port* p = port(i);
+    if (p->direction() == Input && p->type() != AudioPort && p->type() != ControlPort) {
+      return UNKNOWN_TAIL;
+    }
+  }
+  return latency() + s_assumedTail * sampleRate();
+}
+
+
+void Plugin::runBlocks (const ProcessingContext& context, const ControlInput* controls,
+                        int count)
+{
+  const nframes_t length = context.bufferSize();
+  for (int i=0; i<count; ++i) {
+    controls[i].stream->beginPeriod(context.frameTime(), length);
+  }
+
+  nframes_t offset = 0;
+  while (offset < length) {
+    nframes_t end = length;
+    for (int i=0; i<count; ++i) {
+      controls[i].stream->apply(offset, controls[i].value);
+      end = qMin(end, controls[i].stream->nextChange());
+    }
+    runBlock(offset, end - offset);
+    offset = end;
+  }
+}
+
+
+} // Unison
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
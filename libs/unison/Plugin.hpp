@@ -33,7 +33,9 @@
 
 namespace Unison {
 
+  class ControlStream;
   class Patch;
+  class ProcessingContext;
 
 /**
  * The type of plugin, regarding I/O.
@@ -109,6 +111,81 @@ class Plugin : public Processor
      * @returns the copyright or license restricting usage of the plugin.
      */
     virtual QString copyright() const = 0;
+
+    /**
+     * @returns the sample rate the plugin was instantiated at
+     */
+    virtual nframes_t sampleRate () const = 0;
+
+    /**
+     * Plugin formats have no way to say how long a plugin keeps sounding once its inputs
+     * go quiet, so a plugin is never skipped unless a tail was assumed with
+     * setAssumedTail().  Then the tail is that many seconds on top of the latency()
+     * reported.  Plugins with inputs other than audio and control, MIDI for example,
+     * may play while their audio inputs are silent and are never skipped either way.
+     */
+    virtual nframes_t tailLength () const;
+
+    /**
+     * Assume every plugin stops sounding @p seconds after its audio inputs go quiet, so
+     * idle plugins can be skipped.  Oscillators, gates and plugins driven only by their
+     * controls are cut off when that is wrong, so it is off by default.  Set it before
+     * any Schedule is compiled
+     * @param seconds the tail to assume, NO_ASSUMED_TAIL to never skip plugins
+     */
+    static void setAssumedTail (int seconds);
+
+    /**
+     * @returns the tail set with setAssumedTail(), in seconds
+     */
+    static int assumedTail ();
+
+    enum {
+      NO_ASSUMED_TAIL = 0 ///< Plugins are never skipped, the default
+    };
+
+  protected:
+    /**
+     * @returns how many frames behind its input the plugin's output is, as last
+     *          reported by the plugin.  0 by default
+     */
+    virtual nframes_t latency () const
+    {
+      return 0;
+    }
+
+    /**
+     * A control input whose changes come through a ControlStream
+     */
+    struct ControlInput
+    {
+      ControlStream* stream;  ///< Changes to the value
+      float* value;           ///< Where the plugin reads the value from
+    };
+
+    /**
+     * Run one period in blocks, splitting it wherever one of @p controls changes, so
+     * every change takes effect at its exact frame.  The changes due at the start of
+     * a block are applied, then runBlock() is called for it.  A period without changes
+     * is run as a single block.  RT-safe
+     * @param context the current processing context
+     * @param controls the control inputs of the plugin
+     * @param count the number of @p controls
+     */
+    void runBlocks (const ProcessingContext& context, const ControlInput* controls,
+                    int count);
+
+    /**
+     * Run the plugin over part of the period, for runBlocks().  Audio ports must be
+     * pointed @p offset frames into their buffers.  Does nothing by default.
+     * @param offset the first frame of the block, since the start of the period
+     * @param length the length of the block, in frames
+     */
+    virtual void runBlock (nframes_t offset, nframes_t length)
+    {
+      Q_UNUSED(offset);
+      Q_UNUSED(length);
+    }
 };
 
 /**
@@ -28,50 +28,287 @@
 #include "ControlBuffer.hpp"
 
 #include <QtCore/QDebug>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QThread>
 
 namespace Unison {
 
+/**
+ * Allocates and frees pooled buffers whenever a pool leaves its watermarks, so the
+ * threads acquiring and releasing them don't have to.
+ */
+class PooledBufferProvider::Refiller : public QThread
+{
+  public:
+    Refiller (PooledBufferProvider& provider) :
+      m_provider(provider)
+    {}
+
+  protected:
+    void run ()
+    {
+      PooledBufferProvider& p = m_provider;
+      forever {
+        const int key = p.m_refill.prepareWait();
+        if (p.m_quit || p.needsRefill()) {
+          p.m_refill.cancelWait();
+        }
+        else {
+          p.m_refill.wait(key);
+        }
+        if (p.m_quit) {
+          break;
+        }
+
+        p.reap();
+        QMutexLocker lock(&p.m_refillMutex);
+        p.fill(AudioPort);
+        p.fill(ControlPort);
+        p.trim(AudioPort);
+        p.trim(ControlPort);
+      }
+    }
+
+  private:
+    PooledBufferProvider& m_provider;
+};
+
+
+PooledBufferProvider::Pool::Pool () :
+  free(POOL_CAPACITY),
+  available(0),
+  misses(0),
+  allocations(0),
+  lowWater(DEFAULT_LOW_WATER),
+  highWater(DEFAULT_HIGH_WATER)
+{}
+
+
 PooledBufferProvider::PooledBufferProvider () :
-  m_audioBuffers(),
-  m_controlBuffers(),
-  m_zeroBuffer( NULL ),
-  m_periodLength(),
-  m_next( 0 )
+  m_audio(),
+  m_control(),
+  m_doomed(POOL_CAPACITY),
+  m_doomedCount(0),
+  m_zeroBuffer(NULL),
+  m_periodLength(0),
+  m_refiller(NULL),
+  m_quit(false)
 {
   qDebug() << "Constructing Pooled BufferProvider";
+  {
+    // Audio buffers wait for a length
+    QMutexLocker lock(&m_refillMutex);
+    fill(ControlPort);
+  }
+  m_refiller = new Refiller(*this);
+  m_refiller->start();
+}
+
+
+PooledBufferProvider::~PooledBufferProvider ()
+{
+  m_quit = true;
+  m_refill.notifyAll();
+  m_refiller->wait();
+  delete m_refiller;
+
+  m_zeroBuffer = NULL;
+  m_zeroBuffers.clear();
+  drain(m_audio);
+  drain(m_control);
+  reap();
 }
 
 
 SharedBufferPtr PooledBufferProvider::acquire (PortType type, nframes_t nframes)
 {
-  Q_ASSERT(nframes == m_periodLength);
-  QStack<Buffer*>* stack;
-  switch (type) {
+  Q_ASSERT(nframes == bufferLength());
+  Q_UNUSED(nframes);
+  Pool* p = pool(type);
+  if (!p) {
+    Q_ASSERT_X(0, "acquire", "unknown port type");
+    return NULL;
+  }
+
+  Buffer* buf = take(*p);
+  if (!buf) {
+    // The Refiller didn't keep up, we are not in the processing thread so allocate
+    buf = allocate(type);
+  }
+  return buf;
+}
+
+
+SharedBufferPtr PooledBufferProvider::acquireRT (PortType type)
+{
+  Pool* p = pool(type);
+  if (!p) {
+    Q_ASSERT_X(0, "acquireRT", "unknown port type");
+    return NULL;
+  }
+  return take(*p);
+}
+
+
+SharedBufferPtr PooledBufferProvider::zeroAudioBuffer () const
+{
+  // Never freed before we are, so taking a reference can't race with a length change
+  return SharedBufferPtr(m_zeroBuffer);
+}
+
+
+void PooledBufferProvider::setBufferLength (nframes_t nframes)
+{
+  QMutexLocker lock(&m_refillMutex);
+  m_periodLength = nframes;
+  qDebug() << "Buffersize changed to" << nframes << "freeing" << m_audio.available
+           << "pooled buffers";
+
+  // Buffers still in use are deleted when they are released, since their length is off
+  drain(m_audio);
+  Buffer* zero = allocate(AudioPort);
+  static_cast<AudioBuffer*>(zero)->setSilent();
+  m_zeroBuffers.append(SharedBufferPtr(zero));
+  m_zeroBuffer.fetchAndStoreOrdered(zero);
+  fill(AudioPort);
+}
+
+
+nframes_t PooledBufferProvider::bufferLength () const
+{
+  return nframes_t(int(m_periodLength));
+}
+
+
+void PooledBufferProvider::setWatermarks (PortType type, int low, int high)
+{
+  Q_ASSERT(0 <= low && low <= high && high <= POOL_CAPACITY);
+  Pool* p = pool(type);
+  if (!p) {
+    Q_ASSERT_X(0, "setWatermarks", "unknown port type");
+    return;
+  }
+
+  QMutexLocker lock(&m_refillMutex);
+  p->lowWater = low;
+  p->highWater = high;
+  fill(type);
+}
+
+
+int PooledBufferProvider::available (PortType type) const
+{
+  const Pool* p = pool(type);
+  return p ? int(p->available) : 0;
+}
+
+
+int PooledBufferProvider::misses (PortType type) const
+{
+  const Pool* p = pool(type);
+  return p ? int(p->misses) : 0;
+}
+
+
+int PooledBufferProvider::allocations (PortType type) const
+{
+  const Pool* p = pool(type);
+  return p ? int(p->allocations) : 0;
+}
+
+
+void PooledBufferProvider::release (Buffer* buf)
+{
+  Pool* p = NULL;
+  switch (buf->type()) {
     case AudioPort:
-      stack = &m_audioBuffers;
+      if (!((AudioBuffer*)buf)->ownsData()) {
+        // Wraps somebody else's data, like JACK's, never hand it out again
+        discard(buf);
+        return;
+      }
+      if (((AudioBuffer*)buf)->length() != bufferLength()) {
+        // Acquired before the buffer length changed
+        discard(buf);
+        return;
+      }
+      p = &m_audio;
       break;
+
     case ControlPort:
-      stack = &m_controlBuffers;
+      p = &m_control;
       break;
+
     default:
-      Q_ASSERT_X(0, "acquire", "unknown port type");
-      return NULL;
+      Q_ASSERT_X(0, "release", "unknown port type");
+      return;
   }
 
-  if (!stack->isEmpty()) {
-    return stack->pop();
+  if (!p->free.push(buf)) {
+    // Only when POOL_CAPACITY buffers are already free, way past the high watermark
+    discard(buf);
+    return;
   }
+  if (p->available.fetchAndAddOrdered(1) + 1 > 2 * p->highWater) {
+    m_refill.notifyAll();
+  }
+}
 
-  //TODO ensure we are not in processing thread
+
+PooledBufferProvider::Pool* PooledBufferProvider::pool (PortType type)
+{
+  switch (type) {
+    case AudioPort:
+      return &m_audio;
+    case ControlPort:
+      return &m_control;
+    default:
+      return NULL;
+  }
+}
+
+
+const PooledBufferProvider::Pool* PooledBufferProvider::pool (PortType type) const
+{
+  return const_cast<PooledBufferProvider*>(this)->pool(type);
+}
+
+
+Buffer* PooledBufferProvider::take (Pool& p)
+{
   Buffer* buf;
+  while (p.free.pop(buf)) {
+    if (p.available.fetchAndAddOrdered(-1) - 1 < p.lowWater) {
+      m_refill.notifyAll();
+    }
+    if (&p == &m_audio && static_cast<AudioBuffer*>(buf)->length() != bufferLength()) {
+      // Released just as the length changed, after drain() emptied the pool
+      discard(buf);
+      continue;
+    }
+    return buf;
+  }
+
+  p.misses.ref();
+  m_refill.notifyAll();
+  return NULL;
+}
+
+
+Buffer* PooledBufferProvider::allocate (PortType type)
+{
+  Buffer* buf = NULL;
   switch (type) {
     case AudioPort:
-      buf = new AudioBuffer( *this, nframes );
+      buf = new AudioBuffer( *this, bufferLength() );
+      m_audio.allocations.ref();
       break;
 
     case ControlPort:
       buf = new ControlBuffer( *this );
+      m_control.allocations.ref();
       break;
+
     default:
      qFatal("Could not aquire non-audio or control buffer");
   }
@@ -80,63 +317,82 @@ SharedBufferPtr PooledBufferProvider::acquire (PortType type, nframes_t nframes)
 }
 
 
-SharedBufferPtr PooledBufferProvider::zeroAudioBuffer () const
+void PooledBufferProvider::fill (PortType type)
 {
-  return m_zeroBuffer;
+  if (type == AudioPort && bufferLength() == 0) {
+    return;
+  }
+
+  Pool& p = *pool(type);
+  while (p.available < p.highWater) {
+    Buffer* buf = allocate(type);
+    if (!p.free.push(buf)) {
+      delete buf;
+      break;
+    }
+    p.available.ref();
+  }
 }
 
 
-void PooledBufferProvider::setBufferLength (nframes_t nframes)
+void PooledBufferProvider::trim (PortType type)
 {
-  m_periodLength = nframes;
-
-  qDebug() << "Buffersize changed to" << nframes << "stacksize" << m_audioBuffers.count();
-  //m_zeroBuffer = acquire( AudioPort, nframes );
-  //Q_ASSERT(nframes == m_periodLength);
-  QStack<Buffer*>* stack;
-  stack = &m_audioBuffers;
-
-  if (!stack->isEmpty()) {
-    m_zeroBuffer = stack->pop();
+  Pool& p = *pool(type);
+  if (p.available <= 2 * p.highWater) {
+    return;
   }
 
   Buffer* buf;
-  qDebug() << "New Audio Buffer " << nframes << " frames.";
-  buf = new AudioBuffer( *this, nframes );
-
-  Q_CHECK_PTR(buf);
-  m_zeroBuffer = buf;
+  while (p.available > p.highWater && p.free.pop(buf)) {
+    p.available.deref();
+    delete buf;
+  }
 }
 
 
-nframes_t PooledBufferProvider::bufferLength ()
+void PooledBufferProvider::drain (Pool& p)
 {
-  return m_periodLength;
+  Buffer* buf;
+  while (p.free.pop(buf)) {
+    p.available.deref();
+    delete buf;
+  }
 }
 
 
-void PooledBufferProvider::release (Buffer* buf)
+void PooledBufferProvider::discard (Buffer* buf)
 {
-  switch (buf->type()) {
-    case AudioPort:
-      if (((AudioBuffer*)buf)->length() != bufferLength()) {
-        qWarning() << "Releasing buffer of wrong size.  Deleting buffer instead!";
-        delete buf;
-      }
-      else {
-        m_audioBuffers.push( buf );
-      }
-      break;
+  // We may be in the processing thread, leave the freeing to the Refiller
+  if (!m_doomed.push(buf)) {
+    // Only when the Refiller is POOL_CAPACITY buffers behind, better late than leaking
+    delete buf;
+    return;
+  }
+  m_doomedCount.ref();
+  m_refill.notifyAll();
+}
 
-    case ControlPort:
-      m_controlBuffers.push(buf);
-      break;
 
-    default:
-      Q_ASSERT_X(0, "release", "unknown port type");
+void PooledBufferProvider::reap ()
+{
+  Buffer* buf;
+  while (m_doomed.pop(buf)) {
+    m_doomedCount.deref();
+    delete buf;
   }
 }
 
+
+bool PooledBufferProvider::needsRefill () const
+{
+  const bool audio = bufferLength() != 0 &&
+      (m_audio.available < m_audio.lowWater || m_audio.available > 2 * m_audio.highWater);
+  const bool control =
+      m_control.available < m_control.lowWater ||
+      m_control.available > 2 * m_control.highWater;
+  return audio || control || m_doomedCount > 0;
+}
+
 } // Unison
 
 // vim: tw=90 ts=8 sw=2 sts=2 et sta noai
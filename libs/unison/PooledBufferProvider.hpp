@@ -26,8 +26,13 @@
 #define UNISON_POOLED_BUFFER_PROVIDER_HPP_
 
 #include "BufferProvider.hpp"
+#include "EventCount.hpp"
+#include "LockFreeStack.hpp"
 
-#include <QtCore/QStack>
+#include <QtCore/QAtomicInt>
+#include <QtCore/QAtomicPointer>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
 
 namespace Unison {
   
@@ -38,18 +43,35 @@ namespace Unison {
  * smart as it could be, but it at least provides reuse of released buffers.  The main
  * benefit of this class, besides memory reuse, is performing RT-unsafe mallocs outside of 
  * the processing thread.
+ *
+ * Free buffers of each type are kept on a lock-free stack, so buffers can be acquired
+ * and released from any thread at the same time.  A background thread keeps every pool
+ * between its low and high watermark: it allocates more when acquiring takes a pool
+ * below the low one, and frees the excess when releasing takes it far above the high
+ * one.  acquire() only allocates itself when the pool ran dry before the thread could
+ * catch up, acquireRT() never does.  Both count these misses, so the watermarks can be
+ * tuned.  Buffers that can't go back to the pool are handed to the thread as well, so
+ * whoever drops the last reference never frees memory either.
  */
 class PooledBufferProvider : public BufferProvider
 {
   public:
+    enum {
+      POOL_CAPACITY = 4096,     ///< Most free buffers of one type that can be held
+      DEFAULT_LOW_WATER = 32,   ///< Free buffers below which the pool is refilled
+      DEFAULT_HIGH_WATER = 128  ///< Free buffers the pool is refilled up to
+    };
+
     PooledBufferProvider ();
 
-    ~PooledBufferProvider()
-    {}
+    ~PooledBufferProvider();
 
     /**
-     * Change the buffer length of this BufferProvider.  What this means exactly isn't
-     * well defined yet.  We need to finish buffersize and samplerate changes first
+     * Change the buffer length of this BufferProvider.  Free audio buffers of the old
+     * length are freed, and the pool is filled up to its high watermark again before
+     * returning.  Buffers of the old length still in use are freed by the background
+     * thread once released, and never handed out again even if one slips back into the
+     * pool.  The old zero buffer is kept until we are destroyed.  Not RT-safe.
      * @param nframes the new buffer length
      */
     void setBufferLength (nframes_t nframes);
@@ -57,22 +79,81 @@ class PooledBufferProvider : public BufferProvider
     /**
      * @returns the current buffer length used by this BufferProvider
      */
-    nframes_t bufferLength ();
+    nframes_t bufferLength () const;
+
+    /**
+     * Set how many free buffers of @p type are kept around, and fill the pool up to
+     * @p high before returning.  Not RT-safe.
+     * @param type AudioPort or ControlPort
+     * @param low the pool is refilled when it has fewer free buffers than this
+     * @param high the pool is refilled up to this many, at most POOL_CAPACITY
+     */
+    void setWatermarks (PortType type, int low, int high);
+
+    /**
+     * @returns the number of free buffers of @p type, approximately
+     */
+    int available (PortType type) const;
+
+    /**
+     * @returns how often a buffer of @p type was acquired while none were free
+     */
+    int misses (PortType type) const;
+
+    /**
+     * @returns the number of buffers of @p type allocated so far
+     */
+    int allocations (PortType type) const;
 
     SharedBufferPtr zeroAudioBuffer () const;
 
     SharedBufferPtr acquire (PortType type, nframes_t nframes);
 
+    SharedBufferPtr acquireRT (PortType type);
+
   protected:
     void release (Buffer* buf);
 
   private:
-    // TODO: Use something RT-safe, instead of QStack
-    QStack<Buffer*> m_audioBuffers;
-    QStack<Buffer*> m_controlBuffers;
-    SharedBufferPtr m_zeroBuffer;
-    nframes_t m_periodLength;
-    int m_next;
+    class Refiller;
+
+    /**
+     * Free buffers of a single type, and the statistics to go with them
+     */
+    struct Pool
+    {
+      Pool ();
+
+      Internal::LockFreeStack<Buffer*> free;
+      QAtomicInt available;   ///< Buffers in free, may be off by a few momentarily
+      QAtomicInt misses;      ///< Acquires that found free empty
+      QAtomicInt allocations; ///< Buffers allocated for the pool
+      int lowWater;
+      int highWater;
+    };
+
+    Pool* pool (PortType type);
+    const Pool* pool (PortType type) const;
+    Buffer* take (Pool& pool);
+    Buffer* allocate (PortType type);
+    void fill (PortType type);
+    void trim (PortType type);
+    void drain (Pool& pool);
+    void discard (Buffer* buf);
+    void reap ();
+    bool needsRefill () const;
+
+    Pool m_audio;
+    Pool m_control;
+    Internal::LockFreeStack<Buffer*> m_doomed; ///< Released, for the Refiller to free
+    QAtomicInt m_doomedCount;
+    QAtomicPointer<Buffer> m_zeroBuffer; ///< The one of the current length
+    QList<SharedBufferPtr> m_zeroBuffers; ///< Every one made, others may be copying one
+    QAtomicInt m_periodLength;
+    QMutex m_refillMutex;           ///< Serializes refilling with length changes
+    Internal::EventCount m_refill;  ///< Wakes the Refiller
+    Refiller* m_refiller;
+    volatile bool m_quit;
 };
 
 } // Unison
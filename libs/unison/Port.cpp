@@ -26,18 +26,18 @@
 
 #include "BufferProvider.hpp"
 #include "Commander.hpp"
+#include "ControlStream.hpp"
 #include "PortConnect.hpp"
 #include "PortDisconnect.hpp"
 
 #include <QDebug>
 
-#define UNISON_BUFFER_LENGTH 1024
-
 namespace Unison {
 
 Port::Port () :
   Node(),
   m_buffer(NULL),
+  m_processBuffer(NULL),
   m_connectedPorts()
 {}
 
@@ -45,9 +45,8 @@ Port::Port () :
 void Port::setBufferLength (nframes_t len)
 {
   Q_UNUSED(len);
-  // TODO: Forcefully resize the buffer we own. Who cares? changing
-  // bufferlength won't happen in the middle of a song, realloc
-  // should be safe.
+  // The processing thread may still be using our buffer, so it is the Patch's next
+  // schedule that hands us one of the new length, see BufferPlanner.
 }
 
 
@@ -119,11 +118,11 @@ void Port::acquireBuffer (BufferProvider& provider)
 {
   switch (direction()) {
     case Input:
-      acquireInputBuffer(provider, UNISON_BUFFER_LENGTH);
+      acquireInputBuffer(provider, provider.bufferLength());
       break;
 
     case Output:
-      acquireOutputBuffer(provider, UNISON_BUFFER_LENGTH);
+      acquireOutputBuffer(provider, provider.bufferLength());
       break;
   }
 }
@@ -149,8 +148,23 @@ void Port::acquireInputBuffer (BufferProvider& provider, nframes_t len)
       break;
     }
     default:
-      qFatal("Internal mixing is not yet supported");
-      return;
+      if (type() != AudioPort) {
+        qFatal("Only audio ports can mix their connections");
+        return;
+      }
+      // A PortMixer sums the connections into a buffer of our own.  Keep the one we
+      // have unless it belongs to somebody else.
+      for (QSet<Port* const>::const_iterator i = m_connectedPorts.begin();
+           i != m_connectedPorts.end(); ++i) {
+        if ((*i)->buffer() == m_buffer) {
+          m_buffer = SharedBufferPtr();
+          break;
+        }
+      }
+      if (m_buffer == provider.zeroAudioBuffer()) {
+        m_buffer = SharedBufferPtr();
+      }
+      break;
   }
 
   if (!m_buffer) {
@@ -178,7 +192,8 @@ void Port::updateBufferValue ()
   if (buffer() && type() == ControlPort) {
     // Verified ControlPort, so data must be a single float
     float* data = static_cast<float*>( buffer()->data() );
-    data[0] = value();
+    const ControlStream* stream = controlStream();
+    data[0] = stream ? stream->value() : value();
   }
 }
 
@@ -31,6 +31,7 @@
 
 namespace Unison {
 
+  class ControlStream;
   class ProcessingContext;
 
 /**
@@ -74,12 +75,34 @@ class Port : public Node
     virtual float value () const = 0;
 
     /**
-     * Instantly set the value of this port, but will only be read by the processing
-     * stages once-per-period
+     * Set the value of this port.  value() returns it right away, the processing thread
+     * sees it from the start of the next period.  Safe to call from any thread.
      * @param the value, bounded by minimum() and maximum()
      */
     virtual void setValue (float value) = 0;
 
+    /**
+     * Set the value of this port from frame @p time on.  Ports backed by a
+     * ControlStream apply the change at that exact frame, the rest fall back to
+     * setValue().  Safe to call from any thread.
+     * @param value the value, bounded by minimum() and maximum()
+     * @param time when it takes effect, on the clock of Backend::frameTime()
+     */
+    virtual void setValueAt (float value, nframes_t time)
+    {
+      Q_UNUSED(time);
+      setValue(value);
+    }
+
+    /**
+     * @returns the ControlStream carrying changes to our value to the processing thread,
+     * or NULL if setValue() reaches it some other way.
+     */
+    virtual ControlStream* controlStream () const
+    {
+      return NULL;
+    }
+
     /**
      * @returns The default value as requested by the plugin
      */
@@ -105,24 +128,82 @@ class Port : public Node
      */
     virtual bool isToggled () const = 0;
 
+    /**
+     * Called outside the processing thread when the period length changes, before the
+     * parent Patch publishes a schedule with buffers of the new length.  Buffers from a
+     * BufferProvider are replaced by that schedule, so there is nothing to do by default.
+     * Ports wrapping data they don't get from a BufferProvider resize the wrapper here.
+     * @param len the new length, in frames
+     */
     virtual void setBufferLength (nframes_t len);
 
-
     /**
      * Assigns a buffer reference to this port.  This buffer will be used by
-     * connectToBuffer to connect the plugin itself.
+     * connectToBuffer to connect the plugin itself, once it is handed to useBuffer().
      */
     void acquireBuffer (BufferProvider& provider);
 
     /**
-     * Called in Process thread to assign the buffer used by this port
-     * sub-classes may choose to assign a buffer from the BufferProvider or
-     * from some other source.
+     * Called in Process thread to connect the plugin to processBuffer(), after
+     * useBuffer() or when the data of the buffer moved.
      */
     virtual void connectToBuffer () = 0;
 
+    /**
+     * Make @p buffer the one the processing thread uses, and connectToBuffer().  Called
+     * in Process thread by the Command or Schedule publishing a buffer the editing
+     * thread picked for us, or before we are processed at all, when activated.  The
+     * caller keeps @p buffer alive until another one is used.
+     */
+    void useBuffer (Buffer* buffer)
+    {
+      m_processBuffer = buffer;
+      connectToBuffer();
+    }
+
     /**
      * Called in Process thread to retrieve the buffer for this Port
+     * @returns the buffer last handed to useBuffer()
+     */
+    Buffer* processBuffer () const
+    {
+      return m_processBuffer;
+    }
+
+    /**
+     * Called in the editing thread when @p consumer is about to be connected to this
+     * Output port, before consumerConnected().  Ports that keep track of their consumers
+     * make room for one more here, so consumerConnected() doesn't have to allocate.
+     * Does nothing by default.
+     */
+    virtual void consumerConnecting (Port* consumer)
+    {
+      Q_UNUSED(consumer);
+    }
+
+    /**
+     * Called in Process thread once @p consumer has been connected to this Output port,
+     * and has connected to our buffer.  Ports that move their buffer between periods use
+     * this to know whom to connectToBuffer() again.  Does nothing by default.
+     */
+    virtual void consumerConnected (Port* consumer)
+    {
+      Q_UNUSED(consumer);
+    }
+
+    /**
+     * Called in Process thread once @p consumer has been disconnected from this Output
+     * port.  Does nothing by default.
+     */
+    virtual void consumerDisconnected (Port* consumer)
+    {
+      Q_UNUSED(consumer);
+    }
+
+    /**
+     * The buffer assigned to this Port as of the latest schedule compiled.  Editing
+     * thread only, the processing thread may still use an older one, see
+     * processBuffer().
      * @returns the currently assigned buffer
      */
     SharedBufferPtr buffer ()
@@ -159,6 +240,12 @@ class Port : public Node
       return m_connectedPorts.end();
     }
 
+    // Private API
+    int connectionCount () const
+    {
+      return m_connectedPorts.count();
+    }
+
     // Private API
     void addConnection (Port* other)
     {
@@ -171,6 +258,12 @@ class Port : public Node
       m_connectedPorts.remove(other);
     }
 
+    // Private API, used when a Schedule shares buffers between ports.  Editing thread
+    void setBuffer (const SharedBufferPtr& buffer)
+    {
+      m_buffer = buffer;
+    }
+
   protected:
     /**
      * Utility function to help subclasses implement connectToBuffer.
@@ -194,6 +287,8 @@ class Port : public Node
      * what the value is.  This allows the port to be connected to a new buffer and still
      * retain the old value.  It also allows the port to never actually be connected at
      * all. Note, the shadowed value is only relevant when the port is disconnected.
+     * Ports with a controlStream() seed the buffer with the value the processing thread
+     * has applied instead, since value() may be ahead of it.
      */
     void updateBufferValue ();
 
@@ -206,7 +301,8 @@ class Port : public Node
     virtual const QSet<Node* const> interfacedNodes () const = 0;
 
   protected:
-    SharedBufferPtr m_buffer; ///< The Buffer in use by this port
+    SharedBufferPtr m_buffer; ///< The Buffer assigned to this port, editing thread
+    Buffer* m_processBuffer;  ///< The Buffer in use by the processing thread
 
   private:
     QSet<Port* const> m_connectedPorts; ///< Ports we are connected to (leakage from Patch)
@@ -24,6 +24,7 @@
 
 #include "PortConnect.hpp"
 
+#include "Commander.hpp"
 #include "Port.hpp"
 #include "ProcessingContext.hpp"
 #include "Scheduler.hpp"
@@ -35,6 +36,7 @@ PortConnect::PortConnect (Port* port1, Port* port2, BufferProvider& bp) :
   Command(false),
   m_producer(NULL),
   m_consumer(NULL),
+  m_buffer(NULL),
   m_patch(NULL),
   m_bufferProvider(bp)
 {
@@ -53,7 +55,9 @@ PortConnect::PortConnect (Port* port1, Port* port2, BufferProvider& bp) :
     m_producer = port2;
   }
 
-  m_compiled = new Schedule();
+  m_compiled = NULL;
+  m_retired = NULL;
+  m_retiredEpoch = 0;
   setState(Command::Created);
 }
 
@@ -70,10 +74,17 @@ void PortConnect::preExecute ()
   m_producer->addConnection(m_consumer);
   m_consumer->addConnection(m_producer);
 
-  //TODO: FIXME IF YOU WANT Mixing support (need BufferProvider ref)
+  // The processing thread keeps using the old buffer until we execute
+  m_replaced = m_consumer->buffer();
   m_consumer->acquireBuffer(m_bufferProvider);
-  
-  m_patch->compileSchedule(*m_compiled);
+  m_producer->consumerConnecting(m_consumer);
+
+  m_patch->compiler().connect(m_producer, m_consumer);
+  if (!m_patch->isEditing()) {
+    m_compiled = new Schedule();
+    m_patch->compileSchedule(*m_compiled);
+  }
+  m_buffer = m_consumer->buffer().data();
   
   Command::preExecute();
 }
@@ -81,15 +92,21 @@ void PortConnect::preExecute ()
 
 void PortConnect::execute (ProcessingContext& context)
 {
-  m_consumer->connectToBuffer();
-  // FIXME: Leaking m_patch->schedule();
-  m_patch->setSchedule(m_compiled);
+  m_consumer->useBuffer(m_buffer);
+  m_producer->consumerConnected(m_consumer);
+  if (m_compiled) {
+    m_retired = m_patch->setSchedule(m_compiled);
+    m_retiredEpoch = Commander::instance()->epoch().current();
+  }
   Command::execute(context);
 }
 
 
 void PortConnect::postExecute ()
 {
+  if (m_retired) {
+    Commander::instance()->retire(m_retired, m_retiredEpoch);
+  }
   Command::postExecute();
 }
 
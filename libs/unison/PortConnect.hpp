@@ -47,8 +47,12 @@ class PortConnect : public Command
   private:
     Port* m_producer;
     Port* m_consumer;
+    SharedBufferPtr m_replaced; ///< The consumer's buffer before, in use until we execute
+    Buffer* m_buffer;           ///< The consumer's buffer after
     Patch* m_patch;
     Schedule* m_compiled;
+    Schedule* m_retired;  ///< The schedule we replaced
+    int m_retiredEpoch;   ///< When we replaced it
     BufferProvider& m_bufferProvider;
 };
 
@@ -25,6 +25,7 @@
 
 #include "PortDisconnect.hpp"
 
+#include "Commander.hpp"
 #include "Port.hpp"
 #include "ProcessingContext.hpp"
 #include "Scheduler.hpp"
@@ -36,10 +37,14 @@ PortDisconnect::PortDisconnect (Port* port1, Port* port2, BufferProvider& bp) :
   Command(false),
   m_port1(port1),
   m_port2(port2),
+  m_buffer1(NULL),
+  m_buffer2(NULL),
   m_patch(NULL),
+  m_compiled(NULL),
+  m_retired(NULL),
+  m_retiredEpoch(0),
   m_bufferProvider(bp)
 {
-  m_compiled = new Schedule();
   setState(Command::Created);
 }
 
@@ -57,12 +62,24 @@ void PortDisconnect::preExecute ()
   m_port2->removeConnection(m_port1);
 
   // Not sure which one is the Input port, but, calling acquire on an output port
-  // again is safe.. 
-  //TODO: FIXME IF YOU WANT Mixing support (need BufferProvider ref)
+  // again is safe..  The processing thread keeps using the old buffers until we execute
+  m_replaced1 = m_port1->buffer();
+  m_replaced2 = m_port2->buffer();
   m_port1->acquireBuffer(m_bufferProvider);
   m_port2->acquireBuffer(m_bufferProvider);
-  
-  m_patch->compileSchedule(*m_compiled);
+
+  if (m_port1->direction() == Output) {
+    m_patch->compiler().disconnect(m_port1, m_port2);
+  }
+  else {
+    m_patch->compiler().disconnect(m_port2, m_port1);
+  }
+  if (!m_patch->isEditing()) {
+    m_compiled = new Schedule();
+    m_patch->compileSchedule(*m_compiled);
+  }
+  m_buffer1 = m_port1->buffer().data();
+  m_buffer2 = m_port2->buffer().data();
   
   Command::preExecute();
 }
@@ -70,16 +87,27 @@ void PortDisconnect::preExecute ()
 
 void PortDisconnect::execute (ProcessingContext& context)
 {
-  m_port1->connectToBuffer();
-  m_port2->connectToBuffer();
-  // FIXME: Leaking m_patch->compiledProcessors();
-  m_patch->setSchedule(m_compiled);
+  m_port1->useBuffer(m_buffer1);
+  m_port2->useBuffer(m_buffer2);
+  if (m_port1->direction() == Output) {
+    m_port1->consumerDisconnected(m_port2);
+  }
+  else {
+    m_port2->consumerDisconnected(m_port1);
+  }
+  if (m_compiled) {
+    m_retired = m_patch->setSchedule(m_compiled);
+    m_retiredEpoch = Commander::instance()->epoch().current();
+  }
   Command::execute(context);
 }
 
 
 void PortDisconnect::postExecute ()
 {
+  if (m_retired) {
+    Commander::instance()->retire(m_retired, m_retiredEpoch);
+  }
   Command::postExecute();
 }
 
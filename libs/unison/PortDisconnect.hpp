@@ -49,8 +49,14 @@ class PortDisconnect : public Command
   private:
     Port* m_port1;
     Port* m_port2;
+    SharedBufferPtr m_replaced1;  ///< The buffers before, in use until we execute
+    SharedBufferPtr m_replaced2;
+    Buffer* m_buffer1;            ///< The buffers after
+    Buffer* m_buffer2;
     Patch* m_patch;
     Schedule* m_compiled;
+    Schedule* m_retired;  ///< The schedule we replaced
+    int m_retiredEpoch;   ///< When we replaced it
     BufferProvider& m_bufferProvider;
 };
 
@@ -0,0 +1,117 @@
+/*
+ * PortMixer.cpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "PortMixer.hpp"
+
+#include "AudioBuffer.hpp"
+#include "Dsp.hpp"
+#include "Port.hpp"
+#include "ProcessingContext.hpp"
+
+namespace Unison {
+  namespace Internal {
+
+PortMixer::PortMixer (Port* port) :
+  m_port(port),
+  m_target(NULL)
+{
+  for (QSet<Port* const>::const_iterator pi = port->connectionsBegin();
+       pi != port->connectionsEnd(); ++pi) {
+    m_sources.append(*pi);
+  }
+}
+
+
+QString PortMixer::name () const
+{
+  return m_port->name() + " (mix)";
+}
+
+
+void PortMixer::setBuffers (AudioBuffer* target, const QVector<AudioBuffer*>& sources)
+{
+  Q_ASSERT(sources.count() == m_sources.count());
+  m_target = target;
+  m_sourceBuffers = sources;
+}
+
+
+void PortMixer::process (const ProcessingContext& context)
+{
+  const nframes_t n = context.bufferSize();
+  AudioBuffer* target = m_target;
+  if (!target || target->length() < n) {
+    return;
+  }
+  sample_t* out = static_cast<sample_t*>(target->data());
+
+  // Skip the producer whose buffer we were handed, its data is there already.  Those
+  // known to be silent add nothing either, but looking would cost as much as adding.
+  const AudioBuffer* const* sources = m_sourceBuffers.constData();
+  const int count = m_sourceBuffers.count();
+  bool empty = true;
+  for (int i=0; i<count; ++i) {
+    if (sources[i] == target) {
+      empty = target->isKnownSilent();
+      break;
+    }
+  }
+
+  for (int i=0; i<count; ++i) {
+    const AudioBuffer* source = sources[i];
+    if (!source || source == target || source->isKnownSilent()) {
+      continue;
+    }
+    const sample_t* in = static_cast<const sample_t*>(source->data());
+    if (empty) {
+      Dsp::copy(out, in, n);
+      empty = false;
+    }
+    else {
+      Dsp::mix(out, in, n);
+    }
+    target->markWritten();
+  }
+
+  if (empty && !target->isKnownSilent()) {
+    Dsp::zero(out, target->length());
+    target->setSilent();
+  }
+}
+
+
+bool PortMixer::isMixed (Port* port)
+{
+  if (port->direction() != Input || port->type() != AudioPort) {
+    return false;
+  }
+  QSet<Port* const>::const_iterator pi = port->connectionsBegin();
+  QSet<Port* const>::const_iterator end = port->connectionsEnd();
+  return pi != end && ++pi != end;
+}
+
+  } // Internal
+} // Unison
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
@@ -0,0 +1,130 @@
+/*
+ * PortMixer.hpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef UNISON_PORT_MIXER_HPP_
+#define UNISON_PORT_MIXER_HPP_
+
+#include "Processor.hpp"
+
+#include <QVector>
+
+namespace Unison {
+
+  class AudioBuffer;
+
+  namespace Internal {
+
+/**
+ * Sums the connections of an audio input port into the port's buffer.  The
+ * ScheduleCompiler puts a PortMixer between the producers of every input with more than
+ * one connection and the port's processor, so mixing is scheduled like any other work.
+ * The connections are copied when the mixer is made, and the Schedule running it owns
+ * it.  A PortMixer has no ports itself, and no parent.
+ *
+ * If the BufferPlanner has handed the port the buffer of one of its producers, that
+ * producer's data is already in place and only the others are added to it.  Otherwise
+ * the first producer is copied in, and the rest added.  Producers known to be silent
+ * are left out, and if that is all of them the port's buffer is marked silent too.
+ *
+ * The buffers are those the Schedule running us hands to the ports, found when it is
+ * compiled, see Schedule::trackMixers().  The processing thread never asks the ports.
+ * Should the port's buffer be shorter than the period, nothing is mixed. */
+class PortMixer : public Processor
+{
+  public:
+    /**
+     * Not RT-safe.
+     * @param port the audio input whose current connections to mix */
+    PortMixer (Port* port);
+
+    /**
+     * @returns the input port whose connections we mix */
+    Port* mixedPort () const
+    {
+      return m_port;
+    }
+
+    /**
+     * @returns the connections of mixedPort() when we were made */
+    const QVector<Port*>& sources () const
+    {
+      return m_sources;
+    }
+
+    /**
+     * Set the buffers to mix, as the Schedule running us hands them to the ports.  Not
+     * RT-safe.
+     * @param target the buffer of mixedPort(), NULL to mix nothing
+     * @param sources the buffers of sources(), in the same order, NULL for none */
+    void setBuffers (AudioBuffer* target, const QVector<AudioBuffer*>& sources);
+
+    QString name () const;
+
+    int portCount () const
+    {
+      return 0;
+    }
+
+    Port* port (int idx) const
+    {
+      Q_UNUSED(idx);
+      return NULL;
+    }
+
+    Port* port (const QString& name) const
+    {
+      Q_UNUSED(name);
+      return NULL;
+    }
+
+    void activate (BufferProvider&)
+    {}
+
+    void deactivate ()
+    {}
+
+    void process (const ProcessingContext& context);
+
+    bool isInPlaceBroken () const
+    {
+      return false;
+    }
+
+    /**
+     * @returns @c true if @p port needs a PortMixer to read its connections */
+    static bool isMixed (Port* port);
+
+  private:
+    Port* m_port;
+    QVector<Port*> m_sources; ///< The connections of m_port when we were made
+    AudioBuffer* m_target;    ///< Buffer of m_port, see setBuffers()
+    QVector<AudioBuffer*> m_sourceBuffers; ///< Buffers of m_sources, likewise
+};
+
+  } // Internal
+} // Unison
+
+#endif
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
@@ -25,19 +25,25 @@
 #include "PostExecuter.hpp"
 
 #include "Command.hpp"
+#include "Epoch.hpp"
+#include "Profiler.hpp"
+#include "Scheduler.hpp"
 
 #include <QDebug>
-#include <QWaitCondition>
 
 namespace Unison {
   namespace Internal {
 
 
-PostExecuter::PostExecuter() :
+PostExecuter::PostExecuter(const Epoch& epoch) :
   QThread(),
   m_buffer(COMMAND_BUFFER_LENGTH),
-  m_done(false)
+  m_done(false),
+  m_epoch(epoch)
 {
+  Latency none = { 0, 0, 0 };
+  m_recycle = none;
+  m_reclaim = none;
 }
 
 
@@ -49,20 +55,21 @@ PostExecuter::~PostExecuter()
 
 void PostExecuter::push (Command* command)
 {
-  m_buffer.write(&command, 1);
-
+  Executed executed;
+  executed.command = command;
+  executed.pushed = Profiler::now();
+  m_buffer.write(&executed, 1);
 }
 
 
 void PostExecuter::run ()
 {
   const int bufSize = 8;
-  Command* buf[bufSize];
+  Executed buf[bufSize];
 
   setPriority(QThread::LowestPriority);
 
   forever {
-    QThread::msleep(IDLE_TIMEOUT);
     const bool done = m_done;
 
     // Hold on to done, and check after loop, gives us a final iteration for cleanup
@@ -70,13 +77,30 @@ void PostExecuter::run ()
     do {
       cnt = m_buffer.read(buf, bufSize);
       for (int i=0; i<cnt; ++i) {
-        postExecute(buf[i]);
+        postExecute(buf[i].command);
+        record(m_recycle, buf[i].pushed);
       }
 
     } while (cnt > 0);
 
+    reclaim();
+
     if (done)
       break;
+
+    if (!m_retired.isEmpty()) {
+      // Nobody tells us when the processing thread leaves its period
+      QThread::msleep(RECLAIM_INTERVAL);
+      continue;
+    }
+
+    const int key = m_wake.prepareWait();
+    if (m_buffer.readSpace() > 0 || m_done) {
+      m_wake.cancelWait();
+    }
+    else {
+      m_wake.wait(key);
+    }
   }
 }
 
@@ -84,6 +108,7 @@ void PostExecuter::run ()
 bool PostExecuter::stop ()
 {
   m_done = true;
+  m_wake.notifyAll();
   // Wait for another iteration
   return wait();
 }
@@ -96,6 +121,38 @@ void PostExecuter::postExecute (Command* cmd)
 }
 
 
+void PostExecuter::retire (Schedule* schedule, int epoch)
+{
+  Retired r;
+  r.schedule = schedule;
+  r.epoch = epoch;
+  r.retired = Profiler::now();
+  m_retired.append(r);
+}
+
+
+void PostExecuter::reclaim ()
+{
+  // Retired in order, so stop at the first one still in use
+  while (!m_retired.isEmpty() && m_epoch.isQuiescentSince(m_retired.first().epoch)) {
+    const Retired r = m_retired.takeFirst();
+    delete r.schedule;
+    record(m_reclaim, r.retired);
+  }
+}
+
+
+void PostExecuter::record (Latency& latency, qint64 since)
+{
+  const qint64 elapsed = Profiler::now() - since;
+  latency.total += elapsed;
+  if (elapsed > latency.max) {
+    latency.max = elapsed;
+  }
+  ++latency.count;
+}
+
+
   } // Internal
 } // Unison
 
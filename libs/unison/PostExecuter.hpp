@@ -26,8 +26,10 @@
 #ifndef UNISON_POST_EXECUTER_HPP_
 #define UNISON_POST_EXECUTER_HPP_
 
+#include "EventCount.hpp"
 #include "RingBuffer.hpp"
 
+#include <QList>
 #include <QThread>
 
 namespace Unison {
@@ -36,25 +38,77 @@ namespace Unison {
 
   namespace Internal {
 
+    class Epoch;
+    class Schedule;
+
 /**
  * PostExecuter is responsible for post-executing and deleting finished Commands.
  * There is only one client (the Commander), so, our RingBuffer implementation is
- * enough to guarantee exclusion. */
+ * enough to guarantee exclusion.  The PostExecuter also frees Schedules that have been
+ * swapped out, once the processing thread has left the period they were retired in.
+ * The thread sleeps until the Commander wakes it, it only polls while a Schedule is
+ * waiting for the processing thread to move on. */
 class PostExecuter : public QThread
 {
   Q_OBJECT
   Q_DISABLE_COPY(PostExecuter)
 
   public:
-    PostExecuter();
+    /**
+     * @param epoch the Epoch of the processing thread, used to reclaim Schedules */
+    PostExecuter(const Epoch& epoch);
     virtual ~PostExecuter();
 
     /**
      * Push an executed command onto the queue.  It will be post-executed and
-     * deleted shortly.
+     * deleted shortly.  Check hasRoom() first, a full queue drops the Command.
      * @param command The command to post-execute */
     void push (Command* command);
 
+    /**
+     * Wake the thread up to deal with the Commands pushed so far.  RT-safe */
+    void wake ()
+    {
+      m_wake.notifyAll();
+    }
+
+    /**
+     * @returns @c true if push() can take another Command.  RT-safe */
+    bool hasRoom () const
+    {
+      return m_buffer.writeSpace() > 0;
+    }
+
+    /**
+     * Free @p schedule as soon as the processing thread is guaranteed to be done with
+     * it.  Must only be called from this thread, that is, from Command::postExecute.
+     * @param schedule the Schedule that was replaced
+     * @param epoch Epoch::current() at the time @p schedule was replaced */
+    void retire (Schedule* schedule, int epoch);
+
+    /**
+     * Time between being handed something and getting rid of it */
+    struct Latency
+    {
+      int count;    ///< Number of things gotten rid of
+      qint64 total; ///< Sum of their latencies, in nsec
+      qint64 max;   ///< Longest latency, in nsec
+    };
+
+    /**
+     * @returns the time from Commands being pushed to them being deleted */
+    Latency recycleLatency () const
+    {
+      return m_recycle;
+    }
+
+    /**
+     * @returns the time from Schedules being retired to them being freed */
+    Latency reclaimLatency () const
+    {
+      return m_reclaim;
+    }
+
   protected:
     virtual void run();
 
@@ -69,14 +123,42 @@ class PostExecuter : public QThread
      * @param command The command to post-execute, now. */
     void postExecute (Command* command);
 
+    /**
+     * Free the retired Schedules that are no longer visible to the processing thread */
+    void reclaim ();
+
   private:
     enum {
       COMMAND_BUFFER_LENGTH = 1024, ///< How big is our buffer?
-      IDLE_TIMEOUT = 250            ///< How long to idle, in msec
+      RECLAIM_INTERVAL = 1          ///< How often to check on retired Schedules, in msec
+    };
+
+    /**
+     * A Command the processing thread is done with */
+    struct Executed
+    {
+      Command* command;
+      qint64 pushed;  ///< Profiler::now() when it was pushed
+    };
+
+    /**
+     * A Schedule waiting for the processing thread to move on */
+    struct Retired
+    {
+      Schedule* schedule;
+      int epoch;
+      qint64 retired; ///< Profiler::now() when it was retired
     };
 
-    RingBuffer<Command*> m_buffer;  ///< Storage for queued Commands
-    bool m_done;                    ///< Flag to kill loop
+    static void record (Latency& latency, qint64 since);
+
+    RingBuffer<Executed> m_buffer;  ///< Storage for queued Commands
+    EventCount m_wake;              ///< Notified when Commands are pushed
+    volatile bool m_done;           ///< Flag to kill loop
+    const Epoch& m_epoch;           ///< Epoch of the processing thread
+    QList<Retired> m_retired;       ///< Schedules waiting to be freed, oldest first
+    Latency m_recycle;
+    Latency m_reclaim;
 };
 
 
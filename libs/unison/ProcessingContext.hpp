@@ -38,8 +38,9 @@ namespace Unison {
 class ProcessingContext
 {
   public:
-    ProcessingContext (nframes_t bufferSize) :
-      m_bufferSize(bufferSize)
+    ProcessingContext (nframes_t bufferSize, nframes_t frameTime = 0) :
+      m_bufferSize(bufferSize),
+      m_frameTime(frameTime)
     {}
 
 
@@ -48,8 +49,18 @@ class ProcessingContext
       return m_bufferSize;
     }
 
+    /**
+     * @returns the time of the first frame of this period, as counted by the Backend,
+     *          see Backend::frameTime().  Wraps around.
+     */
+    nframes_t frameTime () const
+    {
+      return m_frameTime;
+    }
+
   private:
     nframes_t m_bufferSize;
+    nframes_t m_frameTime;
 };
 
 } // Unison
@@ -89,14 +89,43 @@ class Processor : public Node
     virtual void process (const ProcessingContext& context) = 0;
 
     /**
-     * Change the bufferLength of the processor.  XXX: The contract of this function is
-     * not finalized.  We need to put more thought into samplerate and buffersize changes
+     * Change the bufferLength of the processor.  Called outside the processing thread,
+     * which may keep running us with the old length until the parent Patch publishes a
+     * schedule with buffers of the new length.  Processors keeping state that depends on
+     * the length must be ready for both until then.  Passes @p len on to every port of
+     * @p type by default.  XXX: Samplerate changes still need the same treatment.
      * @param type the type of Port that needs to be resized.  Currently only
      *        @c AudioPort or @c MidiPort makes sense.
      * @param len the length to resize to
      */
     virtual void setBufferLength (PortType type, nframes_t len);
 
+    /**
+     * Whether the processor fails when an audio output shares its buffer with one of its
+     * audio inputs.  If it doesn't, the Patch may run it in-place and save a buffer.
+     * Processors that don't know are assumed to be broken.
+     * @returns @c true unless the processor is known to work in-place
+     */
+    virtual bool isInPlaceBroken () const
+    {
+      return true;
+    }
+
+    /**
+     * How long the processor may keep making sound once all of its audio inputs have
+     * gone silent, a reverb's decay for example.  After the inputs have been silent for
+     * that long, the Worker skips the processor and silences its audio outputs instead,
+     * until an input makes sound again.  Processors without audio inputs, or that don't
+     * know, are never skipped.
+     * @returns the tail in frames, or UNKNOWN_TAIL (the default)
+     */
+    virtual nframes_t tailLength () const
+    {
+      return UNKNOWN_TAIL;
+    }
+
+    static const nframes_t UNKNOWN_TAIL = 0xffffffff; ///< See tailLength()
+
     //// Connection oriented Stuff ////
 
     Node* parent () const;
@@ -0,0 +1,137 @@
+/*
+ * Profiler.cpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "Profiler.hpp"
+
+#include "Patch.hpp"
+
+#include <QSet>
+#include <QtAlgorithms>
+
+namespace Unison {
+
+/// Weight of a new sample in the rolling mean
+static const double MEAN_WEIGHT = 1.0 / 64.0;
+
+
+Profiler::Profiler (int slotCount)
+{
+  Q_ASSERT(slotCount > 0);
+  for (int i=0; i<slotCount; ++i) {
+    m_slots.append(new ProfileSlot(SLOT_SIZE));
+  }
+}
+
+
+Profiler::~Profiler ()
+{
+  qDeleteAll(m_slots);
+  qDeleteAll(m_history);
+}
+
+
+void Profiler::collect ()
+{
+  QSet<History*> touched;
+  ProfileSample samples[64];
+
+  foreach (ProfileSlot* slot, m_slots) {
+    int count;
+    while ((count = slot->read(samples, 64)) > 0) {
+      for (int i=0; i<count; ++i) {
+        add(samples[i]);
+        touched.insert(m_history.value(samples[i].processor));
+      }
+    }
+  }
+
+  // Now update the percentiles, once per Processor
+  QVector<int32_t> sorted;
+  foreach (History* h, touched) {
+    sorted = h->window;
+    qSort(sorted.begin(), sorted.end());
+    h->stats.p99 = sorted.at((sorted.count() * 99) / 100);
+  }
+}
+
+
+void Profiler::add (const ProfileSample& sample)
+{
+  History* h = m_history.value(sample.processor);
+  if (!h) {
+    h = new History();
+    h->stats.count = 0;
+    h->stats.max = 0;
+    h->mean = sample.duration;
+    h->window.reserve(WINDOW);
+    h->next = 0;
+    m_history.insert(sample.processor, h);
+  }
+
+  h->stats.count++;
+  h->stats.max = qMax(h->stats.max, int(sample.duration));
+  h->mean += (sample.duration - h->mean) * MEAN_WEIGHT;
+  h->stats.mean = int(h->mean + 0.5);
+
+  if (h->window.count() < WINDOW) {
+    h->window.append(sample.duration);
+  }
+  else {
+    h->window[h->next] = sample.duration;
+    h->next = (h->next + 1) % WINDOW;
+  }
+}
+
+
+void Profiler::reset ()
+{
+  qDeleteAll(m_history);
+  m_history.clear();
+}
+
+
+ProcessorStats Profiler::stats (const Processor* processor) const
+{
+  History* h = m_history.value(processor);
+  if (!h) {
+    ProcessorStats none = { 0, 0, 0, 0 };
+    return none;
+  }
+  return h->stats;
+}
+
+
+void Profiler::applyWeights (Patch& patch) const
+{
+  foreach (Processor* p, patch.processors()) {
+    History* h = m_history.value(p);
+    if (h) {
+      patch.setCost(p, h->stats.mean);
+    }
+  }
+}
+
+} // Unison
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
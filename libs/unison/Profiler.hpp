@@ -0,0 +1,160 @@
+/*
+ * Profiler.hpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#ifndef UNISON_PROFILER_HPP_
+#define UNISON_PROFILER_HPP_
+
+#include "RingBuffer.hpp"
+#include "types.hpp"
+
+#include <QHash>
+#include <QList>
+#include <QVector>
+#include <time.h>
+
+namespace Unison {
+
+  class Patch;
+  class Processor;
+
+/**
+ * A single timing of Processor::process, as recorded by a Worker */
+struct ProfileSample
+{
+  const Processor* processor; ///< Processor that was run
+  int32_t duration;           ///< Time spent in process, in nanoseconds
+};
+
+
+/**
+ * Each Worker writes its samples to its own slot, so the RT side never contends.  If
+ * the slot is full the sample is simply lost. */
+typedef RingBuffer<ProfileSample> ProfileSlot;
+
+
+/**
+ * Statistics of a single Processor, all durations are in nanoseconds */
+struct ProcessorStats
+{
+  int count;  ///< Number of samples collected so far
+  int mean;   ///< Rolling mean
+  int p99;    ///< 99th percentile of the most recent samples
+  int max;    ///< Longest run seen since the last reset
+};
+
+
+/**
+ * Measures how long each Processor takes to run while the Backend is processing.  The
+ * Profiler owns one ProfileSlot per Worker, the Workers time every call to
+ * Processor::process and write the result to their slot.  Periodically, non-RT code
+ * calls collect() to drain the slots and update the statistics.  The statistics can
+ * then be inspected, or fed back into a Patch with applyWeights() so that the next
+ * compiled schedule knows the real critical path. */
+class Profiler
+{
+  Q_DISABLE_COPY(Profiler)
+
+  public:
+    enum {
+      SLOT_SIZE = 4096, ///< Samples each slot holds between collections
+      WINDOW = 256      ///< Number of recent samples used for the p99
+    };
+
+    /**
+     * @param slotCount the number of slots, one per Worker */
+    Profiler (int slotCount);
+    ~Profiler ();
+
+    int slotCount () const
+    {
+      return m_slots.count();
+    }
+
+    /**
+     * @returns the slot to be handed to Worker @p index */
+    ProfileSlot* slot (int index) const
+    {
+      return m_slots.at(index);
+    }
+
+    /**
+     * Drain all of the slots and update the statistics.  Not RT-safe, must only be
+     * called from a single thread. */
+    void collect ();
+
+    /**
+     * Forget all the statistics collected so far. */
+    void reset ();
+
+    /**
+     * @returns the Processors we have statistics for.  The pointers are only used as
+     *          keys, they may dangle if a Processor has been deleted since. */
+    QList<const Processor*> processors () const
+    {
+      return m_history.keys();
+    }
+
+    /**
+     * @returns the statistics for @p processor, all zero if it was never run */
+    ProcessorStats stats (const Processor* processor) const;
+
+    /**
+     * Set the cost of every child of @p patch that has been measured to its mean run
+     * time.  The costs are used the next time the Patch compiles its schedule.
+     * @param patch the Patch to update */
+    void applyWeights (Patch& patch) const;
+
+    /**
+     * An RT-safe monotonic timestamp.
+     * @returns the current time in nanoseconds */
+    static inline int64_t now ()
+    {
+      timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+
+  private:
+    /**
+     * Everything we know about one Processor */
+    struct History
+    {
+      ProcessorStats stats;
+      double mean;              ///< Unrounded rolling mean
+      QVector<int32_t> window;  ///< The most recent durations, circular
+      int next;                 ///< Where the next duration goes in the window
+    };
+
+    void add (const ProfileSample& sample);
+
+    QList<ProfileSlot*> m_slots;                      ///< One per Worker
+    QHash<const Processor*, History*> m_history;      ///< Statistics by Processor
+};
+
+} // Unison
+
+#endif
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
@@ -0,0 +1,72 @@
+/*
+ * PublishSchedule.cpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include "PublishSchedule.hpp"
+
+#include "Commander.hpp"
+#include "Patch.hpp"
+#include "ProcessingContext.hpp"
+#include "Scheduler.hpp"
+
+namespace Unison {
+  namespace Internal {
+
+PublishSchedule::PublishSchedule (Patch* patch) :
+  Command(false),
+  m_patch(patch),
+  m_compiled(NULL),
+  m_retired(NULL),
+  m_retiredEpoch(0)
+{
+  setState(Command::Created);
+}
+
+
+void PublishSchedule::preExecute ()
+{
+  m_compiled = new Schedule();
+  m_patch->compileSchedule(*m_compiled);
+  Command::preExecute();
+}
+
+
+void PublishSchedule::execute (ProcessingContext& context)
+{
+  m_retired = m_patch->setSchedule(m_compiled);
+  m_retiredEpoch = Commander::instance()->epoch().current();
+  Command::execute(context);
+}
+
+
+void PublishSchedule::postExecute ()
+{
+  Commander::instance()->retire(m_retired, m_retiredEpoch);
+  Command::postExecute();
+}
+
+  } // Internal
+} // Unison
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
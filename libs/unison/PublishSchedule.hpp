@@ -0,0 +1,62 @@
+/*
+ * PublishSchedule.hpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#ifndef UNISON_PUBLISH_SCHEDULE_HPP_
+#define UNISON_PUBLISH_SCHEDULE_HPP_
+
+#include "Command.hpp"
+
+namespace Unison {
+
+  class Patch;
+
+  namespace Internal {
+
+    class Schedule;
+
+/**
+ * Compiles the schedule of a Patch and hands it to the processing thread.  Used to
+ * publish the result of many edits at once, see Patch::endEdit().
+ */
+class PublishSchedule : public Command
+{
+  public:
+    PublishSchedule (Patch* patch);
+    void preExecute ();
+    void execute (ProcessingContext& context);
+    void postExecute ();
+  private:
+    Patch* m_patch;
+    Schedule* m_compiled;
+    Schedule* m_retired;  ///< The schedule we replaced
+    int m_retiredEpoch;   ///< When we replaced it
+};
+
+  } // Internal
+} // Unison
+
+#endif
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
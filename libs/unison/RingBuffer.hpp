@@ -25,6 +25,8 @@
 #ifndef UNISON_RING_BUFFER_HPP_
 #define UNISON_RING_BUFFER_HPP_
 
+#include "RtArena.hpp"
+
 #include <QObject>
 
 namespace Unison {
@@ -37,6 +39,9 @@ namespace Unison {
  * using any synchronization or mutual exclusion primitives.  For this to work correctly,
  * there can only be a single reader and a single writer thread.  Their identities cannot
  * be interchanged.
+ *
+ * SpscRingBuffer is faster, and can hand out its contents without copying, for heavier
+ * traffic.
  */
 template <typename T>
 class RingBuffer
@@ -44,7 +49,8 @@ class RingBuffer
 
   public:
     /**
-     * Contruct a ringbuffer, specifying the internal buffer size.
+     * Contruct a ringbuffer, specifying the internal buffer size.  The buffer is
+     * allocated from the RtArena.
      * @param size  The size of the buffer to be allocated
      */
     RingBuffer (const int size);
@@ -121,7 +127,7 @@ class RingBuffer
      */
     int peek (T* dest, int cnt) const;
 
-    /* TODO: Non-copy peek (ala, jack_rb_get_read_vector() */
+    /* For a non-copy peek (ala, jack_rb_get_read_vector()) use SpscRingBuffer */
 
     /**
      * Advance the read pointer by the specified number of elements.  The data is not
@@ -155,7 +161,7 @@ class RingBuffer
 template<typename T>
 RingBuffer<T>::RingBuffer (const int size) :
   m_size(size),
-  m_data(reinterpret_cast<T*>( new char[size * sizeof(T)] ))
+  m_data(static_cast<T*>( RtArena::allocate(size * sizeof(T)) ))
 {
   reset();
 }
@@ -164,8 +170,7 @@ RingBuffer<T>::RingBuffer (const int size) :
 template<typename T>
 RingBuffer<T>::~RingBuffer ()
 {
-  char* data = reinterpret_cast<char*>(m_data);
-  delete[] data;
+  RtArena::free(m_data);
 }
 
 
@@ -253,7 +258,7 @@ int RingBuffer<T>::peekChunk (T* dest, int cnt) const
 
   const int readable = (readPtr + cnt < m_size) ?
                         cnt :
-                        m_size - readable;
+                        m_size - readPtr;
 
   memcpy(dest, &m_data[readPtr], readable*sizeof(T));
 
@@ -269,12 +274,12 @@ int RingBuffer<T>::peek (T* dest, int cnt) const
   // Read as much as possible until end of buffer
   const int readable = peekChunk(dest, cnt);
 
-  // Read the rest from the front of the buffer
+  // Read the rest from the front of the buffer, the read pointer did not move
   if (readable < cnt) {
-    return readable + peekChunk(dest + readable, cnt - readable);
+    memcpy(dest + readable, m_data, (cnt - readable)*sizeof(T));
   }
 
-  return readable;
+  return cnt;
 }
 
 
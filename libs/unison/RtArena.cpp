@@ -0,0 +1,346 @@
+/*
+ * RtArena.cpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "RtArena.hpp"
+
+#include "types.hpp"
+
+#include <QtCore/QDebug>
+#include <QtCore/QList>
+#include <QtCore/QMap>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QVector>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+namespace Unison {
+  namespace Internal {
+
+/** Block sizes of the size classes, powers of two and one and a half times those */
+static const int CLASS_SIZES[] = {
+  64, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096, 6144, 8192, 12288,
+  16384, 24576, 32768
+};
+static const int CLASS_COUNT = sizeof(CLASS_SIZES) / sizeof(CLASS_SIZES[0]);
+
+enum {
+  HUGE_PAGE_SIZE = 2 * 1024 * 1024,  ///< Reservations are rounded to this for huge pages
+  SPAN_UNUSED = -2,                  ///< Span class of spans never handed out, or free
+  SPAN_RUN = -1                      ///< Span class of the first span of a big request
+};
+
+
+/**
+ * The state behind RtArena, guarded by a single mutex */
+class Arena
+{
+  public:
+    Arena (char* base, size_t size, bool hugePages) :
+      m_base(base),
+      m_size(size),
+      m_hugePages(hugePages),
+      m_spanCount(size / RtArena::SPAN_SIZE),
+      m_top(0),
+      m_locked(0),
+      m_inUse(0),
+      m_peak(0),
+      m_fallbacks(0),
+      m_warned(false)
+    {
+      Span unused = { SPAN_UNUSED, 0 };
+      m_spans.fill(unused, m_spanCount);
+      for (int i=0; i<CLASS_COUNT; ++i) {
+        m_free[i] = NULL;
+      }
+    }
+
+    bool contains (const void* p) const
+    {
+      const char* c = static_cast<const char*>(p);
+      return c >= m_base && c < m_base + m_size;
+    }
+
+    /** @returns the memory, or NULL if the arena is exhausted */
+    void* allocate (size_t size)
+    {
+      QMutexLocker lock(&m_mutex);
+      void* p = NULL;
+      size_t bytes;
+      const int sizeClass = classOf(size);
+      if (sizeClass >= 0) {
+        if (!m_free[sizeClass]) {
+          carve(sizeClass);
+        }
+        p = m_free[sizeClass];
+        if (p) {
+          m_free[sizeClass] = *static_cast<void**>(p);
+        }
+        bytes = CLASS_SIZES[sizeClass];
+      }
+      else {
+        const int count = (size + RtArena::SPAN_SIZE - 1) / RtArena::SPAN_SIZE;
+        const int first = takeSpans(count);
+        if (first >= 0) {
+          m_spans[first].sizeClass = SPAN_RUN;
+          m_spans[first].run = count;
+          p = m_base + size_t(first) * RtArena::SPAN_SIZE;
+        }
+        bytes = size_t(count) * RtArena::SPAN_SIZE;
+      }
+
+      if (!p) {
+        ++m_fallbacks;
+        return NULL;
+      }
+      m_inUse += bytes;
+      m_peak = qMax(m_peak, m_inUse);
+      return p;
+    }
+
+    void free (void* p)
+    {
+      QMutexLocker lock(&m_mutex);
+      const int span = (static_cast<char*>(p) - m_base) / RtArena::SPAN_SIZE;
+      Span& s = m_spans[span];
+      Q_ASSERT(s.sizeClass != SPAN_UNUSED);
+      if (s.sizeClass == SPAN_RUN) {
+        Q_ASSERT(p == m_base + size_t(span) * RtArena::SPAN_SIZE);
+        m_inUse -= size_t(s.run) * RtArena::SPAN_SIZE;
+        m_freeRuns[s.run].append(span);
+        s.sizeClass = SPAN_UNUSED;
+      }
+      else {
+        *static_cast<void**>(p) = m_free[s.sizeClass];
+        m_free[s.sizeClass] = p;
+        m_inUse -= CLASS_SIZES[s.sizeClass];
+      }
+    }
+
+    RtArena::Usage usage () const
+    {
+      QMutexLocker lock(&m_mutex);
+      RtArena::Usage u;
+      u.reserved = m_size;
+      u.committed = size_t(m_top) * RtArena::SPAN_SIZE;
+      u.locked = m_locked;
+      u.inUse = m_inUse;
+      u.peak = m_peak;
+      u.fallbacks = m_fallbacks;
+      u.hugePages = m_hugePages;
+      return u;
+    }
+
+  private:
+    struct Span
+    {
+      int sizeClass;  ///< Index into CLASS_SIZES, or SPAN_RUN / SPAN_UNUSED
+      int run;        ///< Length of the run, for SPAN_RUN
+    };
+
+    /** @returns the smallest class @p size fits in, or -1 if it needs whole spans */
+    static int classOf (size_t size)
+    {
+      for (int i=0; i<CLASS_COUNT; ++i) {
+        if (size <= size_t(CLASS_SIZES[i])) {
+          return i;
+        }
+      }
+      return -1;
+    }
+
+    /** Split a fresh span into blocks of @p sizeClass, lowest address first */
+    void carve (int sizeClass)
+    {
+      const int span = takeSpans(1);
+      if (span < 0) {
+        return;
+      }
+      m_spans[span].sizeClass = sizeClass;
+      const int size = CLASS_SIZES[sizeClass];
+      char* begin = m_base + size_t(span) * RtArena::SPAN_SIZE;
+      for (char* block = begin + (RtArena::SPAN_SIZE / size - 1) * size;
+           block >= begin; block -= size) {
+        *reinterpret_cast<void**>(block) = m_free[sizeClass];
+        m_free[sizeClass] = block;
+      }
+    }
+
+    /** @returns the first of @p count consecutive spans, or -1 if the arena is full */
+    int takeSpans (int count)
+    {
+      QMap<int, QList<int> >::iterator i = m_freeRuns.lowerBound(count);
+      if (i != m_freeRuns.end()) {
+        const int length = i.key();
+        const int first = i.value().takeLast();
+        if (i.value().isEmpty()) {
+          m_freeRuns.erase(i);
+        }
+        if (length > count) {
+          m_freeRuns[length - count].append(first + count);
+        }
+        return first;
+      }
+
+      if (m_top + count > m_spanCount) {
+        return -1;
+      }
+      const int first = m_top;
+      m_top += count;
+      lock(m_base + size_t(first) * RtArena::SPAN_SIZE,
+           size_t(count) * RtArena::SPAN_SIZE);
+      return first;
+    }
+
+    /** Lock fresh spans into RAM, or at least fault them in */
+    void lock (char* begin, size_t bytes)
+    {
+      if (mlock(begin, bytes) == 0) {
+        m_locked += bytes;
+        return;
+      }
+      if (!m_warned) {
+        qWarning() << "Unable to lock RT memory:" << strerror(errno)
+                   << "- raise the memlock limit to avoid page faults while processing";
+        m_warned = true;
+      }
+      memset(begin, 0, bytes);
+    }
+
+    mutable QMutex m_mutex;
+    char* const m_base;           ///< Start of the reserved range
+    const size_t m_size;          ///< Length of the reserved range
+    const bool m_hugePages;       ///< Backed by huge pages
+    const int m_spanCount;        ///< Spans in the reserved range
+    int m_top;                    ///< Spans handed out at least once
+    QVector<Span> m_spans;        ///< What each span is used for
+    void* m_free[CLASS_COUNT];    ///< Free blocks of each class, linked through them
+    QMap<int, QList<int> > m_freeRuns; ///< First spans of free runs, by run length
+    size_t m_locked;
+    size_t m_inUse;
+    size_t m_peak;
+    int m_fallbacks;
+    bool m_warned;                ///< Complained about mlock already
+};
+
+  } // Internal
+
+
+static Internal::Arena* s_arena = NULL;
+
+
+bool RtArena::initialize (size_t size, bool hugePages)
+{
+  Q_ASSERT(s_arena == NULL);
+  const size_t granularity = hugePages ? size_t(Internal::HUGE_PAGE_SIZE)
+                                       : size_t(SPAN_SIZE);
+  size = (size + granularity - 1) / granularity * granularity;
+
+  void* base = MAP_FAILED;
+  bool huge = false;
+#ifdef MAP_HUGETLB
+  if (hugePages) {
+    base = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    huge = (base != MAP_FAILED);
+    if (!huge) {
+      qWarning() << "No huge pages reserved for RT memory, using normal pages";
+    }
+  }
+#endif
+  if (base == MAP_FAILED) {
+    base = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) {
+      qWarning() << "Unable to reserve" << qulonglong(size) << "bytes of RT memory";
+      return false;
+    }
+#ifdef MADV_HUGEPAGE
+    if (hugePages) {
+      // Transparent huge pages, if the kernel is willing
+      madvise(base, size, MADV_HUGEPAGE);
+    }
+#endif
+  }
+
+  s_arena = new Internal::Arena(static_cast<char*>(base), size, huge);
+  return true;
+}
+
+
+void* RtArena::allocate (size_t size)
+{
+  void* p = s_arena ? s_arena->allocate(size) : NULL;
+  if (!p && posix_memalign(&p, CACHE_LINE_SIZE, size ? size : 1) != 0) {
+    qFatal("Unable to allocate %lu bytes", (unsigned long)size);
+  }
+  return p;
+}
+
+
+void RtArena::free (void* p)
+{
+  if (s_arena && s_arena->contains(p)) {
+    s_arena->free(p);
+  }
+  else {
+    ::free(p);
+  }
+}
+
+
+bool RtArena::contains (const void* p)
+{
+  return s_arena && s_arena->contains(p);
+}
+
+
+RtArena::Usage RtArena::usage ()
+{
+  if (s_arena) {
+    return s_arena->usage();
+  }
+  Usage u = { 0, 0, 0, 0, 0, 0, false };
+  return u;
+}
+
+
+QDebug operator<< (QDebug dbg, const RtArena::Usage& usage)
+{
+  dbg.nospace() << "RT memory: " << qulonglong(usage.inUse / 1024) << " KiB in use, "
+                << qulonglong(usage.peak / 1024) << " KiB peak, "
+                << qulonglong(usage.locked / 1024) << " of "
+                << qulonglong(usage.committed / 1024) << " KiB committed locked, "
+                << qulonglong(usage.reserved / 1024) << " KiB reserved"
+                << (usage.hugePages ? " in huge pages, " : ", ")
+                << usage.fallbacks << " heap fallbacks";
+  return dbg.space();
+}
+
+} // Unison
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
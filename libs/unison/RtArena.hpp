@@ -0,0 +1,102 @@
+/*
+ * RtArena.hpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef UNISON_RT_ARENA_HPP_
+#define UNISON_RT_ARENA_HPP_
+
+#include <QtCore/QtGlobal>
+#include <stddef.h>
+
+class QDebug;
+
+namespace Unison {
+
+/**
+ * Process-wide memory for everything the processing thread touches: audio and control
+ * buffers, Schedules and the queues between the processing thread and the rest of the
+ * program.  The arena is a single reserved range of address space, optionally backed
+ * by huge pages, that is locked into RAM as it is handed out.  The processing thread
+ * then never takes a page fault on it, and fewer TLB entries cover the working set.
+ *
+ * Memory is carved into spans.  Small requests are served from spans dedicated to a
+ * size class, and recycled per class.  Requests bigger than half a span get a run of
+ * whole spans.  Everything is aligned to CACHE_LINE_SIZE.  Until initialize() is called,
+ * and once the arena is exhausted, requests fall back to the general heap.
+ *
+ * Allocating and freeing take a lock, so neither is RT-safe.  Memory from the arena is
+ * never returned to the system. */
+class RtArena
+{
+  public:
+    enum {
+      SPAN_SIZE = 64 * 1024,           ///< Granularity the arena is handed out in
+      DEFAULT_SIZE = 64 * 1024 * 1024  ///< Address space reserved by default, in bytes
+    };
+
+    /**
+     * How much of the arena is in use */
+    struct Usage
+    {
+      size_t reserved;  ///< Address space reserved for the arena
+      size_t committed; ///< Spans handed out to size classes and big requests
+      size_t locked;    ///< Part of committed that is locked into RAM
+      size_t inUse;     ///< Bytes currently allocated, rounded up to their size class
+      size_t peak;      ///< Highest inUse so far
+      int fallbacks;    ///< Requests served from the general heap, arena exhausted
+      bool hugePages;   ///< Whether the arena is backed by huge pages
+    };
+
+    /**
+     * Reserve the arena.  Must be called once, before anything is allocated from it and
+     * before other threads may allocate.  Failing to lock memory only produces a
+     * warning, the arena is used anyway.
+     * @param size address space to reserve, in bytes
+     * @param hugePages try to back the arena with huge pages first
+     * @returns @c true if the arena could be reserved */
+    static bool initialize (size_t size = DEFAULT_SIZE, bool hugePages = false);
+
+    /**
+     * @returns at least @p size bytes, aligned to CACHE_LINE_SIZE.  Not RT-safe. */
+    static void* allocate (size_t size);
+
+    /**
+     * Give back memory from allocate(), NULL is ignored.  Not RT-safe. */
+    static void free (void* p);
+
+    /**
+     * @returns @c true if @p p was allocated from the arena, rather than the heap */
+    static bool contains (const void* p);
+
+    /**
+     * @returns a snapshot of the arena's usage */
+    static Usage usage ();
+};
+
+QDebug operator<< (QDebug dbg, const RtArena::Usage& usage);
+
+} // Unison
+
+#endif
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
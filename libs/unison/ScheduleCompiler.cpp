@@ -0,0 +1,372 @@
+/*
+ * ScheduleCompiler.cpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "ScheduleCompiler.hpp"
+
+#include "BackendPort.hpp"
+#include "Port.hpp"
+#include "PortMixer.hpp"
+#include "Processor.hpp"
+#include "Scheduler.hpp"
+
+#include <QHashIterator>
+
+namespace Unison {
+  namespace Internal {
+
+/**
+ * Stands in for a BackendPort in the Schedule, so a Worker moves the port's data as
+ * soon as it can be, instead of it all being moved before and after the graph. */
+class BackendPortProcessor : public Processor
+{
+  public:
+    BackendPortProcessor (BackendPort* port) :
+      m_port(port),
+      m_feedsUnison(port->direction() == Output)
+    {}
+
+    QString name () const
+    {
+      return m_port->name();
+    }
+
+    int portCount () const
+    {
+      return 1;
+    }
+
+    Port* port (int idx) const
+    {
+      Q_ASSERT(idx == 0);
+      Q_UNUSED(idx);
+      return m_port;
+    }
+
+    Port* port (const QString& name) const
+    {
+      return (name == m_port->name()) ? m_port : NULL;
+    }
+
+    void activate (BufferProvider&)
+    {}
+
+    void deactivate ()
+    {}
+
+    /**
+     * Never skipped, a playback port must fill the backend's buffer every period, even
+     * with silence.  A capture port has no inputs to go quiet. */
+    nframes_t tailLength () const
+    {
+      return UNKNOWN_TAIL;
+    }
+
+    void process (const ProcessingContext&)
+    {
+      if (m_feedsUnison) {
+        m_port->preProcess();
+      }
+      else {
+        m_port->postProcess();
+      }
+    }
+
+  private:
+    BackendPort* m_port;
+    bool m_feedsUnison;   ///< Cached, direction() is virtual
+};
+
+
+ScheduleCompiler::ScheduleCompiler ()
+{}
+
+
+ScheduleCompiler::~ScheduleCompiler ()
+{
+  foreach (Vertex* v, m_order) {
+    if (v->ownsProcessor) {
+      delete v->processor;
+    }
+  }
+  qDeleteAll(m_order);
+  qDeleteAll(m_orphans);
+}
+
+
+void ScheduleCompiler::add (Processor* processor)
+{
+  Q_ASSERT(processor != NULL);
+  if (m_vertices.contains(processor)) {
+    return;
+  }
+
+  Vertex* v = addVertex(processor, false);
+  m_vertices.insert(processor, v);
+
+  // Pick up connections that were made before we knew about the processor
+  for (int pc = 0; pc < processor->portCount(); ++pc) {
+    linkConnections(v, processor->port(pc));
+  }
+}
+
+
+void ScheduleCompiler::remove (Processor* processor)
+{
+  Vertex* v = m_vertices.take(processor);
+  if (v) {
+    for (int pc = 0; pc < processor->portCount(); ++pc) {
+      removeVertex(m_mixers.take(processor->port(pc)));
+    }
+    removeVertex(v);
+  }
+}
+
+
+void ScheduleCompiler::add (BackendPort* port)
+{
+  Q_ASSERT(port != NULL);
+  if (m_vertices.contains(port)) {
+    return;
+  }
+
+  Vertex* v = addVertex(new BackendPortProcessor(port), true);
+  m_vertices.insert(port, v);
+  linkConnections(v, port);
+}
+
+
+void ScheduleCompiler::remove (BackendPort* port)
+{
+  Vertex* v = m_vertices.take(port);
+  if (v) {
+    removeVertex(m_mixers.take(port));
+    removeVertex(v);
+  }
+  m_orphans.append(port);
+}
+
+
+ScheduleCompiler::Vertex* ScheduleCompiler::addVertex (Processor* processor, bool owned)
+{
+  Vertex* v = new Vertex();
+  v->processor = processor;
+  v->ownsProcessor = owned;
+  v->mixedPort = NULL;
+  v->index = -1;
+  m_order.append(v);
+  return v;
+}
+
+
+void ScheduleCompiler::removeVertex (Vertex* v)
+{
+  if (!v) {
+    return;
+  }
+
+  foreach (Vertex* d, v->dependents.keys()) {
+    d->dependencies.remove(v);
+  }
+  foreach (Vertex* d, v->dependencies.keys()) {
+    d->dependents.remove(v);
+  }
+  m_order.removeOne(v);
+  if (v->ownsProcessor) {
+    // The running Schedule may still have a WorkUnit for it
+    m_orphans.append(v->processor);
+  }
+  delete v;
+}
+
+
+void ScheduleCompiler::linkConnections (Vertex* v, Port* port)
+{
+  for (QSet<Port* const>::const_iterator pi = port->connectionsBegin();
+       pi != port->connectionsEnd(); ++pi) {
+    Vertex* other = vertexOf(*pi);
+    if (!other || other == v) {
+      continue;
+    }
+    if (port->direction() == Output) {
+      link(v, other);
+    }
+    else {
+      link(other, v);
+    }
+  }
+  if (port->direction() == Input) {
+    updateMixer(port);
+  }
+}
+
+
+void ScheduleCompiler::updateMixer (Port* port)
+{
+  Vertex* owner = ownerOf(port);
+  Vertex* mixer = m_mixers.value(port, NULL);
+  const bool mixed = owner && PortMixer::isMixed(port);
+  if (mixed == (mixer != NULL)) {
+    return;
+  }
+
+  // Move the edges of the connections from the port's own vertex to a new mixer, or
+  // back from the mixer we no longer need
+  Vertex* from = mixer ? mixer : owner;
+  Vertex* to = mixer ? owner : addVertex(NULL, false);
+  for (QSet<Port* const>::const_iterator pi = port->connectionsBegin();
+       pi != port->connectionsEnd(); ++pi) {
+    Vertex* producer = vertexOf(*pi);
+    if (producer && producer != owner) {
+      unlink(producer, from);
+      link(producer, to);
+    }
+  }
+  if (mixer) {
+    removeVertex(m_mixers.take(port));
+  }
+  else {
+    to->mixedPort = port;
+    m_mixers.insert(port, to);
+    link(to, owner);
+  }
+}
+
+
+void ScheduleCompiler::connect (const Port* producer, Port* consumer)
+{
+  Vertex* from = vertexOf(producer);
+  Vertex* to = vertexOf(consumer);
+  if (from && to) {
+    Q_ASSERT(from != to); // TODO: Report cycles, don't just abort
+    link(from, to);
+  }
+  updateMixer(consumer);
+}
+
+
+void ScheduleCompiler::disconnect (const Port* producer, Port* consumer)
+{
+  Vertex* from = vertexOf(producer);
+  Vertex* to = vertexOf(consumer);
+  if (from && to) {
+    unlink(from, to);
+  }
+  updateMixer(consumer);
+}
+
+
+ScheduleCompiler::Vertex* ScheduleCompiler::vertexOf (const Port* port) const
+{
+  Vertex* v = m_mixers.value(port, NULL);
+  return v ? v : ownerOf(port);
+}
+
+
+ScheduleCompiler::Vertex* ScheduleCompiler::ownerOf (const Port* port) const
+{
+  // Backend ports are vertices themselves, everything else belongs to its processor
+  Vertex* v = m_vertices.value(port, NULL);
+  return v ? v : m_vertices.value(port->parent(), NULL);
+}
+
+
+int ScheduleCompiler::indexOf (const Port* port) const
+{
+  const Vertex* v = vertexOf(port);
+  return v ? v->index : -1;
+}
+
+
+void ScheduleCompiler::link (Vertex* from, Vertex* to)
+{
+  from->dependents[to]++;
+  to->dependencies[from]++;
+}
+
+
+void ScheduleCompiler::unlink (Vertex* from, Vertex* to)
+{
+  Q_ASSERT(from->dependents.contains(to));
+  if (--from->dependents[to] == 0) {
+    from->dependents.remove(to);
+    to->dependencies.remove(from);
+  }
+  else {
+    to->dependencies[from]--;
+  }
+}
+
+
+void ScheduleCompiler::compile (Schedule& output)
+{
+  output.orphans = m_orphans.toVector();
+  m_orphans.clear();
+
+  const int count = m_order.count();
+  int edgeCount = 0;
+  int readyCount = 0;
+  for (int i=0; i<count; ++i) {
+    const Vertex* v = m_order.at(i);
+    v->index = i;
+    edgeCount += v->dependents.count();
+    if (v->dependencies.isEmpty()) {
+      ++readyCount;
+    }
+  }
+  output.allocate(count, edgeCount, readyCount);
+
+  WorkUnit** edge = output.edges;
+  WorkUnit** ready = output.readyWork;
+  for (int i=0; i<count; ++i) {
+    const Vertex* v = m_order.at(i);
+    WorkUnit& w = output.work[i];
+    if (v->mixedPort) {
+      // Each schedule mixes the connections the port had when it was compiled
+      PortMixer* mixer = new PortMixer(v->mixedPort);
+      output.mixers.append(mixer);
+      w.processor = mixer;
+    }
+    else {
+      w.processor = v->processor;
+    }
+    w.initialWait = v->dependencies.count();
+    w.dependents = edge;
+    w.dependentCount = v->dependents.count();
+    for (QHashIterator<Vertex*, int> di(v->dependents); di.hasNext(); ) {
+      di.next();
+      *edge++ = &output.work[di.key()->index];
+    }
+    if (w.initialWait == 0) {
+      *ready++ = &w;
+    }
+  }
+  Q_ASSERT(edge == output.edges + output.edgeCount);
+
+  output.resetWaits();
+}
+
+  } // Internal
+} // Unison
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
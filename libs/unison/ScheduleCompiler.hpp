@@ -0,0 +1,156 @@
+/*
+ * ScheduleCompiler.hpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#ifndef UNISON_SCHEDULE_COMPILER_HPP_
+#define UNISON_SCHEDULE_COMPILER_HPP_
+
+#include <QHash>
+#include <QList>
+
+namespace Unison {
+
+  class BackendPort;
+  class Node;
+  class Port;
+  class Processor;
+
+  namespace Internal {
+
+    class Schedule;
+
+/**
+ * Keeps the dependency graph of a Patch's children up to date as processors are added
+ * and removed and ports are (dis)connected.  Every edit only touches the processors
+ * involved, so building a Schedule never has to rediscover the graph by walking every
+ * port of every processor.  compile() is linear in the size of the graph.
+ *
+ * Edges are between processors, but are counted per port connection, so disconnecting
+ * one channel of a stereo pair keeps the dependency alive.  Backend ports that have been
+ * added get a vertex of their own, so moving their data to and from the Backend is
+ * scheduled like any other work.  Other ports whose parent is not one of our
+ * processors are ignored.
+ *
+ * An audio input with more than one connection gets a vertex of its own too.  Its
+ * producers feed it, and it feeds the port's processor.  Every compiled Schedule runs a
+ * PortMixer of its own there, so a schedule the processing thread is still using never
+ * sees the connections change.  Not RT-safe. */
+class ScheduleCompiler
+{
+  Q_DISABLE_COPY(ScheduleCompiler)
+
+  public:
+    ScheduleCompiler ();
+    ~ScheduleCompiler ();
+
+    /**
+     * Add @p processor to the graph, along with any connections its ports already have
+     * to processors in the graph.
+     * @param processor the processor to add */
+    void add (Processor* processor);
+
+    /**
+     * Remove @p processor and all of its edges from the graph
+     * @param processor the processor to remove */
+    void remove (Processor* processor);
+
+    /**
+     * Add @p port to the graph.  Its WorkUnit calls BackendPort::preProcess or
+     * BackendPort::postProcess, depending on the direction of the port.
+     * @param port the backend port to add */
+    void add (BackendPort* port);
+
+    /**
+     * Remove @p port and all of its edges from the graph, and take it over.  The
+     * Schedule running now may still move its data, so the port is handed to the next
+     * Schedule compiled and deleted along with it, see Schedule::orphans.
+     * @param port the backend port to remove */
+    void remove (BackendPort* port);
+
+    /**
+     * Record a new port connection
+     * @param producer the output port
+     * @param consumer the input port */
+    void connect (const Port* producer, Port* consumer);
+
+    /**
+     * Forget a port connection
+     * @param producer the output port
+     * @param consumer the input port */
+    void disconnect (const Port* producer, Port* consumer);
+
+    /**
+     * @returns the number of vertices in the graph, processors and backend ports */
+    int processorCount () const
+    {
+      return m_order.count();
+    }
+
+    /**
+     * Build the WorkUnits for the graph.  The units are in the order the vertices
+     * were added, those without dependencies make up the readyWork.  Costs and
+     * priorities are left for the caller.  @p output takes over whatever was removed
+     * from the graph since the last compile, so it must replace the Schedule compiled
+     * before it.
+     * @param output the Schedule to fill */
+    void compile (Schedule& output);
+
+    /**
+     * @returns the index of the WorkUnit that reads or writes @p port in the Schedule
+     *          last compiled, or -1 if the port isn't part of the graph.  The data of
+     *          an input with a PortMixer is read by the mixer. */
+    int indexOf (const Port* port) const;
+
+  private:
+    struct Vertex
+    {
+      Processor* processor;             ///< NULL for a mixer
+      bool ownsProcessor;               ///< Processor stands in for a backend port
+      Port* mixedPort;                  ///< The input a mixer vertex mixes
+      QHash<Vertex*, int> dependents;   ///< Vertices we feed, by port connection count
+      QHash<Vertex*, int> dependencies; ///< Vertices feeding us, likewise
+      mutable int index;                ///< Position in the compiled work
+    };
+
+    Vertex* vertexOf (const Port* port) const;
+    Vertex* ownerOf (const Port* port) const;
+    Vertex* addVertex (Processor* processor, bool owned);
+    void removeVertex (Vertex* v);
+    void linkConnections (Vertex* v, Port* port);
+    void updateMixer (Port* port);
+    static void link (Vertex* from, Vertex* to);
+    static void unlink (Vertex* from, Vertex* to);
+
+    QHash<const Node*, Vertex*> m_vertices; ///< Vertex of each processor or port
+    QHash<const Port*, Vertex*> m_mixers;   ///< Vertex mixing each mixed input
+    QList<Vertex*> m_order;                 ///< Vertices in the order they were added
+    QList<Node*> m_orphans;                 ///< Removed, for the next compiled Schedule
+};
+
+  } // Internal
+} // Unison
+
+#endif
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
@@ -24,23 +24,33 @@
 
 #include "Scheduler.hpp"
 
+#include "AudioBuffer.hpp"
+#include "Dsp.hpp"
+#include "Port.hpp"
+#include "PortMixer.hpp"
+#include "RtArena.hpp"
+
 #include <QAtomicInt>
 #include <QSemaphore>
+#include <QtAlgorithms>
+#include <QVector>
 
-#include <stdlib.h> // for rand
+#include <new>
 
 namespace Unison {
   namespace Internal {
 
 
-WorkQueue::WorkQueue () :
+SpinLockWorkQueue::SpinLockWorkQueue () :
   m_head(NULL),
-  m_tail(NULL)
+  m_tail(NULL),
+  m_lock()
 {}
 
 
-void WorkQueue::push (WorkUnit* u)
+void SpinLockWorkQueue::push (WorkUnit* u)
 {
+  m_lock.lock();
   u->prev = NULL;
   u->next = m_head;
   if (m_head) {
@@ -51,12 +61,15 @@ void WorkQueue::push (WorkUnit* u)
   }
 
   m_head = u;
+  m_lock.unlock();
 }
 
 
-WorkUnit* WorkQueue::pop ()
+WorkUnit* SpinLockWorkQueue::pop ()
 {
+  m_lock.lock();
   if (!m_head) {
+    m_lock.unlock();
     return NULL;
   }
   WorkUnit* r = m_head;
@@ -67,13 +80,18 @@ WorkUnit* WorkQueue::pop ()
   else {
     m_tail = NULL;
   }
+  m_lock.unlock();
   return r;
 }
 
 
-WorkUnit* WorkQueue::steal ()
+WorkUnit* SpinLockWorkQueue::steal ()
 {
+  if (!m_lock.tryLock()) {
+    return NULL;
+  }
   if (!m_tail) {
+    m_lock.unlock();
     return NULL;
   }
   WorkUnit* r = m_tail;
@@ -84,11 +102,12 @@ WorkUnit* WorkQueue::steal ()
   else {
     m_head = NULL;
   }
+  m_lock.unlock();
   return r;
 }
 
 
-void WorkQueue::initializeFrom (const WorkQueue& other)
+void SpinLockWorkQueue::initializeFrom (const SpinLockWorkQueue& other)
 {
   // Init end pointers
   m_head = other.m_head;
@@ -106,14 +125,338 @@ void WorkQueue::initializeFrom (const WorkQueue& other)
 }
 
 
-Worker::Worker (WorkerGroup& group) :
-  m_group(group),
-  m_readyList(),
-  m_lock(),
-  m_random()
+StealingWorkQueue::StealingWorkQueue (int capacity) :
+  m_top(0),
+  m_bottom(0),
+  m_units(NULL),
+  m_mask(0),
+  m_overflow(NULL)
+{
+  Q_ASSERT(capacity > 0);
+  int size = 1;
+  while (size < capacity) {
+    size <<= 1;
+  }
+  m_units = static_cast<WorkUnit**>(RtArena::allocate(sizeof(WorkUnit*) * size));
+  m_mask = size - 1;
+}
+
+
+StealingWorkQueue::~StealingWorkQueue ()
+{
+  RtArena::free(const_cast<WorkUnit**>(m_units));
+}
+
+
+void StealingWorkQueue::push (WorkUnit* unit)
+{
+  const int b = m_bottom;
+  const int t = m_top;
+
+  if (distance(t, b) > m_mask) {
+    // Full.  Keep it to ourself rather than allocate in the processing thread
+    unit->next = m_overflow;
+    m_overflow = unit;
+    return;
+  }
+
+  m_units[b & m_mask] = unit;
+  // The unit must be visible before thieves can see the new bottom
+  m_bottom.fetchAndStoreRelease(following(b));
+}
+
+
+WorkUnit* StealingWorkQueue::pop ()
+{
+  if (m_overflow) {
+    WorkUnit* unit = m_overflow;
+    m_overflow = unit->next;
+    return unit;
+  }
+
+  // Claim the bottom slot.  This must be a full barrier, reading top before the
+  // store is visible would let a thief take the same unit.
+  const int b = (int)((unsigned)(int)m_bottom - 1u);
+  m_bottom.fetchAndStoreOrdered(b);
+  const int t = m_top;
+
+  const int size = distance(t, b);
+  if (size < 0) {
+    // Was already empty, put bottom back
+    m_bottom = following(b);
+    return NULL;
+  }
+
+  WorkUnit* unit = m_units[b & m_mask];
+  if (size == 0) {
+    // The last unit, thieves may be after it too.  Whoever advances top gets it
+    if (!m_top.testAndSetOrdered(t, following(t))) {
+      unit = NULL;
+    }
+    m_bottom = following(b);
+  }
+  return unit;
+}
+
+
+WorkUnit* StealingWorkQueue::steal ()
+{
+  const int t = m_top;
+  // Top must be read before bottom, see pop()
+  __sync_synchronize();
+  const int b = m_bottom;
+
+  if (distance(t, b) <= 0) {
+    return NULL;
+  }
+
+  WorkUnit* unit = m_units[t & m_mask];
+  if (!m_top.testAndSetOrdered(t, following(t))) {
+    // Lost to the owner or another thief
+    return NULL;
+  }
+  return unit;
+}
+
+
+
+Schedule::Schedule () :
+  readyWork(NULL),
+  readyWorkCount(0),
+  work(NULL),
+  workCount(0),
+  edges(NULL),
+  edgeCount(0),
+  bufferLength(0),
+  m_arena(NULL)
+{}
+
+
+Schedule::~Schedule ()
+{
+  for (int i=0; i<workCount; ++i) {
+    work[i].~WorkUnit();
+  }
+  RtArena::free(m_arena);
+  qDeleteAll(mixers);
+  qDeleteAll(orphans);
+}
+
+
+void Schedule::allocate (int count, int edgeCount_, int readyCount)
+{
+  Q_ASSERT(m_arena == NULL);
+  Q_ASSERT(count >= 0 && edgeCount_ >= 0 && readyCount >= 0);
+
+  // Units are already a multiple of the line size, so the edges start on a fresh line
+  const size_t unitBytes = sizeof(WorkUnit) * count;
+  const size_t edgeBytes = sizeof(WorkUnit*) * (edgeCount_ + readyCount);
+  m_arena = RtArena::allocate(unitBytes + edgeBytes);
+
+  work = static_cast<WorkUnit*>(m_arena);
+  workCount = count;
+  edges = reinterpret_cast<WorkUnit**>(static_cast<char*>(m_arena) + unitBytes);
+  edgeCount = edgeCount_;
+  readyWork = edges + edgeCount_;
+  readyWorkCount = readyCount;
+
+  for (int i=0; i<count; ++i) {
+    WorkUnit* u = new (&work[i]) WorkUnit();
+    u->processor = NULL;
+    u->initialWait = 0;
+    u->dependentCount = 0;
+    u->dependents = edges;
+    u->cost = 0;
+    u->priority = 0;
+    u->initialNext = u->next = u->prev = NULL;
+    u->silence = NULL;
+  }
+}
+
+
+void Schedule::resetWaits ()
 {
-  // Assume stdlib RNG has been seeded
-  m_random.seed(rand() % RAND_MAX);
+  for (int i=0; i<workCount; ++i) {
+    work[i].wait = work[i].initialWait;
+  }
+}
+
+
+void Schedule::assignBuffers ()
+{
+  for (int i=0; i<bufferAssignments.count(); ++i) {
+    const BufferAssignment& a = bufferAssignments.at(i);
+    a.port->useBuffer(buffers.at(a.buffer).data());
+  }
+}
+
+
+void Schedule::trackMixers ()
+{
+  for (int m=0; m<mixers.count(); ++m) {
+    PortMixer* mixer = mixers.at(m);
+    const QVector<Port*>& ports = mixer->sources();
+    QVector<AudioBuffer*> sources;
+    sources.reserve(ports.count());
+    for (int i=0; i<ports.count(); ++i) {
+      const SharedBufferPtr source = ports.at(i)->buffer();
+      sources.append(static_cast<AudioBuffer*>(source.data()));
+      mixerBuffers.append(source);
+    }
+    const SharedBufferPtr target = mixer->mixedPort()->buffer();
+    mixerBuffers.append(target);
+    mixer->setBuffers(static_cast<AudioBuffer*>(target.data()), sources);
+  }
+}
+
+
+void Schedule::trackSilence ()
+{
+  // Collect the ranges by index first, the arrays may still move
+  QVector<int> firstInput;
+  QVector<int> firstOutput;
+  QVector<WorkUnit*> units;
+  for (int w=0; w<workCount; ++w) {
+    Processor* p = work[w].processor;
+    QList<SharedBufferPtr> inputs;
+    QList<SharedBufferPtr> outputs;
+    bool complete = true;
+    for (int i=0; i<p->portCount(); ++i) {
+      Port* port = p->port(i);
+      if (port->type() != AudioPort) {
+        continue;
+      }
+      const SharedBufferPtr buffer = port->buffer();
+      if (!buffer) {
+        complete = false;
+      }
+      else if (port->direction() == Input) {
+        inputs.append(buffer);
+      }
+      else {
+        outputs.append(buffer);
+      }
+    }
+    if (inputs.isEmpty() && outputs.isEmpty()) {
+      continue;
+    }
+
+    UnitSilence us;
+    us.inputCount = inputs.count();
+    us.outputCount = outputs.count();
+    us.tail = (complete && !inputs.isEmpty()) ? p->tailLength() : Processor::UNKNOWN_TAIL;
+    us.silentFrames = 0;
+    silence.append(us);
+    units.append(&work[w]);
+    firstInput.append(silenceBuffers.count());
+    silenceBuffers += inputs.toVector();
+    firstOutput.append(silenceBuffers.count());
+    silenceBuffers += outputs.toVector();
+  }
+
+  for (int i=0; i<silence.count(); ++i) {
+    silence[i].inputs = silenceBuffers.constData() + firstInput.at(i);
+    silence[i].outputs = silenceBuffers.constData() + firstOutput.at(i);
+    units.at(i)->silence = &silence[i];
+  }
+}
+
+
+bool UnitSilence::bypass (nframes_t frames)
+{
+  if (tail == Processor::UNKNOWN_TAIL) {
+    return false;
+  }
+  for (int i=0; i<inputCount; ++i) {
+    if (!static_cast<AudioBuffer*>(inputs[i].data())->isSilent()) {
+      silentFrames = 0;
+      return false;
+    }
+  }
+  if (silentFrames < tail) {
+    // Still ringing
+    silentFrames += qMin(frames, tail - silentFrames);
+    return false;
+  }
+
+  for (int i=0; i<outputCount; ++i) {
+    AudioBuffer* out = static_cast<AudioBuffer*>(outputs[i].data());
+    if (!out->isKnownSilent()) {
+      Dsp::zero(static_cast<sample_t*>(out->data()), out->length());
+      out->setSilent();
+    }
+  }
+  return true;
+}
+
+
+void UnitSilence::written ()
+{
+  for (int i=0; i<outputCount; ++i) {
+    static_cast<AudioBuffer*>(outputs[i].data())->markWritten();
+  }
+}
+
+
+static bool lessCritical (const WorkUnit* a, const WorkUnit* b)
+{
+  return a->priority < b->priority;
+}
+
+
+static void sortDependents (WorkUnit& unit)
+{
+  qSort(unit.dependents, unit.dependents + unit.dependentCount, lessCritical);
+}
+
+
+/** @returns the highest priority of @p unit's dependents */
+static int longestDependent (const WorkUnit& unit)
+{
+  int longest = 0;
+  for (int d=0; d<unit.dependentCount; ++d) {
+    longest = qMax(longest, unit.dependents[d]->priority);
+  }
+  return longest;
+}
+
+
+void Schedule::prioritize ()
+{
+  // Count dependencies
+  QVector<int> pending(workCount, 0);
+  for (int i=0; i<workCount; ++i) {
+    for (int d=0; d<work[i].dependentCount; ++d) {
+      ++pending[work[i].dependents[d] - work];
+    }
+  }
+
+  // Topological order
+  QVector<WorkUnit*> order;
+  order.reserve(workCount);
+  for (int i=0; i<workCount; ++i) {
+    if (pending[i] == 0) {
+      order.append(&work[i]);
+    }
+  }
+  for (int i=0; i<order.count(); ++i) {
+    const WorkUnit* u = order[i];
+    for (int d=0; d<u->dependentCount; ++d) {
+      if (--pending[u->dependents[d] - work] == 0) {
+        order.append(u->dependents[d]);
+      }
+    }
+  }
+  Q_ASSERT(order.count() == workCount); // Otherwise there is a cycle
+
+  // Walk it backwards, so all dependents are known before the unit itself
+  for (int i=order.count()-1; i>=0; --i) {
+    WorkUnit* u = order[i];
+    u->priority = u->cost + longestDependent(*u);
+    sortDependents(*u);
+  }
+
+  qSort(readyWork, readyWork + readyWorkCount, lessCritical);
 }
 
 
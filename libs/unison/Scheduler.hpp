@@ -25,13 +25,18 @@
 #ifndef UNISON_SCHEDULER_HPP_
 #define UNISON_SCHEDULER_HPP_
 
+#include "BufferProvider.hpp"
+#include "EventCount.hpp"
 #include "FastRandom.hpp"
+#include "ProcessingContext.hpp"
 #include "Processor.hpp"
+#include "Profiler.hpp"
 #include "SpinLock.hpp"
 
 #include <QAtomicInt>
-#include <QSemaphore>
+#include <QList>
 #include <QThread> // for debugging
+#include <QVector>
 #include <stdio.h>
 
 #include <stdlib.h> // for rand
@@ -39,13 +44,45 @@
 //#define NO_PROCESS
 
 namespace Unison {
+
+  class Node;
+  class Port;
+
   namespace Internal {
 
+    class PortMixer;
+    class Schedule;
+
 // Notes:
 //  Pointers are generally bad. Unless you're in DSP RT tight-loop land.
 //  We are using 'ordered' operation on QAtomics, we may be able to loosen this
 
-class Worker;
+/**
+ * The audio buffers a WorkUnit reads and writes, so it can be skipped while its inputs
+ * are silent.  Built by Schedule::trackSilence() for every unit with audio ports.  The
+ * outputs are marked written whenever the processor runs, so silence found by a reader
+ * never outlives the data.  Only the Worker running the unit touches silentFrames. */
+struct UnitSilence
+{
+  const SharedBufferPtr* inputs;  ///< Audio inputs, the unit's range of the Schedule's
+  const SharedBufferPtr* outputs; ///< Audio outputs, likewise
+  int inputCount;
+  int outputCount;
+  nframes_t tail;         ///< Processor::tailLength(), UNKNOWN_TAIL if never skipped
+  nframes_t silentFrames; ///< How long all the inputs have been silent
+
+  /**
+   * Decide whether to skip the processor this period.  If so, silence the outputs.
+   * RT-safe.
+   * @param frames the length of the period
+   * @returns @c true if the processor must not run */
+  bool bypass (nframes_t frames);
+
+  /**
+   * Forget what was known about the outputs, after the processor has run.  RT-safe. */
+  void written ();
+};
+
 
 /**
  * This represents an individual unit of work.  A WorkUnit can be summed up as a
@@ -53,39 +90,54 @@ class Worker;
  * also store the current state of the work unit (wait count).  Work units are only
  * used by a single Backend, so there is no harm in keeping a single state.  Finally,
  * the WorkUnit participates in an intrusive doubly-linked list (There is one list per
- * Worker). The WorkUnit only exists in a single list, so this restriction is fine. */
+ * Worker). The WorkUnit only exists in a single list, so this restriction is fine.
+ *
+ * Every WorkUnit starts on its own cache line, so Workers decrementing the waits of
+ * neighbouring units don't invalidate each other's lines.  The silence pointer spills
+ * onto a second line, it is only read by the Worker running the unit.
+ *
+ * The wait count resets itself: once it reaches zero, no other dependency can touch it
+ * until the next period, so the Worker that readied the unit stores initialWait back
+ * right away.  Units without dependencies are never decremented at all.  This way a
+ * period can start running processors immediately, without a reset pass. */
 struct WorkUnit
 {
   // Work unit definition 
   Processor* processor;   ///< The processor to run
   int initialWait;        ///< Initial count of unresolved dependencies
-  WorkUnit** dependents;  ///< Decrement these waits when we are done processing
+  int dependentCount;     ///< Length of the dependents range
+  WorkUnit** dependents;  ///< Our range of Schedule::edges, by ascending priority
+  int cost;               ///< Estimated cost of running processor, in nanoseconds
+  int priority;           ///< Cost of the longest path from here to the end of the period
 
   // State
-  QAtomicInt wait;        ///< Initialized to number of dependencies each run
+  QAtomicInt wait;        ///< Unresolved dependencies, rearmed when the unit is readied
 
   // Intrusive Doubly-linked list
   WorkUnit* initialNext;  ///< Used to rebuild the schedule (next and prev) each run
-  WorkUnit* next;         ///< Next pointer for whichever dequeue we live in
+  WorkUnit* next;         ///< Next pointer for whichever dequeue (or overflow) we live in
   WorkUnit* prev;         ///< Next pointer for whichever dequeue we live in
-};
+
+  UnitSilence* silence;   ///< Our audio buffers, NULL if we have none
+} UNISON_CACHE_ALIGNED;
 
 
 /**
- * A WorkQueue is held by a worker and maintains a list of ready-work.  The queue
+ * A SpinLockWorkQueue is held by a worker and maintains a list of ready-work.  The queue
  * is intrusive to avoid allocating nodes for the container.  The front of the queue
  * is used by the owning worker and the rear is used by thieves.  This helps maintain
  * reasonable locality on the owning-side, while leaving units that are likely to have
- * more dependents for theives.  The implementation could be replaced with a more
- * complicated lock-free structure in the future, but this seems fine for now. 
+ * more dependents for theives.  Every operation takes a SpinLock, thieves only try to
+ * take it.  This was the original WorkQueue and is kept as a fallback for the
+ * lock-free StealingWorkQueue, select it with USE_SPINLOCK_WORKQUEUE.
  *
  * TODO: rewrite using a sentinel node for extra efficiency. */
-class WorkQueue
+class SpinLockWorkQueue
 {
-  Q_DISABLE_COPY(WorkQueue)
+  Q_DISABLE_COPY(SpinLockWorkQueue)
 
   public:
-    WorkQueue ();
+    SpinLockWorkQueue ();
 
     /** 
      * Used by the worker to enqueue work that has just been made ready
@@ -98,14 +150,15 @@ class WorkQueue
     WorkUnit* pop ();
 
     /**
-     * Used by thieves to steal work when their queue is empty
-     * @return the "first-in" WorkUnit */
+     * Used by thieves to steal work when their queue is empty.  Gives up
+     * immediately if the owner holds the lock.
+     * @return the "first-in" WorkUnit, or NULL if empty or contended */
     WorkUnit* steal ();
 
     /**
      * Check if there is anything worth stealing
      * @return true if work exists */
-    inline bool isNotEmpty ()
+    inline bool isNotEmpty () const
     {
       return m_tail;
     }
@@ -115,33 +168,233 @@ class WorkQueue
      * ctor for this, but WorkQueue doesn't support copy per-se.  What we want is to
      * restore the state of a queue multiple times 
      * @param other the head of the linked list walked through initialNext pointer */
-    void initializeFrom (const WorkQueue& other);
+    void initializeFrom (const SpinLockWorkQueue& other);
 
   private:
     WorkUnit* m_head;   ///< The head - used by the owner Worker
     WorkUnit* m_tail;   ///< The tail - used by theives
+    SpinLock  m_lock;   ///< Guards both ends of the list
+};
+
+
+
+/**
+ * A lock-free work-stealing deque, after Chase and Lev's "Dynamic Circular Work-Stealing
+ * Deque".  The owning Worker pushes and pops at the bottom without any atomic
+ * read-modify-write, except when racing a thief for the very last unit.  Thieves take
+ * from the top with a single CAS, and simply fail if they lose a race.
+ *
+ * The circular array is allocated up front and never grows, since growing would mean
+ * allocating in the processing thread.  Instead, units pushed onto a full queue are
+ * kept on an owner-private overflow stack threaded through WorkUnit::next.  These can
+ * not be stolen, but nothing is ever lost.  Indices are free-running and compared by
+ * distance, so they may wrap safely. */
+class StealingWorkQueue
+{
+  Q_DISABLE_COPY(StealingWorkQueue)
+
+  public:
+    enum {
+      DEFAULT_CAPACITY = 1024 ///< Default size of the circular array
+    };
+
+    /**
+     * @param capacity how many units fit before overflowing, rounded up to a power
+     *        of two.  Not RT-safe. */
+    StealingWorkQueue (int capacity = DEFAULT_CAPACITY);
+    ~StealingWorkQueue ();
+
+    /** 
+     * Used by the worker to enqueue work that has just been made ready
+     * @param unit work that has just met its dependencies. */
+    void push (WorkUnit* unit);
+
+    /**
+     * Used by the worker to get work when the current execution path has ended
+     * @return the "last-in" WorkUnit */
+    WorkUnit* pop ();
+
+    /**
+     * Used by thieves to steal work when their queue is empty
+     * @return the "first-in" WorkUnit, or NULL if empty or another thread won */
+    WorkUnit* steal ();
+
+    /**
+     * Check if there is anything worth stealing
+     * @return true if work exists */
+    inline bool isNotEmpty () const
+    {
+      return distance(m_top, m_bottom) > 0;
+    }
+
+  private:
+    /** @returns @p to - @p from, correct even if the indices have wrapped */
+    static inline int distance (int from, int to)
+    {
+      return (int)((unsigned)to - (unsigned)from);
+    }
+
+    /** @returns the index after @p i, wrapping without overflow */
+    static inline int following (int i)
+    {
+      return (int)((unsigned)i + 1u);
+    }
+
+    QAtomicInt m_top;           ///< Next unit to steal, only ever advanced by CAS
+    QAtomicInt m_bottom;        ///< Next free slot, only written by the owner
+    WorkUnit* volatile* m_units;///< The circular array
+    int m_mask;                 ///< Capacity - 1
+    WorkUnit* m_overflow;       ///< Owner-private stack of units that did not fit
 };
 
 
+#ifdef UNISON_SPINLOCK_WORKQUEUE
+typedef SpinLockWorkQueue WorkQueue;
+#else
+/**
+ * The WorkQueue used by Worker.  Both implementations provide the same
+ * push/pop/steal/isNotEmpty interface. */
+typedef StealingWorkQueue WorkQueue;
+#endif
+
+
+template <typename Queue> class BasicWorker;
+
 
 /**
- * A happy family of workers.  Used for synchronization */
-struct WorkerGroup
+ * A happy family of workers.  Used for synchronization.
+ *
+ * The processing thread starts a period with startPeriod() and waits for it with
+ * awaitFinished().  Threads running a Worker wait for periods with awaitPeriod(), see
+ * BasicWorker::runNextPeriod().  A period is over once every unit has run and every
+ * Worker has returned from BasicWorker::run(), so nobody can still be touching the
+ * schedule or the queues when the next one starts.
+ *
+ * Anybody waiting first spins for a while, then parks on an EventCount.  The spin
+ * budgets trade CPU time for wake-up latency and can be tuned per group. */
+template <typename Queue>
+struct BasicWorkerGroup
 {
   public: // Temporary full-public
-    
-  Worker** workers; ///< The workers in this group
-  int workerCount;  ///< The size of this group
+
+  enum {
+    DEFAULT_IDLE_SPIN = 2000,   ///< Default idleSpin
+    DEFAULT_STEAL_SPIN = 500    ///< Default stealSpin
+  };
+
+  BasicWorkerGroup () :
+    workers(NULL),
+    workerCount(0),
+    idleSpin(DEFAULT_IDLE_SPIN),
+    stealSpin(DEFAULT_STEAL_SPIN),
+    context(NULL),
+    period(0),
+    pending(0),
+    active(0)
+  {}
+
+  BasicWorker<Queue>** workers; ///< The workers in this group
+  int workerCount;              ///< The size of this group
+
+  /**
+   * How many times to poll for the start, or the end, of a period before parking.
+   * Zero parks straight away. */
+  int idleSpin;
+
+  /**
+   * How many times a starving Worker tries to steal before parking until more work
+   * shows up. */
+  int stealSpin;
+
+  const ProcessingContext* context; ///< The context of the current period
 
   /**
-   * Used by workers to determine when to quit.  Incremented when a thread gains
-   * food supply, decremented when resorting to stealing. */
-  QAtomicInt liveWorkers;
+   * Number of periods started so far.  Workers poll it between periods. */
+  QAtomicInt period;
+
+  char padPending[CACHE_LINE_SIZE]; ///< Keeps pending off the lines of the above
+
+  /**
+   * Units that have not run yet this period.  Decremented by every Worker as it goes,
+   * so it gets a line of its own. */
+  QAtomicInt pending;
+
+  char padActive[CACHE_LINE_SIZE];  ///< Keeps the line of pending to itself
+
+  /**
+   * Workers that have not finished the period yet */
+  QAtomicInt active;
+
+  EventCount started;   ///< Workers parked between periods
+  EventCount starving;  ///< Workers parked within a period, waiting for work
+  EventCount finished;  ///< The processing thread, waiting for the period to end
+
+  /**
+   * Deal @p units out to the workers, round robin.  Only call this while all the
+   * workers are blocked.
+   * @param units the units to ready, by ascending priority
+   * @param count size of units array */
+  inline void pushReadyWorkUnsafe (WorkUnit* const* units, int count)
+  {
+    for (int i=0; i<count; ++i) {
+      workers[i % workerCount]->pushReadyWorkUnsafe(&units[i], 1);
+    }
+  }
+
+  /**
+   * Start a period and wake all the parked Workers, in a single system call.  The
+   * previous period must have finished.  RT-safe.
+   * @param ctx the context to run in, must outlive the period
+   * @param ready the units to start with, by ascending priority
+   * @param readyCount size of the ready array
+   * @param unitCount the number of units that will run this period */
+  inline void startPeriod (const ProcessingContext& ctx,
+                           WorkUnit* const* ready, int readyCount, int unitCount)
+  {
+    context = &ctx;
+    pending = unitCount;
+    active = workerCount;
+    pushReadyWorkUnsafe(ready, readyCount);
+    period.fetchAndAddOrdered(1);
+    started.notifyAll();
+  }
 
   /**
-   * Waitcondition for main processing thread. Signaled by the first thread to
-   * realize that all workers are starved. */
-  QSemaphore done;
+   * Wait for the period following @p seen to start.  RT-safe
+   * @param seen the last period we have run
+   * @returns the period that has started */
+  inline int awaitPeriod (int seen)
+  {
+    for (int spin=0; spin<idleSpin && period == seen; ++spin) {
+      EventCount::pause();
+    }
+    while (period == seen) {
+      const int key = started.prepareWait();
+      if (period != seen) {
+        started.cancelWait();
+        break;
+      }
+      started.wait(key);
+    }
+    return period;
+  }
+
+  /**
+   * Wait for every Worker to finish the current period.  RT-safe */
+  inline void awaitFinished ()
+  {
+    for (int spin=0; spin<idleSpin && active != 0; ++spin) {
+      EventCount::pause();
+    }
+    while (active != 0) {
+      const int key = finished.prepareWait();
+      if (active == 0) {
+        finished.cancelWait();
+        break;
+      }
+      finished.wait(key);
+    }
+  }
 };
 
 
@@ -150,14 +403,25 @@ struct WorkerGroup
  * Workers process a schedule.  Many workers can work in parallel if they are
  * in a WorkerGroup.  There is no requirement how the workers are run exactly,
  * For example, one Worker could be executed in the main processing thread, while
- * additional Workers are run in a QThread. */
-class Worker 
+ * additional Workers are run in a QThread.  Workers are parametrized on the queue
+ * implementation so both can be compared side by side, clients should just use the
+ * Worker and WorkerGroup typedefs. */
+template <typename Queue>
+class BasicWorker 
 {
   public:
     /**
      * Create a Worker.
      * @param group The WorkerGroup the worker belongs to. */
-    Worker (WorkerGroup& group);
+    BasicWorker (BasicWorkerGroup<Queue>& group) :
+      m_group(group),
+      m_readyList(),
+      m_random(),
+      m_profile(NULL)
+    {
+      // Assume stdlib RNG has been seeded
+      m_random.seed(rand() % RAND_MAX);
+    }
     
     /**
      * Runs a single processing iteration.  This could be multiple WorkUnits,
@@ -168,83 +432,113 @@ class Worker
     bool runOnce (const ProcessingContext& ctx)
     {
       // Look at us
-      lock();
       WorkUnit* unit = m_readyList.pop();
-      unlock();
 
       // Stealing
       if (!unit) {
         if (m_group.workerCount==1) {
           return false;
         }
-        
-        unit = stealRandomly();
+        unit = m_victims.isEmpty() ? stealRandomly() : stealNearest();
         if (!unit) {
-          if (!m_stealing) {
-            m_stealing=true;
-            // TODO: this could probably be a single counting Semaphore.
-            if (m_group.liveWorkers.fetchAndAddOrdered(-1) == 1) {
-              m_group.done.release(1);
-              return false;
-            }
-          }
-          // Otherwise, hope we have more luck next time
-          QThread::yieldCurrentThread();
-          return true; // We aren't necessarily done yet
-        }
-        else if (m_stealing) {
-          m_group.liveWorkers.fetchAndAddOrdered(1);
-          m_stealing = false;
+          return false;
         }
       }
 
+      int ran = 0;
+
       // Loop over the immediate execution path (depth first)
       while (unit) {
 
-        // Processing
+        // Processing, unless the inputs have gone silent
         Processor* p = unit->processor;
+        UnitSilence* silence = unit->silence;
 #ifndef NO_PROCESS
-        p->process(ctx);
+        if (!silence || !silence->bypass(ctx.bufferSize())) {
+          if (m_profile) {
+            const int64_t start = Profiler::now();
+            p->process(ctx);
+            const ProfileSample sample = { p, int32_t(Profiler::now() - start) };
+            m_profile->write(&sample, 1);
+          }
+          else {
+            p->process(ctx);
+          }
+          if (silence) {
+            silence->written();
+          }
+        }
 #endif
+        ++ran;
 
         // Readying dependents
-        lock(); // TODO: Move lock to immediately before the loop below?
         WorkUnit** dp = unit->dependents;
+        WorkUnit** const end = dp + unit->dependentCount;
         WorkUnit*  u;
         
         // Reuse unit for finding our next unit
         unit = NULL;
 
-        // Loop until the first ready one, stash that one for ourself
-        for (; *dp; ++dp) {
+        // Dependents are sorted by ascending priority, so the last one to become
+        // ready is on the critical path: stash that one for ourself.  The others are
+        // queued in ascending order too, so pop() prefers the most critical of those.
+        for (; dp != end; ++dp) {
           u = *dp;
           if (u->wait.fetchAndAddOrdered(-1) == 1) {
+            u->wait = u->initialWait; // Rearm for the next period
+            if (unit) {
+              m_readyList.push(unit);
+              m_group.starving.notifyAll();
+            }
             unit = u;
-            ++dp;
-            break; // now continue with the "queueing" loop
           }
         }
-        
-        // Queue the rest
-        for (; *dp; ++dp) {
-          u = *dp;
-          if (u->wait.fetchAndAddOrdered(-1) == 1) {
-            m_readyList.push(u);
-          }
-        }
-        unlock();
       }
 
+      if (m_group.pending.fetchAndAddOrdered(-ran) == ran) {
+        // That was the last of the period, let the starving quit
+        m_group.starving.notifyAll();
+      }
       return true;
     }
 
     /**
-     * Run the Worker while there is work.
+     * Run the Worker until every unit of the period has run.  A Worker that runs out
+     * of work keeps trying to steal for the group's stealSpin, then parks until another
+     * Worker queues more work or the period ends.
      * @param ctx The ProcessingContext to run in */
     inline void run (const ProcessingContext& ctx)
     {
-      m_stealing = false;
-      while (runOnce(ctx) && m_group.liveWorkers != 0) {}
+      int idle = 0;
+      while (m_group.pending != 0) {
+        if (runOnce(ctx)) {
+          idle = 0;
+        }
+        else if (++idle < m_group.stealSpin) {
+          EventCount::pause();
+        }
+        else {
+          park();
+          idle = 0;
+        }
+      }
+
+      if (m_group.active.fetchAndAddOrdered(-1) == 1) {
+        m_group.finished.notifyAll();
+      }
+    }
+
+    /**
+     * Wait for the next period of the group, then run it.  Meant to be called in a
+     * loop by a thread dedicated to this Worker.
+     * @param seen the value returned by the previous call, or the group's period
+     *        before the first period was started
+     * @returns the period that was run */
+    inline int runNextPeriod (int seen)
+    {
+      const int period = m_group.awaitPeriod(seen);
+      run(*m_group.context);
+      return period;
     }
 
     /**
@@ -253,39 +547,80 @@ class Worker
      * @return The stolen WorkUnit if success, otherwise NULL. */
     inline WorkUnit* trySteal ()
     {
-      WorkUnit* u = NULL;
-      if (tryLock()) {
-        u = m_readyList.steal();
-        unlock();
-      }
-      return u;
+      return m_readyList.steal();
     }
 
     /**
-     * Pushes the null-terminated list onto the queue. No locking occurs since this
+     * Pushes the list onto the queue. No locking occurs since this
      * function would run while any other workers are blocked
      * @param units Array of units to ready
-     * @oaram count size of units array */
-    inline void pushReadyWorkUnsafe (WorkUnit* units, int count)
+     * @param count size of units array */
+    inline void pushReadyWorkUnsafe (WorkUnit* const* units, int count)
     {
       for (int i=0; i<count; ++i) {
-        m_readyList.push(&units[i]);
+        m_readyList.push(units[i]);
+      }
+    }
+
+    /**
+     * Time every Processor we run and record it in @p slot.  Only call this while the
+     * Worker is not running.
+     * @param slot where to write the samples, or NULL to stop profiling */
+    inline void setProfile (ProfileSlot* slot)
+    {
+      m_profile = slot;
+    }
+
+    /**
+     * Tell the Worker who to steal from first.  Victims that are equally far away form
+     * a tier, tiers are tried nearest first and in random order within a tier.  Without
+     * victims, another Worker is picked at random.  Only call this while the Worker is
+     * not running.
+     * @param victims the other Workers of the group, nearest first
+     * @param distances how far away each victim is, in ascending order */
+    void setVictims (const QList<BasicWorker*>& victims, const QList<int>& distances)
+    {
+      Q_ASSERT(victims.count() == distances.count());
+      m_victims = victims.toVector();
+      m_tiers.clear();
+      for (int i=1; i<=distances.count(); ++i) {
+        if (i == distances.count() || distances.at(i) != distances.at(i-1)) {
+          m_tiers.append(i);
+        }
       }
     }
 
   private:
 
-    bool canStealFrom (Worker* victim) const
+    bool canStealFrom (BasicWorker* victim) const
     {
       return victim->m_readyList.isNotEmpty();
     }
 
 
+    /**
+     * Sleep until there is something to steal, or the period is over */
+    void park ()
+    {
+      const int key = m_group.starving.prepareWait();
+      bool wake = (m_group.pending == 0);
+      for (int i=0; !wake && i<m_group.workerCount; ++i) {
+        wake = canStealFrom(m_group.workers[i]);
+      }
+      if (wake) {
+        m_group.starving.cancelWait();
+      }
+      else {
+        m_group.starving.wait(key);
+      }
+    }
+
+
     WorkUnit* stealRandomly ()
     {
       // TODO: if num-threads is set to 2, no need to randomly pick
       unsigned n = m_random.nextInt() % m_group.workerCount;
-      Worker* victim = m_group.workers[n];
+      BasicWorker* victim = m_group.workers[n];
       // Can't steal from self.  TODO: Avoid this instead of working around it
       if (victim == this) {
         n = (n+1) % m_group.workerCount;
@@ -293,7 +628,7 @@ class Worker
       //printf("Going to steal from workers[%d]!\n", n);
       victim = m_group.workers[n];
 
-      // Now check if there is any point in stealing (avoid locking)
+      // Now check if there is any point in stealing (avoid the CAS)
       if (!canStealFrom(victim)) {
         return NULL;
       }
@@ -301,42 +636,73 @@ class Worker
       return victim->trySteal();
     }
 
-    inline void lock ()
-    {
-      m_lock.lock();
-    }
-
-    inline bool tryLock ()
-    {
-      return m_lock.tryLock();
-    }
 
-    inline void unlock ()
+    WorkUnit* stealNearest ()
     {
-      m_lock.unlock();
+      int begin = 0;
+      for (int t=0; t<m_tiers.count(); ++t) {
+        const int end = m_tiers.at(t);
+        const int size = end - begin;
+        const int first = m_random.nextInt() % size;
+        for (int i=0; i<size; ++i) {
+          BasicWorker* victim = m_victims.at(begin + (first + i) % size);
+          if (canStealFrom(victim)) {
+            WorkUnit* unit = victim->trySteal();
+            if (unit) {
+              return unit;
+            }
+          }
+        }
+        begin = end;
+      }
+      return NULL;
     }
 
-  protected:
-
   private:
-    WorkerGroup& m_group;   ///< The WorkerGroup 
-    WorkQueue m_readyList;  ///< List of WorkUnits that that have satisfied dependencies
-    SpinLock  m_lock;       ///< Lock for the readyList
+    BasicWorkerGroup<Queue>& m_group; ///< The WorkerGroup 
+    Queue      m_readyList; ///< List of WorkUnits that that have satisfied dependencies
     FastRandom m_random;    ///< RNG used for picking victim Workers
-    bool       m_stealing;  ///< Are we stealing?
+    ProfileSlot* m_profile; ///< Where to record process times, if profiling
+    QVector<BasicWorker*> m_victims; ///< Who to steal from, nearest first
+    QVector<int> m_tiers;   ///< End of each group of equally near victims
 };
 
 
+typedef BasicWorkerGroup<WorkQueue> WorkerGroup;
+typedef BasicWorker<WorkQueue> Worker;
+
+
 
 /**
  * A schedule is prepared by non-RT land and then passed over to the backend in this
- * handy class. */
+ * handy class.  Everything lives in a single cache-aligned arena: the readyWork units,
+ * followed by the work units, the edges and finally the initial waits.  Each unit's
+ * dependents are a range of the shared edge array, so following them during a period
+ * walks memory that is mostly contiguous. */
 class Schedule
 {
+  Q_DISABLE_COPY(Schedule)
+
   public:
+  Schedule ();
+
+  /**
+   * Frees the arena, the mixers and the orphans.  Must not be called while a Worker may
+   * still be running the schedule, see Epoch. */
+  ~Schedule ();
+
   /**
-   * Work without any data dependencies, used to begin the processing */
-  WorkUnit* readyWork;
+   * Allocate the arena and point the members into it.  The units are constructed
+   * empty, with no dependents.  May only be called once.  Not RT-safe.
+   * @param count number of work units
+   * @param edgeCount total number of dependents over all units
+   * @param readyCount number of units without dependencies */
+  void allocate (int count, int edgeCount, int readyCount);
+
+  /**
+   * Work without any data dependencies, used to begin the processing.  Points into
+   * the arena just past the edges. */
+  WorkUnit** readyWork;
   int readyWorkCount;
 
   /**
@@ -344,6 +710,87 @@ class Schedule
    * Client should use a smart pointer around Schedule itself.  */
   WorkUnit* work;
   int workCount;
+
+  /**
+   * The dependents of every unit, ranges are handed out in unit order */
+  WorkUnit** edges;
+  int edgeCount;
+
+  /**
+   * Arm every wait count for the first period.  After that the units rearm themselves,
+   * see WorkUnit.  Called by the compiler once the initial waits are known. */
+  void resetWaits ();
+
+  /**
+   * Compute the priority of every WorkUnit from the costs, and sort all dependents by
+   * ascending priority.  A unit's priority is the cost of the longest (critical) path
+   * from it to the end of the period, so Workers can start long chains first and keep
+   * them from stretching the period.  The readyWork is sorted the same way.  Called by
+   * the compiler once the units, their costs and dependents are filled in.  Not
+   * RT-safe. */
+  void prioritize ();
+
+  /**
+   * A port and the index of the buffer in @c buffers it uses while we are published */
+  struct BufferAssignment
+  {
+    Port* port;
+    int buffer;
+  };
+
+  /**
+   * The buffers shared by the ports of the schedule.  Ports whose lifetimes never
+   * overlap in any order the Workers may run the units in share the same buffer, see
+   * BufferPlanner. */
+  QVector<SharedBufferPtr> buffers;
+  QVector<BufferAssignment> bufferAssignments;
+
+  /**
+   * The buffers the assigned ports had when we were compiled.  The schedule we replace
+   * may use them until we are published, holding them makes sure they are released
+   * when we are retired instead. */
+  QVector<SharedBufferPtr> previousBuffers;
+
+  /**
+   * The length of the buffers the planner gave the ports, or 0 if nothing was planned.
+   * Until the buffer length has been passed on to the Patch the ports keep buffers of
+   * the old length, so a backend must not run a longer period than this. */
+  nframes_t bufferLength;
+
+  /**
+   * The mixers run by our units, deleted with us, see ScheduleCompiler */
+  QVector<PortMixer*> mixers;
+
+  /**
+   * Processors and ports removed from the graph before we were compiled.  The Schedule
+   * we replace may still run them, so they are deleted with us, see ScheduleCompiler */
+  QVector<Node*> orphans;
+
+  /**
+   * Hand every mixer the buffers of its port and their connections, so mixing never
+   * touches the ports.  Called by the compiler once the buffers are planned.  Not
+   * RT-safe. */
+  void trackMixers ();
+
+  QVector<SharedBufferPtr> mixerBuffers;  ///< Keeps what the mixers were handed alive
+
+  /**
+   * Find the audio buffers of every unit, so units can be skipped while their inputs
+   * are silent.  Called by the compiler once the buffers are planned, the units point
+   * into the arrays below.  Not RT-safe. */
+  void trackSilence ();
+
+  QVector<UnitSilence> silence;
+  QVector<SharedBufferPtr> silenceBuffers;  ///< The ranges of UnitSilence
+
+  /**
+   * Hand every assigned port its shared buffer, see Port::useBuffer().  The ports'
+   * buffer() was already set by the BufferPlanner.  Called from the processing thread
+   * when the schedule is published, before it is run.  RT-safe. */
+  void assignBuffers ();
+
+  private:
+  void* m_arena;  ///< Backs all of the arrays above
 };
 
 
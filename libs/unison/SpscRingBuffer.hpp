@@ -0,0 +1,271 @@
+/*
+ * SpscRingBuffer.hpp
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef UNISON_SPSC_RING_BUFFER_HPP_
+#define UNISON_SPSC_RING_BUFFER_HPP_
+
+#include "RtArena.hpp"
+#include "types.hpp"
+
+#include <QtCore/QtGlobal>
+
+#include <string.h>
+
+namespace Unison {
+
+/**
+ * A faster cousin of RingBuffer, for one reader thread and one writer thread that move
+ * a lot of data.  The capacity is a power of two, so positions wrap with a mask instead
+ * of a division.  The positions are free running, so the whole buffer is usable and a
+ * full buffer is told apart from an empty one by the difference of the positions.
+ *
+ * The read and the write position each sit on their own cache line, next to the side's
+ * cached copy of the other position.  A side only re-reads the other position when its
+ * cached copy shows too little data or room, so in steady state the reader and writer
+ * rarely pull each other's cache line over.  Positions are published with release
+ * stores and read with acquire loads, so on x86 neither side ever issues a fence.
+ *
+ * Besides copying read() and write(), getReadVector() and getWriteVector() hand out the
+ * buffer itself, in the manner of jack_ringbuffer_get_read_vector(), for callers that
+ * want to process or fill the data in place. */
+template <typename T>
+class SpscRingBuffer
+{
+  Q_DISABLE_COPY(SpscRingBuffer)
+
+  public:
+    /**
+     * A contiguous run of elements inside the buffer. */
+    struct Vector
+    {
+      T* data;    ///< First element of the run
+      int count;  ///< Elements in the run, may be 0
+    };
+
+    /**
+     * Construct a ringbuffer.  The buffer is allocated from the RtArena.  Not RT-safe
+     * @param size  the least number of elements to hold, rounded up to a power of two */
+    SpscRingBuffer (int size) :
+      m_mask(1)
+    {
+      while (int(m_mask) < size) {
+        m_mask <<= 1;
+      }
+      m_data = static_cast<T*>(RtArena::allocate(m_mask * sizeof(T)));
+      m_mask -= 1;
+      reset();
+    }
+
+    ~SpscRingBuffer ()
+    {
+      RtArena::free(m_data);
+    }
+
+    /**
+     * Reset the read and write positions, making an empty buffer.  This is not thread
+     * safe. */
+    void reset ()
+    {
+      m_write = m_readCache = 0;
+      m_read = m_writeCache = 0;
+    }
+
+    /**
+     * @returns the size of the buffer, in elements */
+    int capacity () const
+    {
+      return int(m_mask) + 1;
+    }
+
+    /**
+     * @returns the number of elements available for reading.  Exact only from the
+     *          reader thread, or while nobody writes */
+    int readSpace () const
+    {
+      return int(m_write - m_read);
+    }
+
+    /**
+     * @returns the number of elements available for writing.  Exact only from the
+     *          writer thread, or while nobody reads */
+    int writeSpace () const
+    {
+      return capacity() - int(m_write - m_read);
+    }
+
+    /**
+     * Get the readable data without copying it, as up to two runs: the second one is
+     * only used where the data wraps to the front of the buffer.  The read position is
+     * not moved, call readAdvance() once done with the data.  Reader only.  RT-safe
+     * @param vec     receives the two runs
+     * @param atLeast only look at the write position if fewer elements than this are
+     *                already known to be readable, so a reader draining in bulk does not
+     *                touch the writer's cache line every time
+     * @returns the total number of elements in @p vec */
+    int getReadVector (Vector vec[2], int atLeast = 1) const
+    {
+      const unsigned r = m_read;
+      const int readable = available(r, atLeast);
+      split(r, readable, vec);
+      return readable;
+    }
+
+    /**
+     * Move the read position past @p cnt elements, handing their space back to the
+     * writer.  Reader only.  RT-safe */
+    void readAdvance (int cnt)
+    {
+      Q_ASSERT(cnt >= 0 && cnt <= int(m_writeCache - m_read));
+      // Finish with the data before the writer may reuse it
+      storeRelease(m_read, m_read + cnt);
+    }
+
+    /**
+     * Get the free space without copying into it, as up to two runs like
+     * getReadVector().  Call writeAdvance() to publish what was filled in.  Writer
+     * only.  RT-safe
+     * @param vec     receives the two runs
+     * @param atLeast only look at the read position if less room than this is already
+     *                known to be free
+     * @returns the total number of elements in @p vec */
+    int getWriteVector (Vector vec[2], int atLeast = 1)
+    {
+      const unsigned w = m_write;
+      const int writable = room(w, atLeast);
+      split(w, writable, vec);
+      return writable;
+    }
+
+    /**
+     * Publish @p cnt elements written into the space from getWriteVector().  Writer
+     * only.  RT-safe */
+    void writeAdvance (int cnt)
+    {
+      Q_ASSERT(cnt >= 0 && cnt <= capacity() - int(m_write - m_readCache));
+      // The data must be visible before the reader may see it
+      storeRelease(m_write, m_write + cnt);
+    }
+
+    /**
+     * Copy up to @p cnt elements out of the buffer.  Reader only.  RT-safe
+     * @returns the number of elements read, which may range from 0 to cnt */
+    int read (T* dest, int cnt)
+    {
+      cnt = peek(dest, cnt);
+      readAdvance(cnt);
+      return cnt;
+    }
+
+    /**
+     * Copy up to @p cnt elements out of the buffer without moving the read position.
+     * Reader only.  RT-safe
+     * @returns the number of elements copied, which may range from 0 to cnt */
+    int peek (T* dest, int cnt) const
+    {
+      Vector vec[2];
+      cnt = qMin(cnt, getReadVector(vec, cnt));
+      const int first = qMin(cnt, vec[0].count);
+      memcpy(dest, vec[0].data, first * sizeof(T));
+      if (cnt > first) {
+        memcpy(dest + first, vec[1].data, (cnt - first) * sizeof(T));
+      }
+      return cnt;
+    }
+
+    /**
+     * Copy up to @p cnt elements into the buffer.  Writer only.  RT-safe
+     * @returns the number of elements written, which may range from 0 to cnt */
+    int write (const T* src, int cnt)
+    {
+      Vector vec[2];
+      cnt = qMin(cnt, getWriteVector(vec, cnt));
+      const int first = qMin(cnt, vec[0].count);
+      memcpy(vec[0].data, src, first * sizeof(T));
+      if (cnt > first) {
+        memcpy(vec[1].data, src + first, (cnt - first) * sizeof(T));
+      }
+      writeAdvance(cnt);
+      return cnt;
+    }
+
+  private:
+    int available (unsigned r, int atLeast) const
+    {
+      if (int(m_writeCache - r) < atLeast) {
+        // Read the data only after seeing it was published
+        m_writeCache = loadAcquire(m_write);
+      }
+      return int(m_writeCache - r);
+    }
+
+    int room (unsigned w, int atLeast)
+    {
+      if (capacity() - int(w - m_readCache) < atLeast) {
+        // Overwrite the data only after seeing it was read
+        m_readCache = loadAcquire(m_read);
+      }
+      return capacity() - int(w - m_readCache);
+    }
+
+    /**
+     * Publish a position.  Everything written before is visible to the other side once
+     * it sees the new value.  A plain store on x86, no fence */
+    static void storeRelease (volatile unsigned& position, unsigned value)
+    {
+      __atomic_store_n(&position, value, __ATOMIC_RELEASE);
+    }
+
+    /**
+     * Read the other side's position, and whatever it published with it */
+    static unsigned loadAcquire (const volatile unsigned& position)
+    {
+      return __atomic_load_n(&position, __ATOMIC_ACQUIRE);
+    }
+
+    void split (unsigned pos, int cnt, Vector vec[2]) const
+    {
+      const unsigned index = pos & m_mask;
+      const int tail = capacity() - int(index);
+      vec[0].data = &m_data[index];
+      vec[0].count = qMin(cnt, tail);
+      vec[1].data = m_data;
+      vec[1].count = cnt - vec[0].count;
+    }
+
+    T* m_data;                            ///< The buffer contents
+    unsigned m_mask;                      ///< Capacity minus one
+    char padWrite[CACHE_LINE_SIZE];       ///< Keeps reader and writer apart
+    volatile unsigned m_write;            ///< Next position to write
+    unsigned m_readCache;                 ///< Writer's last look at m_read
+    char padRead[CACHE_LINE_SIZE];
+    volatile unsigned m_read;             ///< Next position to read
+    mutable unsigned m_writeCache;        ///< Reader's last look at m_write
+    char padEnd[CACHE_LINE_SIZE];
+};
+
+} // Unison
+
+#endif
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
@@ -0,0 +1,219 @@
+/*
+ * BenchRingBuffer.cpp
+ *
+ * Measures how fast RingBuffer and SpscRingBuffer move data between two threads
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <unison/Profiler.hpp>
+#include <unison/RingBuffer.hpp>
+#include <unison/SpscRingBuffer.hpp>
+
+#include <QThread>
+#include <QVector>
+
+#include <iostream>
+#include <stdlib.h>
+
+using namespace Unison;
+
+typedef SpscRingBuffer<int> Spsc;
+
+
+/**
+ * Moves data with RingBuffer's copying read() and write() */
+struct CopyRing
+{
+  typedef RingBuffer<int> Buffer;
+
+  static int write (Buffer& rb, int next, int cnt, QVector<int>& scratch)
+  {
+    for (int i=0; i<cnt; ++i) {
+      scratch[i] = next + i;
+    }
+    return rb.write(scratch.data(), cnt);
+  }
+
+  static int read (Buffer& rb, int cnt, QVector<int>& scratch, int& expect)
+  {
+    const int got = rb.read(scratch.data(), cnt);
+    return check(scratch.data(), got, expect);
+  }
+
+  static int check (const int* data, int cnt, int& expect)
+  {
+    for (int i=0; i<cnt; ++i) {
+      if (data[i] != expect++) {
+        return -1;
+      }
+    }
+    return cnt;
+  }
+};
+
+
+/**
+ * Moves data with SpscRingBuffer's copying read() and write() */
+struct CopySpsc
+{
+  typedef Spsc Buffer;
+
+  static int write (Buffer& rb, int next, int cnt, QVector<int>& scratch)
+  {
+    for (int i=0; i<cnt; ++i) {
+      scratch[i] = next + i;
+    }
+    return rb.write(scratch.data(), cnt);
+  }
+
+  static int read (Buffer& rb, int cnt, QVector<int>& scratch, int& expect)
+  {
+    const int got = rb.read(scratch.data(), cnt);
+    return CopyRing::check(scratch.data(), got, expect);
+  }
+};
+
+
+/**
+ * Fills and drains SpscRingBuffer in place, through its vectors */
+struct VectorSpsc
+{
+  typedef Spsc Buffer;
+
+  static int write (Buffer& rb, int next, int cnt, QVector<int>&)
+  {
+    Spsc::Vector vec[2];
+    cnt = qMin(cnt, rb.getWriteVector(vec, cnt));
+    for (int i=0; i<cnt; ++i) {
+      (i < vec[0].count ? vec[0].data[i] : vec[1].data[i - vec[0].count]) = next + i;
+    }
+    rb.writeAdvance(cnt);
+    return cnt;
+  }
+
+  static int read (Buffer& rb, int cnt, QVector<int>&, int& expect)
+  {
+    Spsc::Vector vec[2];
+    cnt = qMin(cnt, rb.getReadVector(vec, cnt));
+    const int first = qMin(cnt, vec[0].count);
+    if (CopyRing::check(vec[0].data, first, expect) < 0 ||
+        CopyRing::check(vec[1].data, cnt - first, expect) < 0) {
+      return -1;
+    }
+    rb.readAdvance(cnt);
+    return cnt;
+  }
+};
+
+
+/**
+ * Writes the numbers 0 to total-1 into the buffer, @p block at a time */
+template <typename Mode>
+class Producer : public QThread
+{
+  public:
+    Producer (typename Mode::Buffer& rb, int total, int block) :
+      m_rb(rb),
+      m_total(total),
+      m_scratch(block)
+    {}
+
+  protected:
+    void run ()
+    {
+      int next = 0;
+      while (next < m_total) {
+        const int cnt = qMin(m_scratch.count(), m_total - next);
+        const int put = Mode::write(m_rb, next, cnt, m_scratch);
+        if (put == 0) {
+          QThread::yieldCurrentThread();
+        }
+        next += put;
+      }
+    }
+
+  private:
+    typename Mode::Buffer& m_rb;
+    const int m_total;
+    QVector<int> m_scratch;
+};
+
+
+/**
+ * Pass @p total ints through a buffer of @p capacity, @p block at a time, checking that
+ * they come out in order.
+ * @returns millions of elements per second, or a negative value if the data was bad */
+template <typename Mode>
+double bench (int capacity, int total, int block)
+{
+  typename Mode::Buffer rb(capacity);
+  Producer<Mode> producer(rb, total, block);
+  QVector<int> scratch(block);
+  int expect = 0;
+
+  const int64_t start = Profiler::now();
+  producer.start();
+  while (expect < total) {
+    const int got = Mode::read(rb, block, scratch, expect);
+    if (got < 0) {
+      producer.wait();
+      return -1.0;
+    }
+    if (got == 0) {
+      QThread::yieldCurrentThread();
+    }
+  }
+  producer.wait();
+  const int64_t elapsed = Profiler::now() - start;
+
+  return total * 1e3 / elapsed;
+}
+
+
+int main (int argc, char* argv[])
+{
+  int capacity = (argc > 1) ? atoi(argv[1]) : 4096;
+  int total = (argc > 2) ? atoi(argv[2]) : 10000000;
+
+  RtArena::initialize();
+
+  std::cout << "capacity: " << capacity << "  elements: " << total
+            << "  (million elements per second)" << std::endl;
+  bool ok = true;
+  for (int block=1; block<=capacity/2; block*=8) {
+    const double ring = bench<CopyRing>(capacity, total, block);
+    const double spsc = bench<CopySpsc>(capacity, total, block);
+    const double vect = bench<VectorSpsc>(capacity, total, block);
+    ok = ok && ring > 0 && spsc > 0 && vect > 0;
+    std::cout << "  block " << block << ":"
+              << "  RingBuffer " << ring
+              << "  SpscRingBuffer " << spsc
+              << "  vectors " << vect << std::endl;
+  }
+
+  if (!ok) {
+    std::cout << "  data came out corrupted or out of order" << std::endl;
+  }
+  return ok ? 0 : 1;
+}
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
@@ -0,0 +1,312 @@
+/*
+ * BenchScheduler.cpp
+ *
+ * Compares the WorkQueue implementations by running synthetic graphs
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <unison/ProcessingContext.hpp>
+#include <unison/Processor.hpp>
+#include <unison/Scheduler.hpp>
+
+#include <QList>
+#include <QThread>
+#include <QVector>
+
+#include <iostream>
+#include <stdlib.h>
+#include <time.h>
+
+using namespace Unison;
+using namespace Unison::Internal;
+
+/**
+ * A Processor that just burns a configurable amount of cycles */
+class SpinProcessor : public Processor
+{
+  public:
+    SpinProcessor (int cost) :
+      m_cost(cost)
+    {}
+
+    QString name () const { return "Spin"; }
+    int portCount () const { return 0; }
+    Port* port (int) const { return NULL; }
+    Port* port (const QString&) const { return NULL; }
+    void activate (BufferProvider&) {}
+    void deactivate () {}
+
+    void process (const ProcessingContext&)
+    {
+      volatile int sink = 0;
+      for (int i=0; i<m_cost; ++i) {
+        sink += i;
+      }
+    }
+
+  private:
+    int m_cost;
+};
+
+
+/**
+ * A synthetic graph.  Nodes are added in topological order, edges always point from
+ * an earlier node to a later one. */
+class BenchGraph
+{
+  public:
+    BenchGraph (const char* name) :
+      m_name(name)
+    {}
+
+    int addNode (int cost)
+    {
+      m_costs.append(cost);
+      m_edges.append(QList<int>());
+      return m_costs.count() - 1;
+    }
+
+    void addEdge (int from, int to)
+    {
+      m_edges[from].append(to);
+    }
+
+    const char* name () const
+    {
+      return m_name;
+    }
+
+    /**
+     * Build the schedule, in the same shape Patch::compileSchedule produces */
+    Schedule* compile ()
+    {
+      const int count = m_costs.count();
+      QVector<int> waits(count, 0);
+      int edgeCount = 0;
+      for (int i=0; i<count; ++i) {
+        edgeCount += m_edges.at(i).count();
+        foreach (int to, m_edges.at(i)) {
+          waits[to]++;
+        }
+      }
+      Schedule* s = new Schedule();
+      s->allocate(count, edgeCount, waits.count(0));
+
+      WorkUnit** edge = s->edges;
+      WorkUnit** ready = s->readyWork;
+      for (int i=0; i<count; ++i) {
+        const QList<int>& out = m_edges.at(i);
+        WorkUnit& w = s->work[i];
+        w.processor = new SpinProcessor(m_costs.at(i));
+        w.initialWait = waits.at(i);
+        w.cost = m_costs.at(i);
+        w.dependents = edge;
+        w.dependentCount = out.count();
+        for (int j=0; j<out.count(); ++j) {
+          *edge++ = &s->work[out.at(j)];
+        }
+        if (w.initialWait == 0) {
+          *ready++ = &w;
+        }
+      }
+      s->resetWaits();
+      s->prioritize();
+      return s;
+    }
+
+  private:
+    const char* m_name;
+    QList<int> m_costs;
+    QList< QList<int> > m_edges;
+};
+
+
+/**
+ * Many plugins in parallel, as in a large mixer */
+BenchGraph* wideGraph ()
+{
+  BenchGraph* g = new BenchGraph("wide 512x1");
+  for (int i=0; i<512; ++i) {
+    g->addNode(500);
+  }
+  int sink = g->addNode(200);
+  for (int i=0; i<512; ++i) {
+    g->addEdge(i, sink);
+  }
+  return g;
+}
+
+
+/**
+ * FxLines of uneven length feeding a master bus */
+BenchGraph* chainGraph ()
+{
+  BenchGraph* g = new BenchGraph("fxlines 32x1..16");
+  QList<int> tails;
+  for (int line=0; line<32; ++line) {
+    const int length = 1 + (line * 7) % 16;
+    int prev = g->addNode(1000);
+    for (int i=1; i<length; ++i) {
+      int n = g->addNode(1000);
+      g->addEdge(prev, n);
+      prev = n;
+    }
+    tails.append(prev);
+  }
+  int master = g->addNode(1000);
+  for (int i=0; i<tails.count(); ++i) {
+    g->addEdge(tails.at(i), master);
+  }
+  return g;
+}
+
+
+/**
+ * Random layered DAG */
+BenchGraph* layeredGraph ()
+{
+  const int layers = 8;
+  const int width = 32;
+  BenchGraph* g = new BenchGraph("layered 8x32");
+  for (int l=0; l<layers; ++l) {
+    for (int i=0; i<width; ++i) {
+      int n = g->addNode(300 + rand() % 1000);
+      if (l > 0) {
+        int a = (l-1)*width + rand() % width;
+        int b = (l-1)*width + rand() % width;
+        g->addEdge(a, n);
+        if (b != a) {
+          g->addEdge(b, n);
+        }
+      }
+    }
+  }
+  return g;
+}
+
+
+static double now ()
+{
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+
+/**
+ * Runs one Worker per period, like JackWorkerThread. */
+template <typename Queue>
+class BenchThread : public QThread
+{
+  public:
+    BenchThread (BasicWorker<Queue>* worker, BasicWorkerGroup<Queue>& group,
+                 const volatile bool& quit) :
+      m_group(group),
+      m_worker(worker),
+      m_period(group.period),
+      m_quit(quit)
+    {}
+
+  protected:
+    void run ()
+    {
+      forever {
+        m_period = m_group.awaitPeriod(m_period);
+        if (m_quit) {
+          break;
+        }
+        m_worker->run(*m_group.context);
+      }
+    }
+
+  private:
+    BasicWorkerGroup<Queue>& m_group;
+    BasicWorker<Queue>* m_worker;
+    int m_period;
+    const volatile bool& m_quit;
+};
+
+
+/**
+ * @returns mean period duration in microseconds */
+template <typename Queue>
+double bench (Schedule* s, int workerCount, int periods)
+{
+  ProcessingContext ctx(64);
+  BasicWorkerGroup<Queue> group;
+  volatile bool quit = false;
+  group.workerCount = workerCount;
+  group.workers = new BasicWorker<Queue>*[workerCount];
+  QList<BenchThread<Queue>*> threads;
+  for (int i=0; i<workerCount; ++i) {
+    group.workers[i] = new BasicWorker<Queue>(group);
+    threads.append(new BenchThread<Queue>(group.workers[i], group, quit));
+    threads.last()->start();
+  }
+
+  double total = 0.0;
+  for (int p=0; p<periods; ++p) {
+    const double start = now();
+    group.startPeriod(ctx, s->readyWork, s->readyWorkCount, s->workCount);
+    group.awaitFinished();
+    total += now() - start;
+  }
+
+  // Wake the threads to see the flag, they won't run the period
+  quit = true;
+  group.startPeriod(ctx, NULL, 0, 0);
+  for (int i=0; i<workerCount; ++i) {
+    threads.at(i)->wait();
+    delete threads.at(i);
+    delete group.workers[i];
+  }
+  delete[] group.workers;
+  return total / periods;
+}
+
+
+int main (int argc, char* argv[])
+{
+  int workers = (argc > 1) ? atoi(argv[1]) : QThread::idealThreadCount();
+  int periods = (argc > 2) ? atoi(argv[2]) : 2000;
+  if (workers < 2) {
+    workers = 2;
+  }
+  srand(1234);
+
+  QList<BenchGraph*> graphs;
+  graphs << wideGraph() << chainGraph() << layeredGraph();
+
+  std::cout << "workers: " << workers << "  periods: " << periods << std::endl;
+  for (int i=0; i<graphs.count(); ++i) {
+    Schedule* s = graphs.at(i)->compile();
+    double locked   = bench<SpinLockWorkQueue>(s, workers, periods);
+    double stealing = bench<StealingWorkQueue>(s, workers, periods);
+    std::cout << "  " << graphs.at(i)->name() << ":"
+              << "  spinlock " << locked << "us"
+              << "  lock-free " << stealing << "us" << std::endl;
+  }
+
+  return 0;
+}
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
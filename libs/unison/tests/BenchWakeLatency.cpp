@@ -0,0 +1,243 @@
+/*
+ * BenchWakeLatency.cpp
+ *
+ * Measures how long it takes to wake the workers at the start of a period
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <unison/ProcessingContext.hpp>
+#include <unison/Profiler.hpp>
+#include <unison/Scheduler.hpp>
+
+#include <QList>
+#include <QSemaphore>
+#include <QThread>
+#include <QVector>
+
+#include <iostream>
+#include <stdlib.h>
+#include <time.h>
+
+using namespace Unison;
+using namespace Unison::Internal;
+
+
+/**
+ * Sleep for @p usec, standing in for the time JACK spends between periods */
+static void idle (int usec)
+{
+  timespec ts;
+  ts.tv_sec = usec / 1000000;
+  ts.tv_nsec = (usec % 1000000) * 1000;
+  nanosleep(&ts, NULL);
+}
+
+
+/**
+ * Mean and worst wake-up latency over all periods, in microseconds */
+struct Latency
+{
+  double mean;  ///< Mean over all workers and periods
+  double max;   ///< Worst single worker
+};
+
+
+/**
+ * Waits for periods the way JackWorkerThread does, and records when it woke up. */
+class GroupThread : public QThread
+{
+  public:
+    GroupThread (WorkerGroup& group, Worker* worker, int64_t& woke,
+                 const volatile bool& quit) :
+      m_group(group),
+      m_worker(worker),
+      m_period(group.period),
+      m_woke(woke),
+      m_quit(quit)
+    {}
+
+  protected:
+    void run ()
+    {
+      forever {
+        m_period = m_group.awaitPeriod(m_period);
+        m_woke = Profiler::now();
+        if (m_quit) {
+          break;
+        }
+        m_worker->run(*m_group.context);
+      }
+    }
+
+  private:
+    WorkerGroup& m_group;
+    Worker* m_worker;
+    int m_period;
+    int64_t& m_woke;
+    const volatile bool& m_quit;
+};
+
+
+/**
+ * The way JackWorkerThread used to wait: a semaphore per thread, released in turn. */
+class SemaphoreThread : public QThread
+{
+  public:
+    SemaphoreThread (QSemaphore& done, int64_t& woke, const volatile bool& quit) :
+      m_done(done),
+      m_woke(woke),
+      m_quit(quit)
+    {}
+
+    void kick ()
+    {
+      m_start.release();
+    }
+
+  protected:
+    void run ()
+    {
+      forever {
+        m_start.acquire();
+        if (m_quit) {
+          break;
+        }
+        m_woke = Profiler::now();
+        m_done.release();
+      }
+    }
+
+  private:
+    QSemaphore m_start;
+    QSemaphore& m_done;
+    int64_t& m_woke;
+    const volatile bool& m_quit;
+};
+
+
+static void account (Latency& l, int64_t start, const QVector<int64_t>& woke)
+{
+  for (int i=0; i<woke.count(); ++i) {
+    const double us = (woke.at(i) - start) / 1e3;
+    l.mean += us;
+    l.max = qMax(l.max, us);
+  }
+}
+
+
+Latency benchGroup (int workerCount, int idleSpin, int periods, int gap)
+{
+  ProcessingContext ctx(64);
+  WorkerGroup group;
+  volatile bool quit = false;
+  QVector<int64_t> woke(workerCount, 0);
+  group.workerCount = workerCount;
+  group.idleSpin = idleSpin;
+  group.workers = new Worker*[workerCount];
+  QList<GroupThread*> threads;
+  for (int i=0; i<workerCount; ++i) {
+    group.workers[i] = new Worker(group);
+    threads.append(new GroupThread(group, group.workers[i], woke[i], quit));
+    threads.last()->start();
+  }
+
+  Latency l = { 0.0, 0.0 };
+  for (int p=0; p<periods; ++p) {
+    idle(gap);
+    const int64_t start = Profiler::now();
+    group.startPeriod(ctx, NULL, 0, 0);
+    group.awaitFinished();
+    account(l, start, woke);
+  }
+  l.mean /= periods * workerCount;
+
+  // Wake the threads to see the flag, they won't run the period
+  quit = true;
+  group.startPeriod(ctx, NULL, 0, 0);
+  for (int i=0; i<workerCount; ++i) {
+    threads.at(i)->wait();
+    delete threads.at(i);
+    delete group.workers[i];
+  }
+  delete[] group.workers;
+  return l;
+}
+
+
+Latency benchSemaphore (int workerCount, int periods, int gap)
+{
+  QSemaphore done;
+  volatile bool quit = false;
+  QVector<int64_t> woke(workerCount, 0);
+  QList<SemaphoreThread*> threads;
+  for (int i=0; i<workerCount; ++i) {
+    threads.append(new SemaphoreThread(done, woke[i], quit));
+    threads.last()->start();
+  }
+
+  Latency l = { 0.0, 0.0 };
+  for (int p=0; p<periods; ++p) {
+    idle(gap);
+    const int64_t start = Profiler::now();
+    for (int i=0; i<workerCount; ++i) {
+      threads.at(i)->kick();
+    }
+    done.acquire(workerCount);
+    account(l, start, woke);
+  }
+  l.mean /= periods * workerCount;
+
+  quit = true;
+  for (int i=0; i<workerCount; ++i) {
+    threads.at(i)->kick();
+    threads.at(i)->wait();
+    delete threads.at(i);
+  }
+  return l;
+}
+
+
+int main (int argc, char* argv[])
+{
+  int workers = (argc > 1) ? atoi(argv[1]) : QThread::idealThreadCount();
+  int periods = (argc > 2) ? atoi(argv[2]) : 1000;
+  int gap = (argc > 3) ? atoi(argv[3]) : 1000;
+  if (workers < 1) {
+    workers = 1;
+  }
+
+  std::cout << "periods: " << periods << "  gap: " << gap << "us"
+            << "  (mean / worst wake-up, in us)" << std::endl;
+  for (int w=1; w<=workers; ++w) {
+    Latency sem  = benchSemaphore(w, periods, gap);
+    Latency park = benchGroup(w, 0, periods, gap);
+    Latency spin = benchGroup(w, WorkerGroup::DEFAULT_IDLE_SPIN, periods, gap);
+    std::cout << "  " << w << " workers:"
+              << "  semaphores " << sem.mean << " / " << sem.max
+              << "  park " << park.mean << " / " << park.max
+              << "  spin+park " << spin.mean << " / " << spin.max << std::endl;
+  }
+
+  return 0;
+}
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
@@ -0,0 +1,392 @@
+/*
+ * TestBufferPlanner.cpp
+ *
+ * Tests which audio buffers the BufferPlanner lets the ports of a Patch share
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <unison/AudioBuffer.hpp>
+#include <unison/Patch.hpp>
+#include <unison/PooledBufferProvider.hpp>
+#include <unison/Port.hpp>
+#include <unison/ProcessingContext.hpp>
+#include <unison/RtArena.hpp>
+#include <unison/Scheduler.hpp>
+
+#include <QList>
+#include <QVector>
+
+#include <iostream>
+
+using namespace Unison;
+using namespace Unison::Internal;
+
+static const nframes_t BUFFER_LENGTH = 64;
+
+/**
+ * An audio port of a TestProcessor */
+class TestPort : public Port
+{
+  public:
+    TestPort (Processor* parent, PortDirection direction) :
+      m_parent(parent),
+      m_direction(direction)
+    {}
+
+    QString name () const { return "test"; }
+    QString id () const { return "test"; }
+    PortType type () const { return AudioPort; }
+    PortDirection direction () const { return m_direction; }
+    float value () const { return 0.0f; }
+    void setValue (float) {}
+    float defaultValue () const { return 0.0f; }
+    bool isBounded () const { return false; }
+    float minimum () const { return 0.0f; }
+    float maximum () const { return 0.0f; }
+    bool isToggled () const { return false; }
+    Node* parent () const { return m_parent; }
+
+    void connectToBuffer ()
+    {}
+
+    const QSet<Node* const> interfacedNodes () const
+    {
+      QSet<Node* const> p;
+      p.insert(m_parent);
+      return p;
+    }
+
+    AudioBuffer* audio ()
+    {
+      return static_cast<AudioBuffer*>(buffer().data());
+    }
+
+    sample_t* samples () const
+    {
+      return static_cast<sample_t*>(processBuffer()->data());
+    }
+
+  private:
+    Processor* m_parent;
+    PortDirection m_direction;
+};
+
+
+/**
+ * Writes the sum of its inputs plus one to all of its outputs, frame by frame, so it
+ * works in-place.  Remembers the sum of its inputs it last read. */
+class TestProcessor : public Processor
+{
+  public:
+    TestProcessor (int inputs, int outputs, bool inPlace) :
+      heard(-1.0f),
+      m_inPlace(inPlace)
+    {
+      for (int i=0; i<inputs; ++i) {
+        m_inputs.append(new TestPort(this, Input));
+      }
+      for (int i=0; i<outputs; ++i) {
+        m_outputs.append(new TestPort(this, Output));
+      }
+    }
+
+    ~TestProcessor ()
+    {
+      qDeleteAll(m_inputs);
+      qDeleteAll(m_outputs);
+    }
+
+    QString name () const { return "Test"; }
+    int portCount () const { return m_inputs.count() + m_outputs.count(); }
+    Port* port (const QString&) const { return NULL; }
+    void deactivate () {}
+
+    Port* port (int idx) const
+    {
+      return (idx < m_inputs.count()) ? m_inputs.at(idx)
+                                      : m_outputs.at(idx - m_inputs.count());
+    }
+
+    TestPort* in (int idx = 0) const { return m_inputs.at(idx); }
+    TestPort* out (int idx = 0) const { return m_outputs.at(idx); }
+
+    void activate (BufferProvider& provider)
+    {
+      for (int i=0; i<portCount(); ++i) {
+        port(i)->acquireBuffer(provider);
+        port(i)->useBuffer(port(i)->buffer().data());
+      }
+    }
+
+    bool isInPlaceBroken () const
+    {
+      return !m_inPlace;
+    }
+
+    void process (const ProcessingContext& context)
+    {
+      heard = -1.0f;
+      for (nframes_t f=0; f<context.bufferSize(); ++f) {
+        float sum = 0.0f;
+        for (int i=0; i<m_inputs.count(); ++i) {
+          sum += m_inputs.at(i)->samples()[f];
+        }
+        if (f > 0 && sum != heard) {
+          heard = -1.0f;  // Not the same all along
+          return;
+        }
+        heard = sum;
+        for (int o=0; o<m_outputs.count(); ++o) {
+          m_outputs.at(o)->samples()[f] = sum + 1.0f;
+        }
+      }
+      for (int o=0; o<m_outputs.count(); ++o) {
+        static_cast<AudioBuffer*>(m_outputs.at(o)->processBuffer())->markWritten();
+      }
+    }
+
+    float heard;  ///< Sum of the inputs, the same on every frame, or -1
+
+  private:
+    QList<TestPort*> m_inputs;
+    QList<TestPort*> m_outputs;
+    bool m_inPlace;
+};
+
+
+/**
+ * Connect @p producer to @p consumer, the way PortConnect does before compiling */
+void connect (TestPort* producer, TestPort* consumer)
+{
+  producer->addConnection(consumer);
+  consumer->addConnection(producer);
+}
+
+
+/**
+ * Runs processors in a Patch, with a single Worker.  They are added in the order given,
+ * producers must come before their consumers. */
+class Harness
+{
+  public:
+    Harness (PooledBufferProvider& provider, const QList<TestProcessor*>& processors) :
+      m_processors(processors),
+      m_schedule(NULL)
+    {
+      foreach (TestProcessor* p, processors) {
+        m_patch.add(p);
+      }
+      m_patch.activate(provider);
+      compile();
+
+      m_group.workerCount = 1;
+      m_group.workers = new Worker*[1];
+      m_group.workers[0] = new Worker(m_group);
+    }
+
+    ~Harness ()
+    {
+      delete m_group.workers[0];
+      delete[] m_group.workers;
+      m_patch.deactivate();
+      foreach (TestProcessor* p, m_processors) {
+        m_patch.remove(p);
+      }
+      delete m_schedule;
+    }
+
+    /**
+     * Compile and publish a new schedule, nothing is running the old one */
+    void compile ()
+    {
+      Schedule* compiled = new Schedule();
+      m_patch.compileSchedule(*compiled);
+      delete m_patch.setSchedule(compiled);
+      m_schedule = compiled;
+    }
+
+    void run (nframes_t length)
+    {
+      ProcessingContext context(length);
+      m_group.startPeriod(context, m_schedule->readyWork, m_schedule->readyWorkCount,
+                          m_schedule->workCount);
+      m_group.workers[0]->run(context);
+    }
+
+    Schedule* schedule () const
+    {
+      return m_schedule;
+    }
+
+  private:
+    QList<TestProcessor*> m_processors;
+    Patch m_patch;
+    Schedule* m_schedule;
+    WorkerGroup m_group;
+};
+
+
+bool chainRunsInPlace (PooledBufferProvider& provider)
+{
+  TestProcessor source(0, 1, false);
+  TestProcessor a(1, 1, true);
+  TestProcessor b(1, 1, true);
+  TestProcessor sink(1, 0, false);
+  connect(source.out(), a.in());
+  connect(a.out(), b.in());
+  connect(b.out(), sink.in());
+  Harness h(provider, QList<TestProcessor*>() << &source << &a << &b << &sink);
+
+  AudioBuffer* shared = source.out()->audio();
+  if (a.in()->audio() != shared || a.out()->audio() != shared ||
+      b.out()->audio() != shared || sink.in()->audio() != shared) {
+    return false;
+  }
+  h.run(BUFFER_LENGTH);
+  return a.heard == 1.0f && b.heard == 2.0f && sink.heard == 3.0f;
+}
+
+
+bool inPlaceBrokenGetsOwnBuffer (PooledBufferProvider& provider)
+{
+  TestProcessor source(0, 1, false);
+  TestProcessor broken(1, 1, false);
+  TestProcessor sink(1, 0, false);
+  connect(source.out(), broken.in());
+  connect(broken.out(), sink.in());
+  Harness h(provider, QList<TestProcessor*>() << &source << &broken << &sink);
+
+  if (broken.out()->audio() == broken.in()->audio()) {
+    return false;
+  }
+  h.run(BUFFER_LENGTH);
+  return sink.heard == 2.0f;
+}
+
+
+bool fanOutBlocksReuse (PooledBufferProvider& provider)
+{
+  // Either reader would clobber the source for the other one if it ran in-place
+  TestProcessor source(0, 1, false);
+  TestProcessor a(1, 1, true);
+  TestProcessor b(1, 1, true);
+  TestProcessor sinkA(1, 0, false);
+  TestProcessor sinkB(1, 0, false);
+  connect(source.out(), a.in());
+  connect(source.out(), b.in());
+  connect(a.out(), sinkA.in());
+  connect(b.out(), sinkB.in());
+  Harness h(provider,
+            QList<TestProcessor*>() << &source << &a << &b << &sinkA << &sinkB);
+
+  AudioBuffer* read = source.out()->audio();
+  if (a.out()->audio() == read || b.out()->audio() == read ||
+      a.out()->audio() == b.out()->audio()) {
+    return false;
+  }
+  h.run(BUFFER_LENGTH);
+  return a.heard == 1.0f && b.heard == 1.0f && sinkA.heard == 2.0f &&
+         sinkB.heard == 2.0f;
+}
+
+
+bool freedBufferIsReused (PooledBufferProvider& provider)
+{
+  // Nobody reads the source once the first effect has run
+  TestProcessor source(0, 1, false);
+  TestProcessor a(1, 1, false);
+  TestProcessor b(1, 1, false);
+  TestProcessor sink(1, 0, false);
+  connect(source.out(), a.in());
+  connect(a.out(), b.in());
+  connect(b.out(), sink.in());
+  Harness h(provider, QList<TestProcessor*>() << &source << &a << &b << &sink);
+
+  if (b.out()->audio() != source.out()->audio() || a.out()->audio() == b.out()->audio()) {
+    return false;
+  }
+  h.run(BUFFER_LENGTH);
+  return sink.heard == 3.0f;
+}
+
+
+bool lengthChangeResizes ()
+{
+  PooledBufferProvider provider;
+  provider.setBufferLength(BUFFER_LENGTH);
+
+  TestProcessor source(0, 1, false);
+  TestProcessor a(1, 1, true);
+  TestProcessor sink(1, 0, false);
+  TestProcessor unconnected(1, 1, true);
+  connect(source.out(), a.in());
+  connect(a.out(), sink.in());
+  QList<TestProcessor*> processors;
+  processors << &source << &a << &sink << &unconnected;
+  Harness h(provider, processors);
+  h.run(BUFFER_LENGTH);
+
+  const nframes_t longer = 2 * BUFFER_LENGTH;
+  provider.setBufferLength(longer);
+  h.compile();
+  if (h.schedule()->bufferLength != longer) {
+    return false;
+  }
+  foreach (TestProcessor* p, processors) {
+    for (int i=0; i<p->portCount(); ++i) {
+      Port* port = p->port(i);
+      const AudioBuffer* buffer = static_cast<const AudioBuffer*>(port->buffer().data());
+      if (buffer->length() != longer || port->processBuffer() != buffer) {
+        return false;
+      }
+    }
+  }
+  if (unconnected.in()->buffer() != provider.zeroAudioBuffer() ||
+      a.out()->audio() != source.out()->audio()) {
+    return false;
+  }
+  h.run(longer);
+  return sink.heard == 2.0f && unconnected.heard == 0.0f;
+}
+
+
+int main (int argc, char* argv[])
+{
+  RtArena::initialize();
+  PooledBufferProvider provider;
+  provider.setBufferLength(BUFFER_LENGTH);
+
+  bool cip = chainRunsInPlace(provider);
+  bool ipb = inPlaceBrokenGetsOwnBuffer(provider);
+  bool fob = fanOutBlocksReuse(provider);
+  bool fbr = freedBufferIsReused(provider);
+  bool lcr = lengthChangeResizes();
+  std::cout << "  chainRunsInPlace: "           << (cip?"OK":"FAIL") << std::endl;
+  std::cout << "  inPlaceBrokenGetsOwnBuffer: " << (ipb?"OK":"FAIL") << std::endl;
+  std::cout << "  fanOutBlocksReuse: "          << (fob?"OK":"FAIL") << std::endl;
+  std::cout << "  freedBufferIsReused: "        << (fbr?"OK":"FAIL") << std::endl;
+  std::cout << "  lengthChangeResizes: "        << (lcr?"OK":"FAIL") << std::endl;
+
+  return (cip + ipb + fob + fbr + lcr - 5);
+}
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
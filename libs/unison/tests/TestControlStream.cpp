@@ -0,0 +1,179 @@
+/*
+ * TestControlStream.cpp
+ *
+ * Tests the coalescing and timing of changes carried by a ControlStream
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <unison/ControlStream.hpp>
+
+#include <iostream>
+
+using namespace Unison;
+
+/**
+ * Run one period the way Plugin::runBlocks() does, noting the value of every frame.
+ * @returns the number of blocks the period was split into */
+int runPeriod (ControlStream& stream, float& value, nframes_t start, nframes_t length,
+               float* frames)
+{
+  stream.beginPeriod(start, length);
+  int blocks = 0;
+  nframes_t offset = 0;
+  while (offset < length) {
+    stream.apply(offset, &value);
+    const nframes_t end = stream.nextChange();
+    for (nframes_t i=offset; i<end; ++i) {
+      frames[i] = value;
+    }
+    offset = end;
+    ++blocks;
+  }
+  return blocks;
+}
+
+
+bool changesLandOnTheirFrame ()
+{
+  ControlStream stream(1.0f, 8);
+  float value = 1.0f;
+  float frames[64];
+
+  // Nothing pushed, a single block
+  if (runPeriod(stream, value, 0, 64, frames) != 1 || frames[63] != 1.0f) {
+    return false;
+  }
+
+  stream.push(2.0f, 64 + 10);
+  stream.push(3.0f, 64 + 40);
+  if (runPeriod(stream, value, 64, 64, frames) != 3) {
+    return false;
+  }
+  return frames[9] == 1.0f && frames[10] == 2.0f && frames[39] == 2.0f &&
+         frames[40] == 3.0f && frames[63] == 3.0f && stream.value() == 3.0f;
+}
+
+
+bool coalescing ()
+{
+  ControlStream stream(1.0f, 8);
+  float value = 1.0f;
+  float frames[64];
+
+  // The last change for a frame wins, a repeated value is dropped, and a change due
+  // before one pushed earlier takes effect together with it
+  stream.push(2.0f, 10);
+  stream.push(3.0f, 10);
+  stream.push(3.0f, 20);
+  stream.push(4.0f, 30);
+  stream.push(5.0f, 25);
+  if (runPeriod(stream, value, 0, 64, frames) != 3) {
+    return false;
+  }
+  return frames[9] == 1.0f && frames[10] == 3.0f && frames[29] == 3.0f &&
+         frames[30] == 5.0f && frames[63] == 5.0f;
+}
+
+
+bool laterChangesAreHeld ()
+{
+  ControlStream stream(1.0f, 8);
+  float value = 1.0f;
+  float frames[64];
+
+  stream.push(2.0f, 100);
+  stream.push(3.0f, 10);
+  if (runPeriod(stream, value, 0, 64, frames) != 1 || frames[63] != 1.0f) {
+    return false;
+  }
+
+  // The held change comes first, the one behind it goes along at the same frame
+  if (runPeriod(stream, value, 64, 64, frames) != 2) {
+    return false;
+  }
+  if (frames[35] != 1.0f || frames[36] != 3.0f || frames[63] != 3.0f) {
+    return false;
+  }
+
+  // A change without a time applies at the start of the next period
+  stream.push(7.0f);
+  runPeriod(stream, value, 128, 64, frames);
+  return frames[0] == 7.0f && stream.value() == 7.0f;
+}
+
+
+bool overflowKeepsLatest ()
+{
+  ControlStream stream(1.0f, 8);
+  float value = 1.0f;
+  float frames[64];
+
+  for (int i=0; i<40; ++i) {
+    stream.push(10.0f + i, 20 + i);
+  }
+  if (runPeriod(stream, value, 0, 64, frames) != 1 || frames[0] != 49.0f) {
+    return false;
+  }
+
+  // Back to normal afterwards
+  stream.push(50.0f, 64 + 5);
+  runPeriod(stream, value, 64, 64, frames);
+  return frames[4] == 49.0f && frames[5] == 50.0f;
+}
+
+
+bool clockWrapsAround ()
+{
+  ControlStream stream(1.0f, 8);
+  float value = 1.0f;
+  float frames[64];
+
+  // The period starts before the clock wraps and ends after it
+  const nframes_t start = nframes_t(0) - 30;
+  stream.push(2.0f, start + 10);
+  stream.push(3.0f, 5);
+  stream.push(4.0f, start - 100); // Late, applies right away
+  if (runPeriod(stream, value, start, 64, frames) != 3) {
+    return false;
+  }
+  return frames[0] == 1.0f && frames[10] == 2.0f && frames[34] == 2.0f &&
+         frames[35] == 4.0f && frames[63] == 4.0f;
+}
+
+
+int main (int argc, char* argv[])
+{
+  bool clf = changesLandOnTheirFrame();
+  bool coa = coalescing();
+  bool lch = laterChangesAreHeld();
+  bool okl = overflowKeepsLatest();
+  bool cwa = clockWrapsAround();
+  std::cout << "  changesLandOnTheirFrame: " << (clf?"OK":"FAIL") << std::endl;
+  std::cout << "  coalescing: "              << (coa?"OK":"FAIL") << std::endl;
+  std::cout << "  laterChangesAreHeld: "     << (lch?"OK":"FAIL") << std::endl;
+  std::cout << "  overflowKeepsLatest: "     << (okl?"OK":"FAIL") << std::endl;
+  std::cout << "  clockWrapsAround: "        << (cwa?"OK":"FAIL") << std::endl;
+
+  return (clf + coa + lch + okl + cwa - 5);
+}
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
@@ -0,0 +1,160 @@
+/*
+ * TestDsp.cpp
+ *
+ * Just some really basic tests for the RingBuffer
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <unison/Dsp.hpp>
+
+#include <iostream>
+#include <math.h>
+#include <stdlib.h>
+
+using namespace Unison;
+
+namespace {
+
+/** Longer than any vector loop, with odd lengths and offsets to hit the tails */
+enum { MAX_LEN = 300, CHANNELS = 3 };
+
+float input[CHANNELS][MAX_LEN + 16];
+float expect[CHANNELS * MAX_LEN + 16];
+float actual[CHANNELS * MAX_LEN + 16];
+
+void fill ()
+{
+  srand(1);
+  for (int c=0; c<CHANNELS; ++c) {
+    for (int i=0; i<MAX_LEN + 16; ++i) {
+      input[c][i] = 2.0f * rand() / RAND_MAX - 1.0f;
+    }
+  }
+}
+
+bool same (const float* a, const float* b, int n)
+{
+  for (int i=0; i<n; ++i) {
+    if (a[i] != b[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Runs every kernel of @p k against the generic ones.  Everything but rms() must match
+ * exactly, rms() sums in a different order. */
+bool matchesGeneric (const Dsp::Kernels* k)
+{
+  const Dsp::Kernels* g = Dsp::kernels(Dsp::Generic);
+  const int lengths[] = {0, 1, 3, 4, 7, 8, 15, 16, 17, 31, 33, 64, 100, 255, MAX_LEN};
+  for (unsigned l=0; l<sizeof(lengths)/sizeof(lengths[0]); ++l) {
+    for (int off=0; off<3; ++off) {
+      const nframes_t n = lengths[l];
+      const float* in = input[0] + off;
+      const float* in2 = input[1] + off;
+
+      g->copy(expect, in, n);
+      k->copy(actual, in, n);
+      if (!same(expect, actual, n)) {
+        return false;
+      }
+
+      k->zero(actual + off, n);
+      for (nframes_t i=0; i<n; ++i) {
+        if (actual[off + i] != 0.0f) {
+          return false;
+        }
+      }
+
+      g->gain(expect, in, 0.3f, n);
+      k->gain(actual, in, 0.3f, n);
+      if (!same(expect, actual, n)) {
+        return false;
+      }
+
+      g->copy(expect, in2, n);
+      g->copy(actual, in2, n);
+      g->mix(expect, in, n);
+      k->mix(actual, in, n);
+      if (!same(expect, actual, n)) {
+        return false;
+      }
+
+      g->mixGain(expect, in, -0.7f, n);
+      k->mixGain(actual, in, -0.7f, n);
+      if (!same(expect, actual, n)) {
+        return false;
+      }
+
+      for (int ch=1; ch<=CHANNELS; ++ch) {
+        const float* src[CHANNELS] = {input[0] + off, input[1] + off, input[2] + off};
+        g->interleave(expect, src, ch, n);
+        k->interleave(actual, src, ch, n);
+        if (!same(expect, actual, ch * n)) {
+          return false;
+        }
+
+        float* dst[CHANNELS] = {actual, actual + n, actual + 2 * n};
+        k->deinterleave(dst, expect, ch, n);
+        for (int c=0; c<ch; ++c) {
+          if (!same(dst[c], src[c], n)) {
+            return false;
+          }
+        }
+      }
+
+      if (g->peak(in, n) != k->peak(in, n)) {
+        return false;
+      }
+      if (fabsf(g->rms(in, n) - k->rms(in, n)) > 1e-5f) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+} // anonymous
+
+int main (int argc, char* argv[])
+{
+  fill();
+  int failed = 0;
+  for (int isa=Dsp::Generic; isa<=Dsp::Avx512; ++isa) {
+    const Dsp::Kernels* k = Dsp::kernels(Dsp::Isa(isa));
+    std::cout << "  " << Dsp::isaName(Dsp::Isa(isa)) << ": ";
+    if (!k) {
+      std::cout << "unavailable" << std::endl;
+      continue;
+    }
+    bool ok = matchesGeneric(k);
+    failed += !ok;
+    std::cout << (ok ? "OK" : "FAIL") << std::endl;
+  }
+  std::cout << "  in use: " << Dsp::isaName(Dsp::isa()) << std::endl;
+
+  return failed;
+}
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
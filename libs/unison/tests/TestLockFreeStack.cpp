@@ -0,0 +1,154 @@
+/*
+ * TestLockFreeStack.cpp
+ *
+ * Hammers the LockFreeStack from several threads at once
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <unison/LockFreeStack.hpp>
+#include <unison/RtArena.hpp>
+
+#include <QList>
+#include <QThread>
+
+#include <iostream>
+
+using namespace Unison;
+using namespace Unison::Internal;
+
+static const int CAPACITY = 64;
+static const int THREADS = 4;
+static const int ROUNDS = 1000000;
+
+
+bool boundsAreKept ()
+{
+  LockFreeStack<int> stack(4);
+  for (int i=0; i<4; ++i) {
+    if (!stack.push(i)) {
+      return false;
+    }
+  }
+  if (stack.push(4)) {
+    return false;
+  }
+
+  // Last in, first out
+  int v;
+  for (int i=3; i>=0; --i) {
+    if (!stack.pop(v) || v != i) {
+      return false;
+    }
+  }
+  return !stack.pop(v);
+}
+
+
+/**
+ * Pops values and pushes them back, checking nobody else holds the same value */
+class Juggler : public QThread
+{
+  public:
+    Juggler (LockFreeStack<int>& stack, volatile int* held) :
+      errors(0),
+      m_stack(stack),
+      m_held(held)
+    {}
+
+    int errors;
+
+  protected:
+    void run ()
+    {
+      for (int r=0; r<ROUNDS; ++r) {
+        int v;
+        if (!m_stack.pop(v)) {
+          // Every other thread may be holding one at the moment
+          continue;
+        }
+        if (v < 0 || v >= CAPACITY || __sync_lock_test_and_set(&m_held[v], 1)) {
+          ++errors;
+          continue;
+        }
+        __sync_lock_release(&m_held[v]);
+        // We hold a value, so its node is spare and pushing can't fail
+        if (!m_stack.push(v)) {
+          ++errors;
+        }
+      }
+    }
+
+  private:
+    LockFreeStack<int>& m_stack;
+    volatile int* m_held;
+};
+
+
+bool concurrentPushPop ()
+{
+  LockFreeStack<int> stack(CAPACITY);
+  volatile int held[CAPACITY];
+  for (int i=0; i<CAPACITY; ++i) {
+    held[i] = 0;
+    stack.push(i);
+  }
+
+  QList<Juggler*> threads;
+  for (int t=0; t<THREADS; ++t) {
+    threads.append(new Juggler(stack, held));
+    threads.last()->start();
+  }
+  int errors = 0;
+  for (int t=0; t<THREADS; ++t) {
+    threads.at(t)->wait();
+    errors += threads.at(t)->errors;
+    delete threads.at(t);
+  }
+
+  // Nothing lost, nothing duplicated
+  bool seen[CAPACITY] = { false };
+  int count = 0;
+  int v;
+  while (stack.pop(v)) {
+    if (v < 0 || v >= CAPACITY || seen[v]) {
+      return false;
+    }
+    seen[v] = true;
+    ++count;
+  }
+  return errors == 0 && count == CAPACITY;
+}
+
+
+int main (int argc, char* argv[])
+{
+  RtArena::initialize();
+
+  bool bak = boundsAreKept();
+  bool cpp = concurrentPushPop();
+  std::cout << "  boundsAreKept: "     << (bak?"OK":"FAIL") << std::endl;
+  std::cout << "  concurrentPushPop: " << (cpp?"OK":"FAIL") << std::endl;
+
+  return (bak + cpp - 2);
+}
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
@@ -0,0 +1,364 @@
+/*
+ * TestPortMixer.cpp
+ *
+ * Tests that PortMixers sum the connections of an audio input
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <unison/AudioBuffer.hpp>
+#include <unison/Patch.hpp>
+#include <unison/PooledBufferProvider.hpp>
+#include <unison/Port.hpp>
+#include <unison/ProcessingContext.hpp>
+#include <unison/RtArena.hpp>
+#include <unison/Scheduler.hpp>
+
+#include <QList>
+
+#include <iostream>
+
+using namespace Unison;
+using namespace Unison::Internal;
+
+static const nframes_t BUFFER_LENGTH = 64;
+
+/**
+ * An audio port of a TestProcessor */
+class TestPort : public Port
+{
+  public:
+    TestPort (Processor* parent, PortDirection direction) :
+      m_parent(parent),
+      m_direction(direction)
+    {}
+
+    QString name () const { return "test"; }
+    QString id () const { return "test"; }
+    PortType type () const { return AudioPort; }
+    PortDirection direction () const { return m_direction; }
+    float value () const { return 0.0f; }
+    void setValue (float) {}
+    float defaultValue () const { return 0.0f; }
+    bool isBounded () const { return false; }
+    float minimum () const { return 0.0f; }
+    float maximum () const { return 0.0f; }
+    bool isToggled () const { return false; }
+    Node* parent () const { return m_parent; }
+
+    void connectToBuffer ()
+    {}
+
+    const QSet<Node* const> interfacedNodes () const
+    {
+      QSet<Node* const> p;
+      p.insert(m_parent);
+      return p;
+    }
+
+    AudioBuffer* audio ()
+    {
+      return static_cast<AudioBuffer*>(buffer().data());
+    }
+
+    sample_t* samples () const
+    {
+      return static_cast<sample_t*>(processBuffer()->data());
+    }
+
+  private:
+    Processor* m_parent;
+    PortDirection m_direction;
+};
+
+
+/**
+ * Writes the sum of its inputs plus its level to all of its outputs.  Remembers the sum
+ * of its inputs it last read. */
+class TestProcessor : public Processor
+{
+  public:
+    TestProcessor (int inputs, int outputs, float level,
+                   nframes_t tail = Processor::UNKNOWN_TAIL) :
+      heard(-1.0f),
+      level(level),
+      m_tail(tail)
+    {
+      for (int i=0; i<inputs; ++i) {
+        m_inputs.append(new TestPort(this, Input));
+      }
+      for (int i=0; i<outputs; ++i) {
+        m_outputs.append(new TestPort(this, Output));
+      }
+    }
+
+    ~TestProcessor ()
+    {
+      qDeleteAll(m_inputs);
+      qDeleteAll(m_outputs);
+    }
+
+    QString name () const { return "Test"; }
+    int portCount () const { return m_inputs.count() + m_outputs.count(); }
+    Port* port (const QString&) const { return NULL; }
+    void deactivate () {}
+
+    Port* port (int idx) const
+    {
+      return (idx < m_inputs.count()) ? m_inputs.at(idx)
+                                      : m_outputs.at(idx - m_inputs.count());
+    }
+
+    TestPort* in (int idx = 0) const { return m_inputs.at(idx); }
+    TestPort* out (int idx = 0) const { return m_outputs.at(idx); }
+
+    void activate (BufferProvider& provider)
+    {
+      for (int i=0; i<portCount(); ++i) {
+        port(i)->acquireBuffer(provider);
+        port(i)->useBuffer(port(i)->buffer().data());
+      }
+    }
+
+    nframes_t tailLength () const
+    {
+      return m_tail;
+    }
+
+    void process (const ProcessingContext& context)
+    {
+      heard = -1.0f;
+      for (nframes_t f=0; f<context.bufferSize(); ++f) {
+        float sum = 0.0f;
+        for (int i=0; i<m_inputs.count(); ++i) {
+          sum += m_inputs.at(i)->samples()[f];
+        }
+        if (f > 0 && sum != heard) {
+          heard = -1.0f;  // Not the same all along
+          return;
+        }
+        heard = sum;
+        for (int o=0; o<m_outputs.count(); ++o) {
+          m_outputs.at(o)->samples()[f] = sum + level;
+        }
+      }
+    }
+
+    float heard;  ///< Sum of the inputs, the same on every frame, or -1
+    float level;  ///< Added to the inputs
+
+  private:
+    QList<TestPort*> m_inputs;
+    QList<TestPort*> m_outputs;
+    nframes_t m_tail;
+};
+
+
+/**
+ * Connect @p producer to @p consumer, the way PortConnect does before compiling */
+void connect (TestPort* producer, TestPort* consumer)
+{
+  producer->addConnection(consumer);
+  consumer->addConnection(producer);
+}
+
+
+/**
+ * Runs processors in a Patch, with a single Worker.  They are added in the order given,
+ * producers must come before their consumers. */
+class Harness
+{
+  public:
+    Harness (PooledBufferProvider& provider, const QList<TestProcessor*>& processors) :
+      m_processors(processors),
+      m_context(BUFFER_LENGTH)
+    {
+      foreach (TestProcessor* p, processors) {
+        m_patch.add(p);
+      }
+      m_patch.activate(provider);
+      m_schedule = new Schedule();
+      m_patch.compileSchedule(*m_schedule);
+      m_patch.setSchedule(m_schedule);
+
+      m_group.workerCount = 1;
+      m_group.workers = new Worker*[1];
+      m_group.workers[0] = new Worker(m_group);
+    }
+
+    ~Harness ()
+    {
+      delete m_group.workers[0];
+      delete[] m_group.workers;
+      m_patch.deactivate();
+      foreach (TestProcessor* p, m_processors) {
+        m_patch.remove(p);
+      }
+      delete m_schedule;
+    }
+
+    void run ()
+    {
+      m_group.startPeriod(m_context, m_schedule->readyWork, m_schedule->readyWorkCount,
+                          m_schedule->workCount);
+      m_group.workers[0]->run(m_context);
+    }
+
+  private:
+    QList<TestProcessor*> m_processors;
+    Patch m_patch;
+    Schedule* m_schedule;
+    WorkerGroup m_group;
+    ProcessingContext m_context;
+};
+
+
+bool mixerAccumulatesIntoProducer (PooledBufferProvider& provider)
+{
+  // Nobody else reads either source, so one of their buffers is mixed into
+  TestProcessor a(0, 1, 1.0f);
+  TestProcessor b(0, 1, 2.0f);
+  TestProcessor sink(1, 0, 0.0f);
+  connect(a.out(), sink.in());
+  connect(b.out(), sink.in());
+  Harness h(provider, QList<TestProcessor*>() << &a << &b << &sink);
+
+  AudioBuffer* target = sink.in()->audio();
+  if (target != a.out()->audio() && target != b.out()->audio()) {
+    return false;
+  }
+  h.run();
+  return sink.heard == 3.0f;
+}
+
+
+bool readProducerIsNotOverwritten (PooledBufferProvider& provider)
+{
+  // Mixing into a's buffer would change what other hears
+  TestProcessor a(0, 1, 1.0f);
+  TestProcessor b(0, 1, 2.0f);
+  TestProcessor other(1, 0, 0.0f);
+  TestProcessor sink(1, 0, 0.0f);
+  connect(a.out(), other.in());
+  connect(a.out(), sink.in());
+  connect(b.out(), sink.in());
+  Harness h(provider, QList<TestProcessor*>() << &a << &b << &other << &sink);
+
+  if (sink.in()->audio() == a.out()->audio()) {
+    return false;
+  }
+  h.run();
+  return other.heard == 1.0f && sink.heard == 3.0f;
+}
+
+
+bool silentSourcesMarkTargetSilent (PooledBufferProvider& provider)
+{
+  // The sources pass their generators through, and are skipped once those fall silent,
+  // so their outputs are known to be silent.  Nobody else reads them.
+  TestProcessor genA(0, 1, 1.0f);
+  TestProcessor genB(0, 1, 2.0f);
+  TestProcessor a(1, 1, 0.0f, 0);
+  TestProcessor b(1, 1, 0.0f, 0);
+  TestProcessor sink(1, 0, 0.0f);
+  connect(genA.out(), a.in());
+  connect(genB.out(), b.in());
+  connect(a.out(), sink.in());
+  connect(b.out(), sink.in());
+  Harness h(provider, QList<TestProcessor*>() << &genA << &genB << &a << &b << &sink);
+  h.run();
+  const bool mixed = (sink.heard == 3.0f);
+
+  // Whichever buffer is the target, the other source is still heard
+  genA.level = 0.0f;
+  h.run();
+  const bool heardB = (sink.heard == 2.0f && !sink.in()->audio()->isKnownSilent());
+  genA.level = 1.0f;
+  genB.level = 0.0f;
+  h.run();
+  const bool heardA = (sink.heard == 1.0f && !sink.in()->audio()->isKnownSilent());
+
+  genA.level = 0.0f;
+  h.run();
+  return mixed && heardA && heardB && sink.heard == 0.0f &&
+         sink.in()->audio()->isKnownSilent();
+}
+
+
+bool silentSourcesClearOwnBuffer (PooledBufferProvider& provider)
+{
+  // Everything upstream is read elsewhere, so the mixer has a buffer of its own to clear
+  TestProcessor genA(0, 1, 1.0f);
+  TestProcessor genB(0, 1, 2.0f);
+  TestProcessor a(1, 1, 0.0f, 0);
+  TestProcessor b(1, 1, 0.0f, 0);
+  TestProcessor otherA(2, 0, 0.0f);
+  TestProcessor otherB(2, 0, 0.0f);
+  TestProcessor sink(1, 0, 0.0f);
+  connect(genA.out(), a.in());
+  connect(genB.out(), b.in());
+  connect(a.out(), otherA.in(0));
+  connect(genA.out(), otherA.in(1));
+  connect(b.out(), otherB.in(0));
+  connect(genB.out(), otherB.in(1));
+  connect(a.out(), sink.in());
+  connect(b.out(), sink.in());
+  QList<TestProcessor*> processors;
+  processors << &genA << &genB << &a << &b << &otherA << &otherB << &sink;
+  Harness h(provider, processors);
+
+  AudioBuffer* target = sink.in()->audio();
+  foreach (TestProcessor* p, processors) {
+    for (int i=0; i<p->portCount(); ++i) {
+      if (p != &sink && p->port(i)->buffer().data() == target) {
+        return false;
+      }
+    }
+  }
+  h.run();
+  const bool mixed = (sink.heard == 3.0f);
+
+  genA.level = 0.0f;
+  genB.level = 0.0f;
+  h.run();
+  return mixed && sink.heard == 0.0f && target->isKnownSilent();
+}
+
+
+int main (int argc, char* argv[])
+{
+  RtArena::initialize();
+  PooledBufferProvider provider;
+  provider.setBufferLength(BUFFER_LENGTH);
+
+  bool aip = mixerAccumulatesIntoProducer(provider);
+  bool rpn = readProducerIsNotOverwritten(provider);
+  bool sts = silentSourcesMarkTargetSilent(provider);
+  bool sco = silentSourcesClearOwnBuffer(provider);
+  std::cout << "  mixerAccumulatesIntoProducer: "  << (aip?"OK":"FAIL") << std::endl;
+  std::cout << "  readProducerIsNotOverwritten: "  << (rpn?"OK":"FAIL") << std::endl;
+  std::cout << "  silentSourcesMarkTargetSilent: " << (sts?"OK":"FAIL") << std::endl;
+  std::cout << "  silentSourcesClearOwnBuffer: "   << (sco?"OK":"FAIL") << std::endl;
+
+  return (aip + rpn + sts + sco - 4);
+}
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
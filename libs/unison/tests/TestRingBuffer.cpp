@@ -25,6 +25,7 @@
  */
 
 #include <unison/RingBuffer.hpp>
+#include <unison/SpscRingBuffer.hpp>
 
 #include <iostream>
 
@@ -137,19 +138,85 @@ bool pushAndPopOverBoundary ()
   return true;
 }
 
-int main (int argc, char* argv[])
+bool peekOverBoundary ()
 {
+  const int in[] = {0,1,2,3,4,5,6,7};
+  int out[5];
+
   RingBuffer<int> rb(8);
+
+  // Move the read pointer near the end, so the next data wraps
+  rb.write(in, 6);
+  rb.skip(6);
+  rb.write(in, 5);
+
+  // Peeking used to read the wrong length at the boundary
+  if (rb.peek(out, 5) != 5 || rb.readSpace() != 5) {
+    return false;
+  }
+  for (int k=0; k<5; ++k) {
+    if (out[k] != in[k]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+bool spscVectorsWrap ()
+{
+  SpscRingBuffer<int> rb(6);
+
+  // Rounded up, and every element usable
+  if (rb.capacity() != 8 || rb.writeSpace() != 8) {
+    return false;
+  }
+
+  SpscRingBuffer<int>::Vector vec[2];
+  int in[8];
+  for (int i=0; i<8; ++i) {
+    in[i] = i;
+  }
+  rb.write(in, 6);
+  rb.read(in, 6);
+
+  // Writing 5 now takes 2 at the end and 3 at the front
+  if (rb.getWriteVector(vec, 5) != 8 || vec[0].count != 2 || vec[1].count != 6) {
+    return false;
+  }
+  for (int i=0; i<5; ++i) {
+    (i < 2 ? vec[0].data[i] : vec[1].data[i-2]) = in[i];
+  }
+  rb.writeAdvance(5);
+
+  if (rb.getReadVector(vec) != 5 || vec[0].count != 2 || vec[1].count != 3) {
+    return false;
+  }
+  if (vec[0].data[1] != 1 || vec[1].data[0] != 2 || vec[1].data[2] != 4) {
+    return false;
+  }
+  rb.readAdvance(5);
+
+  return rb.readSpace() == 0 && rb.write(in, 8) == 8 && rb.write(in, 1) == 0;
+}
+
+
+int main (int argc, char* argv[])
+{
   bool spp = singlePushAndPop();
   bool ppf = pushAndPopAreFifo();
   bool pos = pushOverflowSingles();
   bool ppb = pushAndPopOverBoundary();
-  std::cout << "  singlePushPop: "          << spp?"OK":"FAIL" << std::endl;
-  std::cout << "  pushAndPopAreFifo: "      << ppf?"OK":"FAIL" << std::endl;
-  std::cout << "  pushOverflowSingles: "    << pos?"OK":"FAIL" << std::endl;
-  std::cout << "  pushAndPopOverBoundary: " << ppb?"OK":"FAIL" << std::endl;
-
-  return (spp + ppf + pos + ppb -  4);
+  bool pkb = peekOverBoundary();
+  bool svw = spscVectorsWrap();
+  std::cout << "  singlePushPop: "          << (spp?"OK":"FAIL") << std::endl;
+  std::cout << "  pushAndPopAreFifo: "      << (ppf?"OK":"FAIL") << std::endl;
+  std::cout << "  pushOverflowSingles: "    << (pos?"OK":"FAIL") << std::endl;
+  std::cout << "  pushAndPopOverBoundary: " << (ppb?"OK":"FAIL") << std::endl;
+  std::cout << "  peekOverBoundary: "       << (pkb?"OK":"FAIL") << std::endl;
+  std::cout << "  spscVectorsWrap: "        << (svw?"OK":"FAIL") << std::endl;
+
+  return (spp + ppf + pos + ppb + pkb + svw - 6);
 }
 
 // vim: tw=90 ts=8 sw=2 sts=2 et sta noai
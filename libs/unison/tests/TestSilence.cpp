@@ -0,0 +1,255 @@
+/*
+ * TestSilence.cpp
+ *
+ * Tests that the Worker skips processors while their audio inputs are silent
+ *
+ * Copyright (c) 2010 Paul Giblock <pgib/at/users.sourceforge.net>
+ *
+ * This file is part of Unison - http://unison.sourceforge.net
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <unison/AudioBuffer.hpp>
+#include <unison/Dsp.hpp>
+#include <unison/Patch.hpp>
+#include <unison/PooledBufferProvider.hpp>
+#include <unison/Port.hpp>
+#include <unison/ProcessingContext.hpp>
+#include <unison/RtArena.hpp>
+#include <unison/Scheduler.hpp>
+
+#include <iostream>
+
+using namespace Unison;
+using namespace Unison::Internal;
+
+static const nframes_t BUFFER_LENGTH = 64;
+
+/**
+ * An unconnected audio port */
+class TestPort : public Port
+{
+  public:
+    TestPort (Processor* parent, PortDirection direction) :
+      m_parent(parent),
+      m_direction(direction)
+    {}
+
+    QString name () const { return "test"; }
+    QString id () const { return "test"; }
+    PortType type () const { return AudioPort; }
+    PortDirection direction () const { return m_direction; }
+    float value () const { return 0.0f; }
+    void setValue (float) {}
+    float defaultValue () const { return 0.0f; }
+    bool isBounded () const { return false; }
+    float minimum () const { return 0.0f; }
+    float maximum () const { return 0.0f; }
+    bool isToggled () const { return false; }
+    Node* parent () const { return m_parent; }
+
+    void connectToBuffer ()
+    {}
+
+    const QSet<Node* const> interfacedNodes () const
+    {
+      return QSet<Node* const>();
+    }
+
+  private:
+    Processor* m_parent;
+    PortDirection m_direction;
+};
+
+
+/**
+ * Writes ones to its output, and keeps ringing for @p tail frames */
+class RingingProcessor : public Processor
+{
+  public:
+    RingingProcessor (nframes_t tail) :
+      runs(0),
+      m_in(this, Input),
+      m_out(this, Output),
+      m_tail(tail)
+    {}
+
+    QString name () const { return "Ringing"; }
+    int portCount () const { return 2; }
+    Port* port (int idx) const { return idx ? (Port*)&m_out : (Port*)&m_in; }
+    Port* port (const QString&) const { return NULL; }
+    void deactivate () {}
+
+    void activate (BufferProvider& provider)
+    {
+      // An input of our own, instead of the shared silence, so the tests can write it
+      const nframes_t len = provider.bufferLength();
+      m_in.setBuffer(provider.acquire(AudioPort, len));
+      m_out.setBuffer(provider.acquire(AudioPort, len));
+      m_in.useBuffer(m_in.buffer().data());
+      m_out.useBuffer(m_out.buffer().data());
+      Dsp::zero(static_cast<sample_t*>(input()->data()), len);
+    }
+
+    void process (const ProcessingContext& context)
+    {
+      sample_t* out = static_cast<sample_t*>(m_out.processBuffer()->data());
+      for (nframes_t i=0; i<context.bufferSize(); ++i) {
+        out[i] = 1.0f;
+      }
+      ++runs;
+    }
+
+    nframes_t tailLength () const
+    {
+      return m_tail;
+    }
+
+    AudioBuffer* input () const
+    {
+      return static_cast<AudioBuffer*>(m_in.buffer().data());
+    }
+
+    AudioBuffer* output () const
+    {
+      return static_cast<AudioBuffer*>(m_out.buffer().data());
+    }
+
+    int runs;
+
+  private:
+    mutable TestPort m_in;
+    mutable TestPort m_out;
+    nframes_t m_tail;
+};
+
+
+/**
+ * Runs @p processor alone in a Patch, with a single Worker */
+class Harness
+{
+  public:
+    Harness (PooledBufferProvider& provider, RingingProcessor& processor) :
+      m_processor(processor),
+      m_context(BUFFER_LENGTH)
+    {
+      m_patch.add(&processor);
+      m_patch.activate(provider);
+      m_schedule = new Schedule();
+      m_patch.compileSchedule(*m_schedule);
+      m_patch.setSchedule(m_schedule);
+
+      m_group.workerCount = 1;
+      m_group.workers = new Worker*[1];
+      m_group.workers[0] = new Worker(m_group);
+    }
+
+    ~Harness ()
+    {
+      delete m_group.workers[0];
+      delete[] m_group.workers;
+      m_patch.deactivate();
+      m_patch.remove(&m_processor);
+      delete m_schedule;
+    }
+
+    void run (int periods)
+    {
+      for (int i=0; i<periods; ++i) {
+        m_group.startPeriod(m_context, m_schedule->readyWork, m_schedule->readyWorkCount,
+                            m_schedule->workCount);
+        m_group.workers[0]->run(m_context);
+      }
+    }
+
+  private:
+    RingingProcessor& m_processor;
+    Patch m_patch;
+    Schedule* m_schedule;
+    WorkerGroup m_group;
+    ProcessingContext m_context;
+};
+
+
+bool silentInputIsSkipped (PooledBufferProvider& provider)
+{
+  RingingProcessor p(100);
+  Harness h(provider, p);
+
+  // Rings on for the first 100 frames, the third period is skipped
+  h.run(3);
+  const sample_t* out = static_cast<const sample_t*>(p.output()->data());
+  if (p.runs != 2 || !p.input()->isSilent() || !p.output()->isKnownSilent()) {
+    return false;
+  }
+  for (nframes_t i=0; i<BUFFER_LENGTH; ++i) {
+    if (out[i] != 0.0f) {
+      return false;
+    }
+  }
+
+  h.run(10);
+  return p.runs == 2;
+}
+
+
+bool audibleInputRuns (PooledBufferProvider& provider)
+{
+  RingingProcessor p(0);
+  Harness h(provider, p);
+
+  // Sound on the input, the processor runs until it has been silent for the tail
+  sample_t* in = static_cast<sample_t*>(p.input()->data());
+  in[BUFFER_LENGTH - 1] = 0.5f;
+  p.input()->markWritten();
+  h.run(3);
+  const bool ran = (p.runs == 3);
+
+  in[BUFFER_LENGTH - 1] = 0.0f;
+  p.input()->markWritten();
+  h.run(3);
+  return ran && p.runs == 3;
+}
+
+
+bool unknownTailNeverSkipped (PooledBufferProvider& provider)
+{
+  RingingProcessor p(Processor::UNKNOWN_TAIL);
+  Harness h(provider, p);
+  h.run(5);
+  return p.runs == 5 && !p.output()->isKnownSilent();
+}
+
+
+int main (int argc, char* argv[])
+{
+  RtArena::initialize();
+  PooledBufferProvider provider;
+  provider.setBufferLength(BUFFER_LENGTH);
+
+  bool sis = silentInputIsSkipped(provider);
+  bool air = audibleInputRuns(provider);
+  bool uts = unknownTailNeverSkipped(provider);
+  std::cout << "  silentInputIsSkipped: "    << (sis?"OK":"FAIL") << std::endl;
+  std::cout << "  audibleInputRuns: "        << (air?"OK":"FAIL") << std::endl;
+  std::cout << "  unknownTailNeverSkipped: " << (uts?"OK":"FAIL") << std::endl;
+
+  return (sis + air + uts - 3);
+}
+
+// vim: tw=90 ts=8 sw=2 sts=2 et sta noai
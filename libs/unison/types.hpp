@@ -39,6 +39,17 @@ typedef uint32_t nticks_t;
  */
 typedef float sample_t;
 
+/**
+ * Size of a cache line on the machines we care about.  Data written by different
+ * threads is kept at least this far apart, so they don't fight over the line.
+ */
+enum { CACHE_LINE_SIZE = 64 };
+
+/**
+ * Align a type or variable to a cache line
+ */
+#define UNISON_CACHE_ALIGNED __attribute__((aligned(64)))
+
 enum PortType
 {
   AudioPort   = 1,  ///< Communicates by means of an audio buffer @sa AudioBuffer